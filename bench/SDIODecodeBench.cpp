@@ -0,0 +1,506 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmark of the SDIODecoder loop for each bus it is instantiated for.  A
+// CMD52 write sets the bus width, then CMD53 block reads clock 512 byte blocks
+// with valid CRC16s over the data lines.  The capture is in memory, so the time
+// is mostly the decoder's.
+//
+// Before that it checks that an interrupt asserted in the middle of a CMD52
+// still gets its latency frame, and that the busy of a CMD12 after a write is
+// not taken for the end of a write block, and that two buses on one clock
+// transferring at the same time keep a packet per command, and fails if not.
+
+#include "SDIODecoder.h"
+#include "SDIOMultiBusDecoder.h"
+#include "SDIOPackedCapture.h"
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double Seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// The command line and data lines, bit n of dat for DATn, of each clock cycle
+struct Waveform
+{
+    std::vector<U8> cmd;
+    std::vector<U8> dat;
+    U64 dataClocks;
+
+    Waveform() : dataClocks(0) {}
+
+    void Idle(U32 cycles)
+    {
+        for (U32 i = 0; i < cycles; i++)
+        {
+            cmd.push_back(1);
+            dat.push_back(0xFF);
+        }
+    }
+
+    static U8 Crc7(U64 bits)
+    {
+        U8 crc = 0;
+        for (int i = 39; i >= 0; i--)
+        {
+            U8 feedback = U8(((crc >> 6) ^ (bits >> i)) & 1);
+            crc = U8((crc << 1) & 0x7F);
+            if (feedback)
+                crc ^= 0x09;
+        }
+        return crc;
+    }
+
+    void Packet(bool host, U32 index, U32 argument)
+    {
+        U64 bits = U64(host ? 1 : 0) << 38 | U64(index) << 32 | argument;
+        bits = bits << 8 | U64(Crc7(bits)) << 1 | 1;
+        for (int i = 47; i >= 0; i--)
+        {
+            cmd.push_back(U8((bits >> i) & 1));
+            dat.push_back(0xFF);
+        }
+        Idle(8);
+    }
+
+    // Start bit, the bytes width bits a clock with the most significant first,
+    // a CRC16 on each line and the end bit
+    void DataBlock(const std::vector<U8> &bytes, U32 width)
+    {
+        U16 crc[8] = {0};
+        cmd.push_back(1);
+        dat.push_back(0x00);
+        for (size_t i = 0; i < bytes.size(); i++)
+        {
+            for (int shift = 8 - width; shift >= 0; shift -= width)
+            {
+                U8 lines = U8((bytes[i] >> shift) & ((1u << width) - 1));
+                for (U32 line = 0; line < width; line++)
+                {
+                    U32 feedback = ((crc[line] >> 15) ^ (lines >> line)) & 1;
+                    crc[line] = U16(crc[line] << 1);
+                    if (feedback)
+                        crc[line] ^= 0x1021;
+                }
+                cmd.push_back(1);
+                dat.push_back(U8(lines | (0xFF << width)));
+                dataClocks++;
+            }
+        }
+        for (int bit = 15; bit >= 0; bit--)
+        {
+            U8 lines = 0;
+            for (U32 line = 0; line < width; line++)
+                lines |= U8(((crc[line] >> bit) & 1) << line);
+            cmd.push_back(1);
+            dat.push_back(U8(lines | (0xFF << width)));
+        }
+        Idle(5);
+    }
+
+    // CRC status token of a block the card accepted on DAT0, then busy
+    void WriteStatus(U32 busy)
+    {
+        const U8 token[] = {0, 0, 1, 0, 1};
+        for (size_t i = 0; i < sizeof(token); i++)
+        {
+            cmd.push_back(1);
+            dat.push_back(U8(0xFE | token[i]));
+        }
+        for (U32 i = 0; i < busy; i++)
+        {
+            cmd.push_back(1);
+            dat.push_back(0xFE);
+        }
+        Idle(5);
+    }
+
+    // Pulls lines low from clock cycle from up to to
+    void Lower(size_t from, size_t to, U8 lines)
+    {
+        for (size_t i = from; i < to && i < dat.size(); i++)
+            dat[i] &= U8(~lines);
+    }
+};
+
+// Clock period of 8 samples, the lines change one sample after it falls
+static void Pack(const Waveform &waveform, SDIOPackedChannel* channels, U32 count)
+{
+    const U64 num_samples = 8 * U64(waveform.cmd.size() + 2);
+    for (U32 c = 0; c < count; c++)
+    {
+        std::vector<U64> words((num_samples + 63) / 64, 0);
+        for (U64 sample = 0; sample < num_samples; sample++)
+        {
+            U64 cycle = sample < 1 ? 0 : (sample - 1) / 8;
+            U8 state;
+            if (c == 0)
+                state = (sample & 7) >= 4;
+            else if (cycle >= waveform.cmd.size())
+                state = 1;
+            else if (c == 1)
+                state = waveform.cmd[cycle];
+            else
+                state = (waveform.dat[cycle] >> (c - 2)) & 1;
+            if (state)
+                words[sample >> 6] |= U64(1) << (sample & 63);
+        }
+        channels[c].Assign(words, num_samples);
+    }
+}
+
+class CountingSink : public SDIOFrameSink
+{
+public:
+    CountingSink() : mFrames(0), mCrcErrors(0) {}
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        mFrames++;
+        if (frame.mType == SDIODecoder::FRAME_DATA_CRC)
+            mCrcErrors++;
+    }
+    virtual void AddMarker(U64 /*sample*/) {}
+    virtual void CommitPacket() {}
+    virtual void CommitResults() {}
+
+    U64 mFrames;
+    U64 mCrcErrors;
+};
+
+class InterruptSink : public SDIOFrameSink
+{
+public:
+    InterruptSink() : mInterrupts(0), mStart(0), mDuration(0) {}
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        if (frame.mType != SDIODecoder::FRAME_IRQ)
+            return;
+        mInterrupts++;
+        mDuration = frame.mData1;
+        mStart = frame.mData2;
+    }
+    virtual void AddMarker(U64 /*sample*/) {}
+    virtual void CommitPacket() {}
+    virtual void CommitResults() {}
+
+    U64 mInterrupts;
+    U64 mStart;
+    U64 mDuration;
+};
+
+class BusySink : public SDIOFrameSink
+{
+public:
+    BusySink() : mBusy(0) {}
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        if (frame.mType == SDIODecoder::FRAME_BUSY)
+            mBusy++;
+    }
+    virtual void AddMarker(U64 /*sample*/) {}
+    virtual void CommitPacket() {}
+    virtual void CommitResults() {}
+
+    U64 mBusy;
+};
+
+// The start of every packet committed and the bus of its frames, which have
+// to be in order and must not overlap
+class PacketSink : public SDIOFrameSink
+{
+public:
+    PacketSink() : mFrames(0), mSummaries(0), mErrors(0), mLastEnd(0), mPacketStart(0), mBus(0) {}
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        U8 bus = frame.mFlags & SDIODecoder::FRAME_BUS_MASK;
+        if ((mFrames != 0 && frame.mStartingSampleInclusive <= mLastEnd) ||
+            frame.mEndingSampleInclusive < frame.mStartingSampleInclusive)
+            mErrors++;
+        if (mPacketFrames.empty())
+        {
+            mPacketStart = frame.mStartingSampleInclusive;
+            mBus = bus;
+        }
+        else if (bus != mBus)
+            mErrors++;
+        if (frame.mType == SDIODecoder::FRAME_PACKET)
+            mSummaries++;
+        mPacketFrames.push_back(frame);
+        mLastEnd = frame.mEndingSampleInclusive;
+        mFrames++;
+    }
+    virtual void AddMarker(U64 /*sample*/) {}
+    virtual void CommitPacket()
+    {
+        if (mPacketFrames.empty())
+            return;
+        mStarts[mBus >> SDIODecoder::FRAME_BUS_SHIFT].push_back(mPacketStart);
+        mPacketFrames.clear();
+    }
+    virtual void CommitResults() {}
+
+    // By bus number, 0 for a single bus
+    std::vector<U64> mStarts[SDIOMultiBusDecoder::MAX_BUSES + 1];
+    U64 mFrames;
+    U64 mSummaries;
+    U64 mErrors;
+
+protected:
+    std::vector<SDIOFrame> mPacketFrames;
+    U64 mLastEnd;
+    U64 mPacketStart;
+    U8 mBus;
+};
+
+// Commands on one bus, from the given clock cycle on
+static void BusTraffic(Waveform &waveform, U32 delay)
+{
+    std::vector<U8> payload(16, 0x3C);
+    waveform.Idle(16 + delay);
+    waveform.Packet(true, 52, 1u << 31 | 0x07 << 9 | 0x02);
+    waveform.Packet(false, 52, 0x1002);
+    waveform.Packet(true, 53, 1u << 28 | 0x8000 << 9 | U32(payload.size()));
+    waveform.Packet(false, 53, 0x2000);
+    waveform.DataBlock(payload, 1);
+    waveform.Packet(true, 52, 0x05 << 9);
+    waveform.Packet(false, 52, 0x1000);
+}
+
+// Two buses on one clock, the second a few clocks behind the first so their
+// packets overlap.  Every packet of a bus goes out as one packet that starts
+// where it does when the bus is decoded on its own.
+static bool CheckConcurrentBuses()
+{
+    Waveform waveforms[2];
+    BusTraffic(waveforms[0], 0);
+    BusTraffic(waveforms[1], 20);
+    waveforms[0].Idle(U32(waveforms[1].cmd.size() - waveforms[0].cmd.size()) + 16);
+    waveforms[1].Idle(16);
+
+    // The lines are read once, each bus has its own for the decode on its own
+    // and for the one with the other bus
+    SDIOPackedChannel channels[4][3];
+    SDIOChannelAdapter< SDIOPackedChannel > adapters[4][3];
+    for (U32 n = 0; n < 4; n++)
+    {
+        Pack(waveforms[n % 2], channels[n], 3);
+        for (U32 c = 0; c < 3; c++)
+            adapters[n][c].SetChannel(&channels[n][c]);
+    }
+
+    SDIODecodeOptions options;
+    PacketSink alone[2];
+    for (U32 bus = 0; bus < 2; bus++)
+    {
+        SDIODecoder decoder;
+        decoder.Start(adapters[bus][0].Get(), adapters[bus][1].Get(), adapters[bus][2].Get(), nullptr, nullptr,
+                      nullptr, &alone[bus], options);
+        while (adapters[bus][0].DoMoreTransitionsExistInCurrentData())
+            decoder.Step();
+        decoder.Finish();
+    }
+
+    SDIOChannel* lines[2 * SDIOMultiBusDecoder::LINE_COUNT] = {nullptr};
+    for (U32 bus = 0; bus < 2; bus++)
+    {
+        lines[bus * SDIOMultiBusDecoder::LINE_COUNT + SDIOMultiBusDecoder::LINE_CMD] = adapters[bus + 2][1].Get();
+        lines[bus * SDIOMultiBusDecoder::LINE_COUNT + SDIOMultiBusDecoder::LINE_DAT0] = adapters[bus + 2][2].Get();
+    }
+    PacketSink sink;
+    SDIOMultiBusDecoder decoder;
+    decoder.Start(adapters[2][0].Get(), lines, 2, &sink, options);
+    while (adapters[2][0].DoMoreTransitionsExistInCurrentData())
+        decoder.Step();
+    decoder.Finish();
+
+    bool same = alone[0].mErrors == 0 && alone[1].mErrors == 0;
+    for (U32 bus = 0; bus < 2; bus++)
+        same = same && sink.mStarts[bus + 1] == alone[bus].mStarts[0];
+    if (!same || sink.mErrors != 0 || sink.mSummaries == 0)
+    {
+        printf("error: two buses at the same time: %llu and %llu packets instead of %llu and %llu, "
+            "%llu frames out of order, %llu packets cut short\n",
+            (unsigned long long)sink.mStarts[1].size(), (unsigned long long)sink.mStarts[2].size(),
+            (unsigned long long)alone[0].mStarts[0].size(), (unsigned long long)alone[1].mStarts[0].size(),
+            (unsigned long long)sink.mErrors, (unsigned long long)sink.mSummaries);
+        return false;
+    }
+    return true;
+}
+
+// A CMD53 write of a block and its busy, then a CMD12 with an R1b busy.  Both
+// busy frames are there and the second does not end a write block.
+static bool CheckBusyAfterWrite()
+{
+    std::vector<U8> payload(32, 0xA5);
+    Waveform waveform;
+    waveform.Idle(16);
+    waveform.Packet(true, 53, 1u << 31 | 1u << 28 | 0x8000 << 9 | U32(payload.size()));
+    waveform.Packet(false, 53, 0x2000);
+    waveform.DataBlock(payload, 1);
+    waveform.WriteStatus(12);
+    waveform.Idle(16);
+    waveform.Packet(true, 12, 0);
+    waveform.Packet(false, 12, 0x900);
+    const size_t end_bit = waveform.cmd.size() - 9;
+    waveform.Idle(16);
+    waveform.Lower(end_bit + 2, end_bit + 14, 0x01);
+
+    SDIOPackedChannel channels[3];
+    Pack(waveform, channels, 3);
+    SDIOChannelAdapter< SDIOPackedChannel > adapters[3];
+    for (U32 c = 0; c < 3; c++)
+        adapters[c].SetChannel(&channels[c]);
+
+    BusySink sink;
+    SDIODecodeOptions options;
+    options.mCheckTiming = true;
+    SDIODecoder decoder;
+    decoder.Start(adapters[0].Get(), adapters[1].Get(), adapters[2].Get(), nullptr, nullptr, nullptr, &sink, options);
+    while (adapters[0].DoMoreTransitionsExistInCurrentData())
+        decoder.Step();
+    decoder.Finish();
+
+    U64 block_end = decoder.GetResponseTiming().GetBlockEnd();
+    if (sink.mBusy != 2 || block_end != 0){
+        printf("error: CMD12 after a write: %llu busy frames, write block ending at sample %llu\n",
+            (unsigned long long)sink.mBusy, (unsigned long long)block_end);
+        return false;
+    }
+    return true;
+}
+
+// DAT1 goes low 20 clocks into a CMD52 read of function 1 and stays low until
+// the host has read the interrupt pending register.  The latency frame has to
+// start in that CMD52 and end before the read.
+static bool CheckInterruptInCommand()
+{
+    Waveform waveform;
+    waveform.Idle(16);
+    waveform.Packet(true, 52, 1u << 31 | 0x07 << 9 | 0x02);
+    waveform.Packet(false, 52, 0x1002);
+    const size_t command = waveform.cmd.size();
+    waveform.Packet(true, 52, 1u << 28 | 0x1000 << 9);
+    waveform.Packet(false, 52, 0x1055);
+    waveform.Idle(10);
+    const size_t service = waveform.cmd.size();
+    waveform.Packet(true, 52, 0x05 << 9);
+    waveform.Packet(false, 52, 0x1002);
+    waveform.Lower(command + 20, waveform.cmd.size() - 4, 0x02);
+    waveform.Idle(16);
+
+    SDIOPackedChannel channels[6];
+    Pack(waveform, channels, 6);
+    SDIOChannelAdapter< SDIOPackedChannel > adapters[6];
+    for (U32 c = 0; c < 6; c++)
+        adapters[c].SetChannel(&channels[c]);
+
+    InterruptSink sink;
+    SDIODecodeOptions options;
+    SDIODecoder decoder;
+    decoder.Start(adapters[0].Get(), adapters[1].Get(), adapters[2].Get(), adapters[3].Get(),
+                  adapters[4].Get(), adapters[5].Get(), &sink, options);
+    while (adapters[0].DoMoreTransitionsExistInCurrentData())
+        decoder.Step();
+    decoder.Finish();
+
+    U64 start = 8 * U64(command + 20);
+    U64 end = sink.mStart + sink.mDuration;
+    if (sink.mInterrupts != 1 || sink.mStart < start || sink.mStart > start + 8 || end > 8 * U64(service)){
+        printf("error: interrupt in a CMD52: %llu latency frames, from sample %llu for %llu samples\n",
+            (unsigned long long)sink.mInterrupts, (unsigned long long)sink.mStart, (unsigned long long)sink.mDuration);
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    if (!CheckInterruptInCommand() || !CheckBusyAfterWrite() || !CheckConcurrentBuses())
+        return 1;
+
+    // Data lines connected and the bus width set, one per decode loop
+    const U32 configs[][2] = {{1, 1}, {2, 1}, {4, 1}, {4, 4}, {8, 1}, {8, 4}, {8, 8}};
+    const U32 clocks_per_run = 1u << 22;
+
+    std::vector<U8> payload(512);
+    for (size_t i = 0; i < payload.size(); i++)
+        payload[i] = U8(i * 37 + 11);
+
+    for (size_t n = 0; n < sizeof(configs) / sizeof(configs[0]); n++)
+    {
+        const U32 lines = configs[n][0];
+        const U32 width = configs[n][1];
+
+        Waveform waveform;
+        waveform.Idle(16);
+        U8 bus_interface = width == 8 ? 0x03 : width == 4 ? 0x02 : 0x00;
+        waveform.Packet(true, 52, 1u << 31 | 0x07 << 9 | bus_interface);
+        waveform.Packet(false, 52, 0x1000 | bus_interface);
+        while (waveform.dataClocks < clocks_per_run)
+        {
+            // Block mode read of function 1, 8 blocks
+            waveform.Packet(true, 53, 1u << 28 | 1u << 27 | 1u << 26 | 0x8000 << 9 | 8);
+            waveform.Packet(false, 53, 0x2000);
+            for (U32 block = 0; block < 8; block++)
+                waveform.DataBlock(payload, width);
+            waveform.Idle(16);
+        }
+
+        SDIOPackedChannel channels[10];
+        Pack(waveform, channels, lines + 2);
+        SDIOChannelAdapter< SDIOPackedChannel > adapters[10];
+        for (U32 c = 0; c < lines + 2; c++)
+            adapters[c].SetChannel(&channels[c]);
+
+        CountingSink sink;
+        SDIODecodeOptions options;
+        SDIODecoder decoder;
+        decoder.SetUpperDataLines(adapters[6].Get(), adapters[7].Get(), adapters[8].Get(), adapters[9].Get());
+
+        Clock::time_point start = Clock::now();
+        decoder.Start(adapters[0].Get(), adapters[1].Get(), adapters[2].Get(), adapters[3].Get(),
+                      adapters[4].Get(), adapters[5].Get(), &sink, options);
+        while (adapters[0].DoMoreTransitionsExistInCurrentData())
+            decoder.Step();
+        decoder.Finish();
+        Clock::time_point end = Clock::now();
+
+        double seconds = Seconds(start, end);
+        U64 bits = waveform.dataClocks * width;
+        printf("%u lines, %u bit bus %10llu data clocks %8.2f ns/clock %8.2f ns/bit\n", lines, width,
+            (unsigned long long)waveform.dataClocks, seconds * 1e9 / waveform.dataClocks, seconds * 1e9 / bits);
+        if (sink.mCrcErrors != 0)
+            printf("warning: %llu data CRC16 errors\n", (unsigned long long)sink.mCrcErrors);
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Micro-benchmark for the edge search of SDIOPackedChannel.  Compares testing
+// sample by sample with the word at a time search on a dense clock and on a
+// mostly idle command line, then samples the command line at every rising
+// clock edge with Gather().
+
+#include "SDIOPackedCapture.h"
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double Seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// A square wave with the given half period, or a line that toggles every
+// quiet samples
+static void Fill(SDIOPackedChannel &channel, U64 num_samples, U64 half_period)
+{
+    std::vector<U64> words((num_samples + 63) / 64, 0);
+    for (U64 sample = 0; sample < num_samples; sample++)
+    {
+        if ((sample / half_period) & 1)
+            words[sample >> 6] |= U64(1) << (sample & 63);
+    }
+    channel.Assign(words, num_samples);
+}
+
+static void Report(const char* name, U64 edges, U64 num_samples, double seconds)
+{
+    printf("%-32s %10llu edges %8.2f ns/edge %8.2f GB/s\n", name, (unsigned long long)edges,
+        seconds * 1e9 / (edges ? edges : 1), num_samples / 8.0 / seconds / 1e9);
+}
+
+int main()
+{
+    const U64 num_samples = U64(1) << 28;
+    SDIOPackedChannel clock, cmd;
+    Fill(clock, num_samples, 10);
+    Fill(cmd, num_samples, 100000);
+
+    const SDIOPackedChannel* channels[] = {&clock, &cmd};
+    const char* names[] = {"clock", "cmd"};
+    for (U32 c = 0; c < 2; c++)
+    {
+        const SDIOPackedChannel &channel = *channels[c];
+
+        Clock::time_point start = Clock::now();
+        U64 edges = 0;
+        BitState previous = channel.GetBit(0);
+        for (U64 sample = 1; sample < num_samples; sample++)
+        {
+            BitState state = channel.GetBit(sample);
+            edges += state != previous;
+            previous = state;
+        }
+        Clock::time_point middle = Clock::now();
+        U64 found = 0;
+        for (U64 sample = channel.FindNextEdge(0); sample < num_samples; sample = channel.FindNextEdge(sample))
+            found++;
+        Clock::time_point end = Clock::now();
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s sample by sample", names[c]);
+        Report(name, edges, num_samples, Seconds(start, middle));
+        snprintf(name, sizeof(name), "%s FindNextEdge", names[c]);
+        Report(name, found, num_samples, Seconds(middle, end));
+        if (edges != found)
+            printf("warning: edge counts differ\n");
+    }
+
+    //Sample the command line at every rising clock edge
+    std::vector<U64> rising;
+    for (U64 sample = clock.FindNextEdge(0); sample < num_samples; sample = clock.FindNextEdge(sample))
+    {
+        if (clock.GetBit(sample) == BIT_HIGH)
+            rising.push_back(sample);
+    }
+    std::vector<U8> bits(rising.size());
+    Clock::time_point start = Clock::now();
+    cmd.Gather(rising.data(), U32(rising.size()), bits.data());
+    Clock::time_point end = Clock::now();
+    printf("%-32s %10llu samples %6.2f ns/sample\n", "cmd Gather at rising clock", (unsigned long long)rising.size(),
+        Seconds(start, end) * 1e9 / rising.size());
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Micro-benchmark for the packet description formatting used by the tabular
+// text and the export.  Compares the previous GetNumberString()/stringstream
+// path with SDIOTextFormatter on a typical mix of CMD52/CMD53 packets.  Both
+// must give the same text byte for byte, the benchmark fails otherwise.
+
+#include <AnalyzerHelpers.h>
+#include "SDIODecoder.h"
+#include "SDIOTextFormatter.h"
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+struct Field
+{
+    U8 type;
+    U64 data1;
+    U64 data2;
+};
+
+// Previous implementation of SDIOAnalyzerResults::GeneratePacketDescription()
+static void StreamField(const Field &field, DisplayBase display_base, std::ostream &stream)
+{
+    char number_str1[128];
+    char number_str2[128];
+    if (field.type == SDIODecoder::FRAME_DIR)
+    {
+        stream << (field.data1 ? "H->S | " : "S->H | ");
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Decimal, 6, number_str1, 128);
+        stream << "CMD: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_ARG)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, display_base, 32, number_str1, 128);
+        stream << "ARG: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_LONG_ARG)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, display_base, 64, number_str1, 128);
+        AnalyzerHelpers::GetNumberString(field.data2, display_base, 64, number_str2, 128);
+        stream << "LARG: " << number_str1 << " " << number_str2 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CRC)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Hexadecimal, 7, number_str1, 128);
+        stream << "CRC: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD52_RWFLAG)
+    {
+        stream << (field.data1 ? "W |" : "R |");
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD52_FN)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Decimal, 3, number_str1, 128);
+        stream << "Func: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD52_RAW)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Decimal, 1, number_str1, 128);
+        stream << "Read after write: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD52_ADDR)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, display_base, 17, number_str1, 128);
+        stream << "Addr: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD52_DATA)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Hexadecimal, 8, number_str1, 128);
+        stream << "Data: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD52_FLAGS)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Binary, 8, number_str1, 128);
+        stream << "Response flags: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD53_BLOCK)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Decimal, 1, number_str1, 128);
+        stream << "Block mode: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD53_OP)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Decimal, 1, number_str1, 128);
+        stream << "Op: " << number_str1 << " | ";
+    }
+    else if (field.type == SDIODecoder::FRAME_CMD53_COUNT)
+    {
+        AnalyzerHelpers::GetNumberString(field.data1, Decimal, 9, number_str1, 128);
+        stream << "Count: " << number_str1 << " | ";
+    }
+}
+
+static const DisplayBase display_bases[] = {Binary, Decimal, Hexadecimal, ASCII, AsciiHex};
+static const char* const display_names[] = {"Binary", "Decimal", "Hexadecimal", "ASCII", "AsciiHex"};
+static const U32 display_count = sizeof(display_bases) / sizeof(display_bases[0]);
+
+// Every display base at the widths the fields use, around the printable range
+// and the top bit of each width
+static U32 CheckNumbers()
+{
+    static const U32 widths[] = {1, 3, 6, 7, 8, 9, 16, 17, 32, 64};
+    static const U64 values[] = {0x0, 0x1, 0x5, 0x1F, 0x20, 0x41, 0x7E, 0x7F, 0x80, 0xFF, 0x100,
+                                 0x1234, 0x1FFFF, 0x89ABCDEF, 0x0123456789ABCDEFULL, ~0ULL};
+    U32 mismatches = 0;
+
+    for (U32 d = 0; d < display_count; d++)
+        for (U32 w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+            for (U32 v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+            {
+                U32 bits = widths[w];
+                U64 number = bits < 64 ? values[v] & ((1ULL << bits) - 1) : values[v];
+                char expected[128];
+                char actual[128];
+                AnalyzerHelpers::GetNumberString(number, display_bases[d], bits, expected, 128);
+                SDIOTextFormatter::FormatNumber(number, display_bases[d], bits, actual, 128);
+                if (strcmp(expected, actual) != 0)
+                {
+                    printf("mismatch: %s, %u bits, 0x%llX: \"%s\" instead of \"%s\"\n", display_names[d], bits,
+                           (unsigned long long)number, actual, expected);
+                    mismatches++;
+                }
+            }
+    return mismatches;
+}
+
+// Whole packet descriptions in every display base
+static U32 CheckPackets(const std::vector< std::vector<Field> > &packets)
+{
+    U32 mismatches = 0;
+    SDIOTextFormatter text;
+
+    for (U32 d = 0; d < display_count; d++)
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            const std::vector<Field> &packet = packets[i];
+            std::stringstream stream;
+            text.Clear();
+            for (size_t j = 0; j < packet.size(); j++)
+            {
+                StreamField(packet[j], display_bases[d], stream);
+                text.AppendField(packet[j].type, packet[j].data1, packet[j].data2, display_bases[d]);
+            }
+            if (stream.str() != std::string(text.GetText(), text.GetLength()))
+            {
+                printf("mismatch: %s, packet %u: \"%s\" instead of \"%s\"\n", display_names[d], U32(i),
+                       text.GetText(), stream.str().c_str());
+                mismatches++;
+            }
+        }
+    return mismatches;
+}
+
+static void AddPacket(std::vector< std::vector<Field> > &packets, const Field *fields, U32 count)
+{
+    packets.push_back(std::vector<Field>(fields, fields + count));
+}
+
+int main()
+{
+    const U32 iterations = 200000;
+    std::vector< std::vector<Field> > packets;
+
+    Field cmd52[] = {
+        {SDIODecoder::FRAME_DIR, 1, 0}, {SDIODecoder::FRAME_CMD, 52, 0},
+        {SDIODecoder::FRAME_CMD52_RWFLAG, 0, 0}, {SDIODecoder::FRAME_CMD52_FN, 1, 0},
+        {SDIODecoder::FRAME_CMD52_RAW, 0, 0}, {SDIODecoder::FRAME_CMD52_STUFF, 0, 1},
+        {SDIODecoder::FRAME_CMD52_ADDR, 0x1000, 0}, {SDIODecoder::FRAME_CMD52_STUFF, 0, 9},
+        {SDIODecoder::FRAME_CRC, 0x6B, 0}};
+    Field r5[] = {
+        {SDIODecoder::FRAME_DIR, 0, 0}, {SDIODecoder::FRAME_CMD, 52, 0},
+        {SDIODecoder::FRAME_CMD52_STUFF, 0, 16}, {SDIODecoder::FRAME_CMD52_FLAGS, 0x10, 16},
+        {SDIODecoder::FRAME_CMD52_DATA, 0x55, 0}, {SDIODecoder::FRAME_CRC, 0x4B, 0}};
+    Field cmd53[] = {
+        {SDIODecoder::FRAME_DIR, 1, 0}, {SDIODecoder::FRAME_CMD, 53, 0},
+        {SDIODecoder::FRAME_CMD52_RWFLAG, 1, 0}, {SDIODecoder::FRAME_CMD52_FN, 1, 0},
+        {SDIODecoder::FRAME_CMD53_BLOCK, 1, 0}, {SDIODecoder::FRAME_CMD53_OP, 1, 0},
+        {SDIODecoder::FRAME_CMD52_ADDR, 0x8000, 0}, {SDIODecoder::FRAME_CMD53_COUNT, 8, 0},
+        {SDIODecoder::FRAME_CRC, 0x70, 0}};
+    AddPacket(packets, cmd52, sizeof(cmd52) / sizeof(cmd52[0]));
+    AddPacket(packets, r5, sizeof(r5) / sizeof(r5[0]));
+    AddPacket(packets, cmd53, sizeof(cmd53) / sizeof(cmd53[0]));
+
+    U32 mismatches = CheckNumbers() + CheckPackets(packets);
+    U64 checksum = 0;
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (U32 i = 0; i < iterations; i++)
+    {
+        const std::vector<Field> &packet = packets[i % packets.size()];
+        std::stringstream stream;
+        for (size_t j = 0; j < packet.size(); j++)
+            StreamField(packet[j], Hexadecimal, stream);
+        checksum += stream.str().size();
+    }
+    std::chrono::high_resolution_clock::time_point middle = std::chrono::high_resolution_clock::now();
+
+    SDIOTextFormatter text;
+    for (U32 i = 0; i < iterations; i++)
+    {
+        const std::vector<Field> &packet = packets[i % packets.size()];
+        text.Clear();
+        for (size_t j = 0; j < packet.size(); j++)
+            text.AppendField(packet[j].type, packet[j].data1, packet[j].data2, Hexadecimal);
+        checksum -= text.GetLength();
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+    double before = std::chrono::duration<double, std::nano>(middle - start).count() / iterations;
+    double after = std::chrono::duration<double, std::nano>(end - middle).count() / iterations;
+
+    printf("stringstream + GetNumberString: %8.1f ns/packet\n", before);
+    printf("SDIOTextFormatter:              %8.1f ns/packet\n", after);
+    if (checksum != 0)
+        mismatches++;
+
+    if (mismatches != 0)
+    {
+        printf("%u outputs differ from GetNumberString()\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -40,11 +40,16 @@ os.chdir( ".." )
 #specify the search paths/dependencies/options for gcc
 include_paths = [ "./AnalyzerSDK/include" ]
 link_paths = [ "./AnalyzerSDK/lib" ]
-link_dependencies = [ "-lAnalyzer" ] #refers to libAnalyzer.dylib or libAnalyzer.so
+link_dependencies = [ "-lAnalyzer", "-lpthread" ] #refers to libAnalyzer.dylib or libAnalyzer.so, pthread for the live export writer
 
 debug_compile_flags = "-O0 -w -c -fpic -g -std=c++11"
 release_compile_flags = "-O3 -w -c -fpic -std=c++11"
 
+#SDIO_INSTRUMENTATION=1 builds in the decoder hot path counters
+if os.environ.get( "SDIO_INSTRUMENTATION" ):
+    debug_compile_flags += " -DSDIO_INSTRUMENTATION"
+    release_compile_flags += " -DSDIO_INSTRUMENTATION"
+
 #loop through all the cpp files, build up the gcc command line, and attempt to compile each cpp file
 for cpp_file in cpp_files:
 
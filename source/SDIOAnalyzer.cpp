@@ -22,15 +22,16 @@
 
 #include "SDIOAnalyzer.h"
 #include "SDIOAnalyzerSettings.h"
-#include <AnalyzerChannelData.h>
+#include <string.h>
 
 SDIOAnalyzer::SDIOAnalyzer()
 :    Analyzer2(),
     mSettings( new SDIOAnalyzerSettings() ),
     mSimulationInitilized( false ),
-    mAlreadyRun(false),
-    packetState(WAITING_FOR_PACKET),
-    frameState(TRANSMISSION_BIT)
+    mCheckpointKey( 0 ),
+    mRestart( false ),
+    mTriggerRun( false ),
+    mAlreadyRun(false)
 {
     SetAnalyzerSettings( mSettings.get() );
 }
@@ -38,6 +39,8 @@ SDIOAnalyzer::SDIOAnalyzer()
 SDIOAnalyzer::~SDIOAnalyzer()
 {
     KillThread();
+    mLiveExport.Close();
+    mCache.Close();
 }
 
 void SDIOAnalyzer::SetupResults()
@@ -49,550 +52,293 @@ void SDIOAnalyzer::SetupResults()
 void SDIOAnalyzer::WorkerThread()
 {
     mAlreadyRun = true;
+    mRestart = false;
+
+    //The run ends with a return or with the exception KillThread() throws
+    //through it, either way the export file is finished there
+    struct RunEnd
+    {
+        SDIOAnalyzer* mAnalyzer;
+        ~RunEnd() { mAnalyzer->mLiveExport.Close(); }
+    } run_end = {this};
 
     // mResults->AddChannelBubblesWillAppearOn(mSettings->mClockChannel);
     mResults->AddChannelBubblesWillAppearOn(mSettings->mCmdChannel);
+    for (U32 bus = 1; bus < mSettings->GetBusCount(); bus++)
+        mResults->AddChannelBubblesWillAppearOn(mSettings->mBusChannels[bus - 1][SDIOAnalyzerSettings::BUS_CMD]);
     // mResults->AddChannelBubblesWillAppearOn(mSettings->mDAT0Channel);
     // mResults->AddChannelBubblesWillAppearOn(mSettings->mDAT1Channel);
     // mResults->AddChannelBubblesWillAppearOn(mSettings->mDAT2Channel);
     // mResults->AddChannelBubblesWillAppearOn(mSettings->mDAT3Channel);
 
-    mClock = GetAnalyzerChannelData(mSettings->mClockChannel);
-    mCmd = GetAnalyzerChannelData(mSettings->mCmdChannel);
-    mDAT0 = GetAnalyzerChannelData(mSettings->mDAT0Channel);
-    mDAT1 = mSettings->mDAT1Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT1Channel);
-    mDAT2 = mSettings->mDAT2Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT2Channel);
-    mDAT3 = mSettings->mDAT3Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT3Channel);
-
-    mClock->AdvanceToNextEdge();
-    mCmd->AdvanceToAbsPosition(mClock->GetSampleNumber());
-    mDAT0->AdvanceToAbsPosition(mClock->GetSampleNumber());
-    if (mDAT1) mDAT1->AdvanceToAbsPosition(mClock->GetSampleNumber());
-    if (mDAT2) mDAT2->AdvanceToAbsPosition(mClock->GetSampleNumber());
-    if (mDAT3) mDAT3->AdvanceToAbsPosition(mClock->GetSampleNumber());
-
-    for ( ; ; ){
-        PacketStateMachine();
-
-        mResults->CommitResults();
-        ReportProgress(mClock->GetSampleNumber());
+    mClock.SetChannel(GetAnalyzerChannelData(mSettings->mClockChannel));
+    mCmd.SetChannel(GetAnalyzerChannelData(mSettings->mCmdChannel));
+    mDAT0.SetChannel(GetAnalyzerChannelData(mSettings->mDAT0Channel));
+    mDAT1.SetChannel(mSettings->mDAT1Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT1Channel));
+    mDAT2.SetChannel(mSettings->mDAT2Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT2Channel));
+    mDAT3.SetChannel(mSettings->mDAT3Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT3Channel));
+    mDAT4.SetChannel(mSettings->mDAT4Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT4Channel));
+    mDAT5.SetChannel(mSettings->mDAT5Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT5Channel));
+    mDAT6.SetChannel(mSettings->mDAT6Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT6Channel));
+    mDAT7.SetChannel(mSettings->mDAT7Channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(mSettings->mDAT7Channel));
+
+    SDIODecodeOptions options;
+    options.mOverview = mSettings->mDecodeDetail == SDIOAnalyzerSettings::DETAIL_OVERVIEW;
+    options.mCollapsePolls = mSettings->mRepeatedPolls == SDIOAnalyzerSettings::POLLS_COLLAPSE;
+    options.mCheckTiming = mSettings->mTimingChecks == SDIOAnalyzerSettings::TIMING_CHECK;
+    options.mPayloadDirectory = mSettings->mPayloadDirectory;
+    options.mCommandMask = mSettings->mCommandMask;
+    options.mFunctionFilter = mSettings->mFunctionFilter;
+    options.mStartSample = mSettings->mStartSample;
+    options.mEndSample = mSettings->mEndSample;
+    options.mCheckpointInterval = CHECKPOINT_INTERVAL;
+
+    //Trigger first, this run decodes from just before the trigger to the end
+    //of the capture and the run after it the whole capture.  The first run
+    //writes no files, its checkpoints and the cache would not be of the whole
+    //capture.
+    bool trigger_first = mSettings->mDecodeOrder == SDIOAnalyzerSettings::ORDER_TRIGGER_FIRST &&
+                         mSettings->GetBusCount() == 1 && !mTriggerRun &&
+                         GetTriggerSample() > GetSampleRate() / 1000 * TRIGGER_LEAD_MS;
+    mTriggerRun = trigger_first;
+    if (trigger_first)
+    {
+        options.mPayloadDirectory.clear();
+        options.mCheckpointInterval = 0;
     }
-}
 
-//Determine whether or not we are in a packet
-void SDIOAnalyzer::PacketStateMachine()
-{
-    if (packetState == WAITING_FOR_PACKET)
+    if (!mSettings->mLiveExportFile.empty() && !trigger_first)
+        mLiveExport.Open(mSettings->mLiveExportFile.c_str(), GetTriggerSample(), GetSampleRate());
+
+    if (mSettings->GetBusCount() > 1)
     {
-        //If we are not in a packet, let's advance to the next edge on the
-        //command line
-        mCmd->AdvanceToNextEdge();
-        U64 sampleNumber = mCmd->GetSampleNumber();
-        lastFallingClockEdge = sampleNumber;
-        mClock->AdvanceToAbsPosition(sampleNumber);
-        //After advancing to the next command line edge the clock can either
-        //high or low.  If it is high, we need to advance two clock edges.  If
-        //it is low, we only need to advance one clock edge.
-        if (mClock->GetBitState() == BIT_HIGH){
-            mClock->AdvanceToNextEdge();
-        }
+        DecodeBuses(options);
+        return;
+    }
 
-        mClock->AdvanceToNextEdge();
-        sampleNumber = mClock->GetSampleNumber();
+    //Checkpoints of the run before are only of use on the same lines
+    std::vector<SDIODecoderCheckpoint> checkpoints;
+    if (mCheckpointKey == CheckpointKey())
+        checkpoints = mDecoder.GetCheckpoints();
+    mCheckpointKey = CheckpointKey();
 
-        mCmd->AdvanceToAbsPosition(sampleNumber);
-        mDAT0->AdvanceToAbsPosition(sampleNumber);
-        if (mDAT1) mDAT1->AdvanceToAbsPosition(sampleNumber);
-        if (mDAT2) mDAT2->AdvanceToAbsPosition(sampleNumber);
-        if (mDAT3) mDAT3->AdvanceToAbsPosition(sampleNumber);
+    SDIOChannel* lines[] = {mClock.Get(), mCmd.Get(), mDAT0.Get(), mDAT1.Get(), mDAT2.Get(), mDAT3.Get(),
+                            mDAT4.Get(), mDAT5.Get(), mDAT6.Get(), mDAT7.Get()};
+    const U32 line_count = sizeof(lines) / sizeof(lines[0]);
 
-        if (mCmd->GetBitState() == BIT_LOW){
-            packetState = IN_PACKET;
+    if (trigger_first)
+    {
+        checkpoints.clear();
+        mCheckpointKey = 0;
+        if (!SeekTrigger(lines, line_count))
+        {
+            Restart();
+            return;
         }
+    }
 
-
+    mDecoder.SetUpperDataLines(lines[6], lines[7], lines[8], lines[9]);
+    mDecoder.Start(lines[0], lines[1], lines[2], lines[3], lines[4], lines[5], this, options);
+    mCache.Close();
+    bool resumed = false;
+    if (!trigger_first && !mSettings->mCacheDirectory.empty()){
+        U64 key = CacheKey(lines);
+        std::string file_name = SDIODecodeCache::FileName(mSettings->mCacheDirectory, key);
+        resumed = ReplayCache(file_name, key);
+        if (mRestart)
+            return;
+        if (!resumed)
+            mCache.Open(file_name.c_str(), key);
     }
-    else if (packetState == IN_PACKET)
+    size_t count = resumed ? 0 : mDecoder.FindCheckpoint(checkpoints, options.mStartSample);
+    if (count != 0 && !mDecoder.Resume(checkpoints, count))
     {
-        mClock->AdvanceToNextEdge();
-        U64 sampleNumber = mClock->GetSampleNumber();
-
-        mCmd->AdvanceToAbsPosition(sampleNumber);
-        mDAT0->AdvanceToAbsPosition(sampleNumber);
-        if (mDAT1) mDAT1->AdvanceToAbsPosition(sampleNumber);
-        if (mDAT2) mDAT2->AdvanceToAbsPosition(sampleNumber);
-        if (mDAT3) mDAT3->AdvanceToAbsPosition(sampleNumber);
-
-        if (mClock->GetBitState() == BIT_HIGH){
-            mResults->AddMarker(mClock->GetSampleNumber(),
-                AnalyzerResults::UpArrow, mSettings->mClockChannel);
-            if (FrameStateMachine()==1){
-                mResults->CommitPacketAndStartNewPacket();
-                mResults->CommitResults();
-                packetState = WAITING_FOR_PACKET;
-            }
-        }else{
-            lastFallingClockEdge = mClock->GetSampleNumber();
-        }
+        Restart();
+        return;
     }
-}
 
+    for ( ; ; ){
+        mDecoder.Step();
 
-//This state machine will deal with accepting the different parts of the
-//transmitted information.  In order to correctly interpret the data stream,
-//we need to be able to distinguish between 4 different kinds of packets.
-//They are:
-//    - Command
-//      - Short Response
-//  - Long Response
-//  - Data
+        ReportProgress(lines[0]->GetSampleNumber());
+    }
+}
 
-U32 SDIOAnalyzer::FrameStateMachine()
+//Moves the lines to the first host command after TRIGGER_LEAD_MS before the
+//trigger, the decode goes on from there to the end of the capture.  The
+//channel data is only read forwards and the frames are added in sample order,
+//so the packets before it are left to the run after this one, which decodes
+//the whole capture.  The block sizes set before it are not known.  False when
+//there is no command after it, the lines have moved on by then.
+bool SDIOAnalyzer::SeekTrigger(SDIOChannel* const* lines, U32 count)
 {
-    if (frameState == TRANSMISSION_BIT)
-    {
-        Frame frame;
-        frame.mStartingSampleInclusive = lastFallingClockEdge;
-        frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-        frame.mFlags = 0;
-        frame.mData1 = mCmd->GetBitState();
-        frame.mType = FRAME_DIR;
-        mResults->AddFrame(frame);
-
-        //The transmission bit tells us the origin of the packet
-        //If the bit is high the packet comes from the host
-        //If the bit is low, the packet comes from the slave
-        isCmd = mCmd->GetBitState();
-
+    U64 lead = GetSampleRate() / 1000 * TRIGGER_LEAD_MS;
+    return SDIODecoder::SeekCommand(lines, count, GetTriggerSample() - lead);
+}
 
-        frameState = COMMAND;
-        frameCounter = 6;
+//Nothing has been added to the results yet, the run after this one decodes
+//all of it
+void SDIOAnalyzer::Restart()
+{
+    mCache.Close();
+    mCheckpointKey = 0;
+    mRestart = true;
+}
 
-        startOfNextFrame = (frame.mEndingSampleInclusive + 1);
-        temp = 0;
-    }
-    else if (frameState == COMMAND)
+//Checkpoints and the decode cache are of a single bus, they are not used
+void SDIOAnalyzer::DecodeBuses(const SDIODecodeOptions &options)
+{
+    U32 bus_count = mSettings->GetBusCount();
+    SDIOChannel* lines[SDIOMultiBusDecoder::MAX_BUSES * SDIOMultiBusDecoder::LINE_COUNT];
+    lines[SDIOMultiBusDecoder::LINE_CMD] = mCmd.Get();
+    lines[SDIOMultiBusDecoder::LINE_DAT0] = mDAT0.Get();
+    lines[SDIOMultiBusDecoder::LINE_DAT1] = mDAT1.Get();
+    lines[SDIOMultiBusDecoder::LINE_DAT2] = mDAT2.Get();
+    lines[SDIOMultiBusDecoder::LINE_DAT3] = mDAT3.Get();
+    for (U32 bus = 1; bus < bus_count; bus++)
     {
-        temp = temp<<1 | mCmd->GetBitState();
-
-        frameCounter--;
-        if (frameCounter == 0)
+        for (U32 line = 0; line < SDIOAnalyzerSettings::BUS_LINES; line++)
         {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp; // Select the first 6 bits
-            frame.mType = FRAME_CMD;
-            mResults->AddFrame(frame);
-
-            //Once we have the arguement
-
-            //Find the expected length of the next reponse based on the command
-            if (isCmd && app){
-                //Deal with the application commands first
-                //All Application commands have a 48 bit response
-                respLength = 32;
-            }else if (isCmd){
-                //Deal with standard commands now
-                //CMD2, CMD9 and CMD10 respond with R2
-                if (temp == 2 || temp == 9 || temp == 10){
-                    respLength = 127;
-                    respType = RESP_LONG;
-                }else{
-                    // All others have 48 bit responses
-                    respLength = 32;
-                    respType = RESP_NORMAL;
-                }
-
-            }
-
-            if (temp == 52)
-              {
-                frameState = CMD52_ARGUMENT;
-
-                cmd52State = isCmd ? CMD52_RWFLAG : CMD52_RESP_STUFF;
-              }
-            else if (temp == 53)
-              {
-                frameState = CMD53_ARGUMENT;
-                // Are we decoding a command from host or response from device
-                // Based on this choose which state to start in
-                cmd53State = isCmd ? CMD53_RWFLAG : CMD53_RESP_STUFF;
-              }
-            else
-              {
-                frameState = ARGUMENT;
-              }
-
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-            if (isCmd){
-                frameCounter = 32;
-            }else{
-                frameCounter = respLength;
-            }
+            Channel &channel = mSettings->mBusChannels[bus - 1][line];
+            mBusLines[bus - 1][line].SetChannel(channel == UNDEFINED_CHANNEL ? nullptr : GetAnalyzerChannelData(channel));
+            lines[bus * SDIOMultiBusDecoder::LINE_COUNT + line] = mBusLines[bus - 1][line].Get();
         }
-
     }
-    else if (frameState == ARGUMENT)
-    {
-        temp = temp << 1 | mCmd->GetBitState();
-
-        frameCounter--;
-
-        if (!isCmd && frameCounter == 1 && respType == RESP_LONG){
-            temp = temp<<1;
-
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp2;
-            frame.mData2 = temp;
-            frame.mType = FRAME_LONG_ARG;
-            mResults->AddFrame(frame);
-
-            frameState = STOP;
-            frameCounter = 1;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-
-        }else if (frameCounter == 0){
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp; // Select the first 6 bits
-            frame.mType = FRAME_ARG;
-            mResults->AddFrame(frame);
-
-            frameState = CRC7;
-            frameCounter = 7;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-        }else if (frameCounter == 63 && !isCmd){
-            temp2 = temp;
-            temp = 0;
-        }
+
+    mBuses.Start(mClock.Get(), lines, bus_count, this, options);
+    for ( ; ; ){
+        mBuses.Step();
+
+        ReportProgress(mClock.GetSampleNumber());
     }
-    else if (frameState == CMD52_ARGUMENT)
+}
+
+//The lines and the sample rate the decoder state depends on
+U64 SDIOAnalyzer::CheckpointKey()
+{
+    Channel lines[] = {mSettings->mClockChannel, mSettings->mCmdChannel, mSettings->mDAT0Channel,
+                       mSettings->mDAT1Channel, mSettings->mDAT2Channel, mSettings->mDAT3Channel,
+                       mSettings->mDAT4Channel, mSettings->mDAT5Channel, mSettings->mDAT6Channel,
+                       mSettings->mDAT7Channel};
+    U64 key = GetSampleRate();
+    for (U32 i = 0; i < sizeof(lines) / sizeof(lines[0]); i++)
+        key = key * 1099511628211ULL ^ (lines[i].mDeviceId * 64 + lines[i].mChannelIndex + 1);
+    return key;
+}
+
+//The settings, the sample rate and the first edge of the clock, command and
+//DAT0-DAT7 lines.  Edges that have not been captured yet are left out, they
+//would block.
+U64 SDIOAnalyzer::CacheKey(SDIOChannel* const* lines)
+{
+    const char* settings = mSettings->SaveSettings();
+    U64 key = SDIODecodeCache::Hash(settings, strlen(settings), GetSampleRate());
+    for (U32 i = 0; i < 10; i++)
     {
-        temp = temp << 1 | mCmd->GetBitState();
-
-        frameCounter--;
-        if (cmd52State == CMD52_RWFLAG)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = mCmd->GetBitState();
-            frame.mType = FRAME_CMD52_RWFLAG;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_FN;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            // Keep track of if we're reading or writing
-            cmd52writenotread = mCmd->GetBitState() ? true : false;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_FN && frameCounter == 28)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD52_FN;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_RAW;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-          }
-        else if (cmd52State == CMD52_RAW)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = mCmd->GetBitState();
-            frame.mType = FRAME_CMD52_RAW;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_STUFF1;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_STUFF1)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = mCmd->GetBitState();
-            frame.mData2 = 1;
-            frame.mType = FRAME_CMD52_STUFF;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_ADDR;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_ADDR && frameCounter == 9)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD52_ADDR;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_STUFF2;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_STUFF2 && ((cmd52writenotread == false && frameCounter == 0)
-                            || cmd52writenotread == true))
-          {
-            // If we're writing, we'll only have a single STUFF2 bit,
-            // else if we're reading it'll be stuff bits until the end of the CMD52 argument field.
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD52_STUFF;
-
-            if (cmd52writenotread)
-              {
-            cmd52State = CMD52_DATA;
-            frame.mData2 = 1; // Store the length of the stuff bits in this case in data2
-              }
-            else
-              {
-            frame.mData2 = 9; // Store the length of the stuff bits in this case in data2
-            frameState = CRC7;
-            frameCounter = 7;
-              }
-            mResults->AddFrame(frame);
-
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_DATA && frameCounter == 0)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD52_DATA;
-            mResults->AddFrame(frame);
-
-            frameState = CRC7;
-            frameCounter = 7;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_RESP_STUFF && frameCounter == 16)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mData2 = 16;
-            frame.mType = FRAME_CMD52_STUFF;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_RESP_FLAGS;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd52State == CMD52_RESP_FLAGS && frameCounter == 8)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mData2 = 16;
-            frame.mType = FRAME_CMD52_FLAGS;
-            mResults->AddFrame(frame);
-
-            cmd52State = CMD52_DATA;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
+        U64 edge = 0;
+        if (lines[i] != nullptr && lines[i]->DoMoreTransitionsExistInCurrentData())
+            edge = lines[i]->GetSampleOfNextEdge();
+        key = SDIODecodeCache::Hash(&edge, sizeof(edge), key);
     }
-    else if (frameState == CMD53_ARGUMENT)
+    return key;
+}
+
+//Replays the packets of the cache file and carries on decoding after the
+//checkpoint they end at.  False if the decoder is still at the start, when
+//there is no usable file, or if the capture only starts like the cached one.
+//The command line edges up to the checkpoint tell, they are checked before
+//anything is replayed.  The lines have moved on then and the next run
+//decodes from the start.
+bool SDIOAnalyzer::ReplayCache(const std::string &file_name, U64 key)
+{
+    FILE* file = fopen(file_name.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    SDIODecodeCache::Header header;
+    std::vector<SDIODecoderCheckpoint> checkpoints;
+    if (fread(&header, sizeof(header), 1, file) == 1 && SDIODecodeCache::CheckHeader(header, key) && header.mHasCheckpoint)
+        checkpoints.push_back(header.mCheckpoint);
+    if (mDecoder.FindCheckpoint(checkpoints, ~U64(0)) == 0)
     {
-        temp = temp << 1 | mCmd->GetBitState();
-
-        frameCounter--;
-        if (cmd53State == CMD53_RWFLAG)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = mCmd->GetBitState();
-            frame.mType = FRAME_CMD52_RWFLAG;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_FN;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_FN && frameCounter == 28)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD52_FN;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_BLOCK;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-          }
-        else if (cmd53State == CMD53_BLOCK)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = mCmd->GetBitState();
-            frame.mType = FRAME_CMD53_BLOCK;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_OP;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_OP)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = mCmd->GetBitState();
-            frame.mType = FRAME_CMD53_OP;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_ADDR;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_ADDR && frameCounter == 9)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD52_ADDR;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_COUNT;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_COUNT && frameCounter == 0)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mType = FRAME_CMD53_COUNT;
-            mResults->AddFrame(frame);
-
-            frameState = CRC7;
-            frameCounter = 7;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_RESP_STUFF && frameCounter == 16)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mData2 = 16;
-            frame.mType = FRAME_CMD52_STUFF;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_RESP_FLAGS;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_RESP_FLAGS && frameCounter == 8)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mData2 = 16;
-            frame.mType = FRAME_CMD52_FLAGS;
-            mResults->AddFrame(frame);
-
-            cmd53State = CMD53_RESP_STUFF2;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
-        else if (cmd53State == CMD53_RESP_STUFF2 && frameCounter == 0)
-          {
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp;
-            frame.mData2 = 16;
-            frame.mType = FRAME_CMD52_STUFF;
-            mResults->AddFrame(frame);
-
-            frameState = CRC7;
-            frameCounter = 7;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-          }
+        fclose(file);
+        return false;
     }
-    else if (frameState == CRC7)
+
+    if (!mDecoder.Resume(checkpoints, 1))
     {
-        temp = temp << 1 | mCmd->GetBitState();
-
-        frameCounter--;
-        if (frameCounter == 0){
-            Frame frame;
-            frame.mStartingSampleInclusive = startOfNextFrame;
-            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
-            frame.mFlags = 0;
-            frame.mData1 = temp; // Select the first 6 bits
-            frame.mType = FRAME_CRC;
-            mResults->AddFrame(frame);
-
-            frameState = STOP;
-            startOfNextFrame = frame.mEndingSampleInclusive + 1;
-            temp = 0;
-        }
+        fclose(file);
+        remove(file_name.c_str());
+        Restart();
+        return false;
     }
-    else if (frameState == STOP)
+
+    std::vector<U8> buffer;
+    U64 remaining = header.mLength;
+    while (remaining != 0)
     {
-        frameState = TRANSMISSION_BIT;
-        return 1;
+        size_t used = buffer.size();
+        size_t size = remaining < (1 << 20) ? size_t(remaining) : (1 << 20);
+        buffer.resize(used + size);
+        if (fread(&buffer[used], 1, size, file) != size)
+            break;
+        remaining -= size;
+        size_t replayed = SDIODecodeCache::Replay(&buffer[0], buffer.size(), *this);
+        buffer.erase(buffer.begin(), buffer.begin() + replayed);
+        CommitResults();
     }
-    return 0;
+    fclose(file);
+    ReportProgress(header.mCheckpoint.mSample);
+
+    mCache.Append(file_name.c_str(), header);
+    return true;
+}
+
+void SDIOAnalyzer::AddFrame(const SDIOFrame &frame)
+{
+    Frame result;
+    result.mStartingSampleInclusive = frame.mStartingSampleInclusive;
+    result.mEndingSampleInclusive = frame.mEndingSampleInclusive;
+    result.mData1 = frame.mData1;
+    result.mData2 = frame.mData2;
+    result.mType = frame.mType;
+    result.mFlags = frame.mFlags;
+    mResults->AddFrame(result);
+    if (mLiveExport.IsOpen())
+        mLiveExport.AddFrame(result);
+    if (mCache.IsOpen())
+        mCache.AddFrame(frame);
+}
+
+void SDIOAnalyzer::AddMarker(U64 sample)
+{
+    mResults->AddMarker(sample, AnalyzerResults::UpArrow, mSettings->mClockChannel);
+    if (mCache.IsOpen())
+        mCache.AddMarker(sample);
+}
+
+void SDIOAnalyzer::CommitPacket()
+{
+    mResults->CommitPacketAndStartNewPacket();
+    if (mLiveExport.IsOpen())
+        mLiveExport.CommitPacket();
+    if (mCache.IsOpen())
+        mCache.CommitPacket();
+}
+
+void SDIOAnalyzer::CommitResults()
+{
+    mResults->CommitResults();
+}
+
+void SDIOAnalyzer::AddCheckpoint(const SDIODecoderCheckpoint &checkpoint)
+{
+    if (mCache.IsOpen())
+        mCache.AddCheckpoint(checkpoint);
 }
 
 bool SDIOAnalyzer::NeedsRerun()
 {
-    return !mAlreadyRun;
+    return !mAlreadyRun || mRestart || mTriggerRun;
 }
 
 U32 SDIOAnalyzer::GenerateSimulationData( U64 minimum_sample_index, U32 device_sample_rate, SimulationChannelDescriptor** simulation_channels )
@@ -24,11 +24,16 @@
 #define SDIO_ANALYZER_H
 
 #include <Analyzer.h>
+#include <AnalyzerChannelData.h>
 #include "SDIOAnalyzerResults.h"
 #include "SDIOSimulationDataGenerator.h"
+#include "SDIODecoder.h"
+#include "SDIOLiveExport.h"
+#include "SDIODecodeCache.h"
+#include "SDIOMultiBusDecoder.h"
 
 class SDIOAnalyzerSettings;
-class ANALYZER_EXPORT SDIOAnalyzer : public Analyzer2
+class ANALYZER_EXPORT SDIOAnalyzer : public Analyzer2, public SDIOFrameSink
 {
 public:
     SDIOAnalyzer();
@@ -42,10 +47,18 @@ public:
     virtual const char* GetAnalyzerName() const;
     virtual bool NeedsRerun();
 
-    enum frameTypes {FRAME_DIR, FRAME_CMD, FRAME_ARG, FRAME_LONG_ARG, FRAME_CRC,
-             FRAME_CMD52_RWFLAG,FRAME_CMD52_FN,FRAME_CMD52_RAW,FRAME_CMD52_STUFF,
-             FRAME_CMD52_ADDR,FRAME_CMD52_DATA,FRAME_CMD52_FLAGS,
-             FRAME_CMD53_BLOCK, FRAME_CMD53_OP, FRAME_CMD53_COUNT};
+    // Only counted when built with SDIO_INSTRUMENTATION
+    const SDIODecodeCounters& GetDecodeCounters() const { return mDecoder.GetDecodeCounters(); }
+    const SDIOEnumerationTimeline& GetEnumerationTimeline() const { return mDecoder.GetEnumerationTimeline(); }
+    const SDIOResponseTiming& GetResponseTiming() const { return mDecoder.GetResponseTiming(); }
+    const SDIORegisterHeatmap& GetRegisterHeatmap() const { return mDecoder.GetRegisterHeatmap(); }
+
+    // SDIOFrameSink, the decoded frames go to the results
+    virtual void AddFrame(const SDIOFrame &frame);
+    virtual void AddMarker(U64 sample);
+    virtual void CommitPacket();
+    virtual void CommitResults();
+    virtual void AddCheckpoint(const SDIODecoderCheckpoint &checkpoint);
 
 #pragma warning( push )
 #pragma warning( disable : 4251 ) //warning C4251: 'SerialAnalyzer::<...>' : class <...> needs to have dll-interface to be used by clients of class
@@ -53,48 +66,58 @@ protected: //vars
     std::auto_ptr< SDIOAnalyzerSettings > mSettings;
     std::auto_ptr< SDIOAnalyzerResults > mResults;
 
-    AnalyzerChannelData* mClock;
-    AnalyzerChannelData* mCmd;
-    AnalyzerChannelData* mDAT0;
-    AnalyzerChannelData* mDAT1;
-    AnalyzerChannelData* mDAT2;
-    AnalyzerChannelData* mDAT3;
+    SDIOChannelAdapter< AnalyzerChannelData > mClock;
+    SDIOChannelAdapter< AnalyzerChannelData > mCmd;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT0;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT1;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT2;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT3;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT4;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT5;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT6;
+    SDIOChannelAdapter< AnalyzerChannelData > mDAT7;
 
     SDIOSimulationDataGenerator mSimulationDataGenerator;
     bool mSimulationInitilized;
 
+    SDIODecoder mDecoder;
+    SDIOLiveExport mLiveExport;
+
+    // Packets between decoder checkpoints.  A re-run with a sample range
+    // starts from the last checkpoint before it instead of sample 0.
+    enum {CHECKPOINT_INTERVAL = 4096};
+    U64 CheckpointKey();
+    U64 mCheckpointKey;
+
+    // A checkpoint turned out to be of another capture after the lines moved
+    // to it, NeedsRerun() asks for a run from sample 0 without checkpoints
+    void Restart();
+    bool mRestart;
+
+    // The packets of a capture decoded before with the same settings are
+    // loaded from the cache folder up to its last checkpoint.  The key is not
+    // of all the channel data since it can only be read once, the first edge
+    // of every line stands in for it.  The hash of the command line edges in
+    // the checkpoint is checked before the packets are replayed.
+    U64 CacheKey(SDIOChannel* const* lines);
+    bool ReplayCache(const std::string &file_name, U64 key);
+    SDIODecodeCacheWriter mCache;
+
+    // Further buses on the same clock
+    void DecodeBuses(const SDIODecodeOptions &options);
+    SDIOChannelAdapter< AnalyzerChannelData > mBusLines[SDIOMultiBusDecoder::MAX_BUSES - 1][SDIOMultiBusDecoder::LINE_COUNT];
+    SDIOMultiBusDecoder mBuses;
+
+    // Trigger-first order, a single bus is decoded from TRIGGER_LEAD_MS
+    // before the trigger on, NeedsRerun() then asks for a run from sample 0
+    enum {TRIGGER_LEAD_MS = 1};
+    bool SeekTrigger(SDIOChannel* const* lines, U32 count);
+    bool mTriggerRun;
+
 #pragma warning( pop )
 
 private:
     bool mAlreadyRun;
-
-    U64 lastFallingClockEdge;
-    U64 startOfNextFrame;
-    void PacketStateMachine();
-    enum packetStates {WAITING_FOR_PACKET, IN_PACKET};
-    U32 packetState;
-
-    U32 FrameStateMachine();
-    enum frameStates {TRANSMISSION_BIT, COMMAND, ARGUMENT, CMD52_ARGUMENT, CMD53_ARGUMENT, CRC7, STOP};
-    U32 frameState;
-    U32 frameCounter;
-
-    enum cmd52States {CMD52_RWFLAG,CMD52_FN,CMD52_RAW,CMD52_STUFF1,CMD52_ADDR,
-              CMD52_STUFF2,CMD52_DATA,CMD52_RESP_STUFF,CMD52_RESP_FLAGS};
-    enum cmd53States {CMD53_RWFLAG,CMD53_FN,CMD53_BLOCK,CMD53_OP,CMD53_ADDR,
-              CMD53_COUNT,CMD53_RESP_STUFF,CMD53_RESP_FLAGS,CMD53_RESP_STUFF2};
-    U32 cmd52State;
-    U32 cmd53State;
-    bool cmd52writenotread;
-
-    bool app;
-    bool isCmd;
-    U8 respLength;
-    enum respTypes {RESP_NORMAL,RESP_LONG};
-    U8 respType;
-
-    U64 temp;
-    U64 temp2;
 };
 
 extern "C" ANALYZER_EXPORT const char* __cdecl GetAnalyzerName();
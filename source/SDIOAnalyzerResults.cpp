@@ -24,9 +24,10 @@
 #include <AnalyzerHelpers.h>
 #include "SDIOAnalyzer.h"
 #include "SDIOAnalyzerSettings.h"
-#include <iostream>
+#include "SDIOTextFormatter.h"
+#include "SDIOParallelExport.h"
+#include "SDIOTraceExport.h"
 #include <fstream>
-#include <sstream>
 
 SDIOAnalyzerResults::SDIOAnalyzerResults( SDIOAnalyzer* analyzer, SDIOAnalyzerSettings* settings )
 :    AnalyzerResults(),
@@ -46,9 +47,13 @@ void SDIOAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel,
     ClearResultStrings();
     Frame frame = GetFrame( frame_index );
 
+    // Frames of the other buses go on their own command lines
+    if (GetFrameBus(frame) != mSettings->GetChannelBus(channel))
+        return;
+
     char number_str1[128];
     char number_str2[128];
-    if (frame.mType == SDIOAnalyzer::FRAME_DIR){
+    if (frame.mType == SDIODecoder::FRAME_DIR){
         if (frame.mData1){
             AddResultString("H");
             AddResultString("Host");
@@ -58,21 +63,21 @@ void SDIOAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel,
             AddResultString("Slave");
             AddResultString("DIR: Slave");
         }
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD){
-        AnalyzerHelpers::GetNumberString( frame.mData1, Decimal, 6, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD){
+        SDIOTextFormatter::FormatNumber( frame.mData1, Decimal, 6, number_str1, 128 );
         AddResultString("CMD ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_ARG){
-        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 32, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_ARG){
+        SDIOTextFormatter::FormatNumber( frame.mData1, display_base, 32, number_str1, 128 );
         AddResultString("ARG ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_LONG_ARG){
-        AnalyzerHelpers::GetNumberString (frame.mData1, display_base, 64, number_str1, 128);
-        AnalyzerHelpers::GetNumberString (frame.mData2, display_base, 64, number_str2, 128);
+    }else if (frame.mType == SDIODecoder::FRAME_LONG_ARG){
+        SDIOTextFormatter::FormatNumber(frame.mData1, display_base, 64, number_str1, 128);
+        SDIOTextFormatter::FormatNumber(frame.mData2, display_base, 64, number_str2, 128);
         AddResultString("LONG: ", number_str1, number_str2);
 
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CRC){
-        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 7, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CRC){
+        SDIOTextFormatter::FormatNumber( frame.mData1, display_base, 7, number_str1, 128 );
         AddResultString("CRC ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_RWFLAG){
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_RWFLAG){
       if (frame.mData1)
         {
           AddResultString("W");
@@ -85,41 +90,80 @@ void SDIOAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel,
           //AddResultString("Read");
           //AddResultString("Register Read");
         }
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_FN){
-        AnalyzerHelpers::GetNumberString( frame.mData1, Decimal, 3, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_FN){
+        SDIOTextFormatter::FormatNumber( frame.mData1, Decimal, 3, number_str1, 128 );
         AddResultString("F", number_str1);
         AddResultString("Func: ", number_str1);
         //AddResultString("Function: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_RAW){
-        AnalyzerHelpers::GetNumberString( frame.mData1, Decimal, 1, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_RAW){
+        SDIOTextFormatter::FormatNumber( frame.mData1, Decimal, 1, number_str1, 128 );
         AddResultString("RAW: ", number_str1);
         AddResultString("Read after write: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_STUFF){
-        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, frame.mData2, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_STUFF){
+        SDIOTextFormatter::FormatNumber( frame.mData1, display_base, frame.mData2, number_str1, 128 );
         AddResultString("D/C");
         AddResultString("Stuff bits: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_ADDR){
-        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 17, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_ADDR){
+        SDIOTextFormatter::FormatNumber( frame.mData1, display_base, 17, number_str1, 128 );
         AddResultString("Addr: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_DATA){
-        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 8, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_DATA){
+        SDIOTextFormatter::FormatNumber( frame.mData1, display_base, 8, number_str1, 128 );
         AddResultString("Data: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_FLAGS){
-        AnalyzerHelpers::GetNumberString( frame.mData1, Binary, 8, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD52_FLAGS){
+        SDIOTextFormatter::FormatNumber( frame.mData1, Binary, 8, number_str1, 128 );
         AddResultString("Response flags: ", number_str1);
         AddResultString("F: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD53_BLOCK){
-      AnalyzerHelpers::GetNumberString( frame.mData1, Decimal, 1, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD53_BLOCK){
+      SDIOTextFormatter::FormatNumber( frame.mData1, Decimal, 1, number_str1, 128 );
       AddResultString("B: ", number_str1);
       AddResultString("Block: ", number_str1);
       AddResultString("Block mode: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD53_OP){
-      AnalyzerHelpers::GetNumberString( frame.mData1, Decimal, 1, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD53_OP){
+      SDIOTextFormatter::FormatNumber( frame.mData1, Decimal, 1, number_str1, 128 );
       AddResultString("Op: ", number_str1);
-    }else if (frame.mType == SDIOAnalyzer::FRAME_CMD53_COUNT){
-      AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 9, number_str1, 128 );
+    }else if (frame.mType == SDIODecoder::FRAME_CMD53_COUNT){
+      SDIOTextFormatter::FormatNumber( frame.mData1, display_base, 9, number_str1, 128 );
       AddResultString("C: ", number_str1);
       AddResultString("Count: ", number_str1);
+    }else if (frame.mType == SDIODecoder::FRAME_PACKET){
+      Frame fields[MAX_PACKET_FIELDS];
+      U32 count = ExpandPacketFrame(frame, fields);
+      SDIOTextFormatter text;
+      for (U32 i = 0; i < count; i++)
+        text.AppendField(fields[i].mType, fields[i].mData1, fields[i].mData2, display_base);
+
+      SDIOTextFormatter::FormatNumber( fields[1].mData1, Decimal, 6, number_str1, 128 );
+      AddResultString("CMD", number_str1);
+      AddResultString(fields[0].mData1 ? "H->S CMD" : "S->H CMD", number_str1);
+      AddResultString(text.GetText());
+    }else if (frame.mType == SDIODecoder::FRAME_IRQ || frame.mType == SDIODecoder::FRAME_BUSY){
+      bool irq = frame.mType == SDIODecoder::FRAME_IRQ;
+      SDIOTextFormatter text;
+      text.AppendDuration(frame.mData1, mAnalyzer->GetSampleRate());
+      AddResultString(irq ? "IRQ" : "BSY");
+      AddResultString(irq ? "IRQ " : "Busy ", text.GetText());
+      text.Clear();
+      text.AppendTiming(frame.mType, frame.mData1, mAnalyzer->GetSampleRate());
+      AddResultString(text.GetText());
+    }else if (frame.mType == SDIODecoder::FRAME_REPEAT){
+      SDIOTextFormatter::FormatNumber( frame.mData1, Decimal, 64, number_str1, 128 );
+      AddResultString("x", number_str1);
+      AddResultString("Repeated x", number_str1);
+      SDIOTextFormatter text;
+      text.AppendRepeat(frame.mData1, frame.mData2, mAnalyzer->GetSampleRate());
+      AddResultString(text.GetText());
+    }else if (frame.mType == SDIODecoder::FRAME_DATA_CRC){
+      SDIOTextFormatter text;
+      text.AppendField(frame.mType, frame.mData1, frame.mData2, display_base);
+      AddResultString("CRC16");
+      AddResultString(text.GetText());
+    }else if (frame.mType == SDIODecoder::FRAME_TIMING){
+      SDIOResponseTiming::Violation violation;
+      SDIOResponseTiming::Unpack(frame.mData1, violation);
+      SDIOTextFormatter text;
+      text.AppendField(frame.mType, frame.mData1, frame.mData2, display_base);
+      AddResultString(SDIOResponseTiming::GetCheckName(violation.mCheck));
+      AddResultString(text.GetText());
     }
 }
 
@@ -127,39 +171,98 @@ void SDIOAnalyzerResults::GenerateExportFile( const char* file, DisplayBase disp
 {
     std::ofstream file_stream( file, std::ios::out );
 
+    SDIOTextFormatter text;
+    if (export_type_user_id == SDIOAnalyzerSettings::EXPORT_COUNTERS)
+    {
+        // Counters of the decode so far, they are only read, never locked
+        mAnalyzer->GetDecodeCounters().Format(text);
+        file_stream.write(text.GetText(), text.GetLength());
+        file_stream.close();
+        return;
+    }
+
     U64 trigger_sample = mAnalyzer->GetTriggerSample();
     U32 sample_rate = mAnalyzer->GetSampleRate();
 
-    file_stream << "Time [s],Value" << std::endl;
+    if (export_type_user_id == SDIOAnalyzerSettings::EXPORT_TIMELINE)
+    {
+        mAnalyzer->GetEnumerationTimeline().Format(text, trigger_sample, sample_rate);
+        file_stream.write(text.GetText(), text.GetLength());
+        file_stream.close();
+        return;
+    }
 
-    U64 num_packets = GetNumPackets();
-    file_stream << num_packets << std::endl;
+    if (export_type_user_id == SDIOAnalyzerSettings::EXPORT_TIMING)
+    {
+        mAnalyzer->GetResponseTiming().Format(text);
+        file_stream.write(text.GetText(), text.GetLength());
+        file_stream.close();
+        return;
+    }
 
-    for( U64 i = 0; i < num_packets; i++ )
+    if (export_type_user_id == SDIOAnalyzerSettings::EXPORT_REGISTERS)
     {
-        char time_str[128];
-        U64 first_frame_id, last_frame_id;
+        mAnalyzer->GetRegisterHeatmap().Format(text, sample_rate);
+        file_stream.write(text.GetText(), text.GetLength());
+        file_stream.close();
+        return;
+    }
 
-        GetFramesContainedInPacket(i, &first_frame_id, &last_frame_id );
+    if (export_type_user_id == SDIOAnalyzerSettings::EXPORT_TRACE)
+    {
+        GenerateTraceFile(file_stream, trigger_sample, sample_rate);
+        file_stream.close();
+        return;
+    }
 
-        Frame frame = GetFrame(first_frame_id);
+    char number_str[128];
+
+    U64 num_packets = GetNumPackets();
+    text.Append("Time [s],Value\n");
+    SDIOTextFormatter::FormatNumber(num_packets, Decimal, 64, number_str, 128);
+    text.Append(number_str);
+    text.Append("\n");
+    file_stream.write(text.GetText(), text.GetLength());
+
+    // Formatted a chunk of packets at a time on the export threads
+    SDIOParallelExport export_threads(display_base, trigger_sample, sample_rate);
+    if( export_threads.Write(*this, file_stream) == false )
+    {
+        file_stream.close();
+        return;
+    }
+
+    UpdateExportProgressAndCheckForCancel( num_packets, num_packets );
+
+    file_stream.close();
+}
 
-        AnalyzerHelpers::GetTimeString(frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128);
+// Streamed a packet at a time, the JSON is closed even when cancelled
+void SDIOAnalyzerResults::GenerateTraceFile( std::ostream &file_stream, U64 trigger_sample, U32 sample_rate )
+{
+    double offset;
+    SDIOTraceExport::ParseOffset(mSettings->mTraceOffset.c_str(), offset);
+    SDIOTraceExport trace(file_stream, trigger_sample, sample_rate, offset);
+    trace.Begin(mSettings->GetBusCount());
 
-        file_stream << std::endl << time_str << ", ";
+    std::vector<Frame> frames;
+    U64 num_packets = GetNumPackets();
+    for( U64 i = 0; i < num_packets; i++ )
+    {
+        U64 first_frame_id, last_frame_id;
+        GetFramesContainedInPacket(i, &first_frame_id, &last_frame_id );
 
-        GeneratePacketDescription(i, display_base, file_stream);
+        frames.clear();
+        for( U64 f = first_frame_id; f <= last_frame_id; f++ )
+            frames.push_back(GetFrame(f));
+        trace.AddPacket(&frames[0], U32(frames.size()));
 
         if( UpdateExportProgressAndCheckForCancel( i, num_packets ) == true )
-        {
-            file_stream.close();
-            return;
-        }
+            break;
     }
 
+    trace.End();
     UpdateExportProgressAndCheckForCancel( num_packets, num_packets );
-
-    file_stream.close();
 }
 
 void SDIOAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase display_base )
@@ -173,10 +276,10 @@ void SDIOAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase
         mLastPacket = packet;
         mLastFrame = frame_index;
 
-        std::stringstream stream;
-        GeneratePacketDescription(packet, display_base, stream);
+        SDIOTextFormatter text;
+        GeneratePacketDescription(packet, display_base, text);
         ClearTabularText();
-        AddTabularText(stream.str().c_str());
+        AddTabularText(text.GetText());
     } else {
         // Clearing the text at all so that is is not shown for frames we are not interested in
         ClearTabularText();
@@ -185,11 +288,11 @@ void SDIOAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase
 
 void SDIOAnalyzerResults::GeneratePacketTabularText( U64 packet_id, DisplayBase display_base )
 {
-    std::stringstream stream;
+    SDIOTextFormatter text;
 
-    GeneratePacketDescription(packet_id, display_base, stream);
+    GeneratePacketDescription(packet_id, display_base, text);
     ClearTabularText();
-    AddTabularText(stream.str().c_str());
+    AddTabularText(text.GetText());
 }
 
 void SDIOAnalyzerResults::GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base )
@@ -197,106 +300,200 @@ void SDIOAnalyzerResults::GenerateTransactionTabularText( U64 transaction_id, Di
 
 }
 
-void SDIOAnalyzerResults::GeneratePacketDescription(U64 packet_id, DisplayBase display_base, std::ostream &stream) {
+void SDIOAnalyzerResults::GeneratePacketDescription(U64 packet_id, DisplayBase display_base, SDIOTextFormatter &text) {
 
     U64 first_frame_id, last_frame_id;
     GetFramesContainedInPacket(packet_id, &first_frame_id, &last_frame_id);
 
+    // Every packet is of one bus
+    U32 bus = GetFrameBus(GetFrame( first_frame_id ));
+    if (bus != 0)
+        text.AppendBus(bus);
+
     for( U64 i = first_frame_id; i <= last_frame_id; i++ )
     {
         Frame frame = GetFrame( i );
+        AppendFrameDescription(frame, display_base, mAnalyzer->GetSampleRate(), text);
+    } // for( U64 i = first_frame_id; i <= last_frame_id; i++ )
+
+}
+
+void SDIOAnalyzerResults::AppendExportLine(const Frame *frames, U32 count, DisplayBase display_base, U64 trigger_sample, U32 sample_rate, SDIOTextFormatter &text)
+{
+    U64 start = frames[0].mStartingSampleInclusive;
+    if (frames[0].mType == SDIODecoder::FRAME_IRQ || frames[0].mType == SDIODecoder::FRAME_BUSY)
+        start = frames[0].mData2;
+
+    char time_str[128];
+    AnalyzerHelpers::GetTimeString(start, trigger_sample, sample_rate, time_str, 128);
+    text.Append("\n");
+    text.Append(time_str);
+    text.Append(", ");
+
+    // Same as GeneratePacketDescription()
+    U32 bus = GetFrameBus(frames[0]);
+    if (bus != 0)
+        text.AppendBus(bus);
+
+    for( U32 i = 0; i < count; i++ )
+        AppendFrameDescription(frames[i], display_base, sample_rate, text);
+}
+
+U32 SDIOAnalyzerResults::GetFrameBus(const Frame &frame)
+{
+    return (frame.mFlags & SDIODecoder::FRAME_BUS_MASK) >> SDIODecoder::FRAME_BUS_SHIFT;
+}
+
+void SDIOAnalyzerResults::CopyFrame(const Frame &frame, Frame &copy)
+{
+    copy.mStartingSampleInclusive = frame.mStartingSampleInclusive;
+    copy.mEndingSampleInclusive = frame.mEndingSampleInclusive;
+    copy.mData1 = frame.mData1;
+    copy.mData2 = frame.mData2;
+    copy.mType = frame.mType;
+    copy.mFlags = frame.mFlags;
+}
 
-        char number_str1[128];
-        char number_str2[128];
-        if (frame.mType == SDIOAnalyzer::FRAME_DIR)
+void SDIOAnalyzerResults::AppendFrameDescription(const Frame &frame, DisplayBase display_base, U32 sample_rate, SDIOTextFormatter &text)
+{
+    if (frame.mType == SDIODecoder::FRAME_PACKET)
+    {
+        Frame fields[MAX_PACKET_FIELDS];
+        U32 count = ExpandPacketFrame(frame, fields);
+        for (U32 j = 0; j < count; j++)
         {
-            if (frame.mData1)
+            text.AppendField(fields[j].mType, fields[j].mData1, fields[j].mData2, display_base);
+        }
+    }
+    else if (frame.mType == SDIODecoder::FRAME_IRQ || frame.mType == SDIODecoder::FRAME_BUSY)
+    {
+        text.AppendTiming(frame.mType, frame.mData1, sample_rate);
+    }
+    else if (frame.mType == SDIODecoder::FRAME_REPEAT)
+    {
+        text.AppendRepeat(frame.mData1, frame.mData2, sample_rate);
+    }
+    else
+    {
+        text.AppendField(frame.mType, frame.mData1, frame.mData2, display_base);
+    }
+}
+
+// Rebuild the field frames FrameStateMachine() produces in full mode from the
+// raw bits of an overview packet frame.  The sample ranges are spread evenly
+// over the packet since only its boundaries were stored.
+U32 SDIOAnalyzerResults::ExpandPacketFrame(const Frame &packet, Frame *fields)
+{
+    struct Field { U8 type; U32 bits; U64 data1; U64 data2; };
+    Field f[MAX_PACKET_FIELDS];
+    U32 count = 0;
+    U32 totalBits;
+
+    if (packet.mFlags & SDIODecoder::PACKET_FLAG_LONG)
+    {
+        // Start bit, direction, 6 reserved bits, 127 bit argument and end bit
+        totalBits = 136;
+        Field dir = {SDIODecoder::FRAME_DIR, 2, 0, 0};
+        Field cmd = {SDIODecoder::FRAME_CMD, 6, 63, 0};
+        Field arg = {SDIODecoder::FRAME_LONG_ARG, 127, packet.mData1, packet.mData2};
+        f[count++] = dir;
+        f[count++] = cmd;
+        f[count++] = arg;
+    }
+    else
+    {
+        totalBits = 48;
+        U64 raw = packet.mData1;
+        U64 isCmd = (raw >> 46) & 0x1;
+        U64 index = (raw >> 40) & 0x3F;
+        U64 arg = (raw >> 8) & 0xFFFFFFFF;
+
+        Field dir = {SDIODecoder::FRAME_DIR, 2, isCmd, 0};
+        Field cmd = {SDIODecoder::FRAME_CMD, 6, index, 0};
+        f[count++] = dir;
+        f[count++] = cmd;
+
+        if (index == 52 && isCmd)
+        {
+            Field rw = {SDIODecoder::FRAME_CMD52_RWFLAG, 1, arg >> 31, 0};
+            Field fn = {SDIODecoder::FRAME_CMD52_FN, 3, (arg >> 28) & 0x7, 0};
+            Field raw_flag = {SDIODecoder::FRAME_CMD52_RAW, 1, (arg >> 27) & 0x1, 0};
+            Field stuff = {SDIODecoder::FRAME_CMD52_STUFF, 1, (arg >> 26) & 0x1, 1};
+            Field addr = {SDIODecoder::FRAME_CMD52_ADDR, 17, (arg >> 9) & 0x1FFFF, 0};
+            f[count++] = rw;
+            f[count++] = fn;
+            f[count++] = raw_flag;
+            f[count++] = stuff;
+            f[count++] = addr;
+            if (arg >> 31)
             {
-                stream << "H->S | ";
+                Field stuff2 = {SDIODecoder::FRAME_CMD52_STUFF, 1, (arg >> 8) & 0x1, 1};
+                Field data = {SDIODecoder::FRAME_CMD52_DATA, 8, arg & 0xFF, 0};
+                f[count++] = stuff2;
+                f[count++] = data;
             }
             else
             {
-                stream << "S->H | ";
+                Field stuff2 = {SDIODecoder::FRAME_CMD52_STUFF, 9, arg & 0x1FF, 9};
+                f[count++] = stuff2;
             }
         }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Decimal, 6, number_str1, 128);
-            stream << "CMD: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_ARG)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 32, number_str1, 128);
-            stream << "ARG: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_LONG_ARG)
+        else if (index == 53 && isCmd)
         {
-            AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 64, number_str1, 128);
-            AnalyzerHelpers::GetNumberString(frame.mData2, display_base, 64, number_str2, 128);
-            stream << "LARG: " << number_str1 << " " << number_str2 << " | ";
+            Field rw = {SDIODecoder::FRAME_CMD52_RWFLAG, 1, arg >> 31, 0};
+            Field fn = {SDIODecoder::FRAME_CMD52_FN, 3, (arg >> 28) & 0x7, 0};
+            Field block = {SDIODecoder::FRAME_CMD53_BLOCK, 1, (arg >> 27) & 0x1, 0};
+            Field op = {SDIODecoder::FRAME_CMD53_OP, 1, (arg >> 26) & 0x1, 0};
+            Field addr = {SDIODecoder::FRAME_CMD52_ADDR, 17, (arg >> 9) & 0x1FFFF, 0};
+            Field count_field = {SDIODecoder::FRAME_CMD53_COUNT, 9, arg & 0x1FF, 0};
+            f[count++] = rw;
+            f[count++] = fn;
+            f[count++] = block;
+            f[count++] = op;
+            f[count++] = addr;
+            f[count++] = count_field;
         }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CRC)
+        else if (index == 52 || index == 53)
         {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, 7, number_str1, 128);
-            stream << "CRC: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_RWFLAG)
-        {
-            if (frame.mData1)
+            // R5 response: stuff bits, response flags and the read/write data
+            Field stuff = {SDIODecoder::FRAME_CMD52_STUFF, 16, arg >> 16, 16};
+            Field flags = {SDIODecoder::FRAME_CMD52_FLAGS, 8, (arg >> 8) & 0xFF, 16};
+            f[count++] = stuff;
+            f[count++] = flags;
+            if (index == 52)
             {
-                stream << "W |";
+                Field data = {SDIODecoder::FRAME_CMD52_DATA, 8, arg & 0xFF, 0};
+                f[count++] = data;
             }
             else
             {
-                stream << "R |";
+                Field stuff2 = {SDIODecoder::FRAME_CMD52_STUFF, 8, arg & 0xFF, 16};
+                f[count++] = stuff2;
             }
         }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_FN)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Decimal, 3, number_str1, 128);
-            stream << "Func: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_RAW)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Decimal, 1, number_str1, 128);
-            stream << "Read after write: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_STUFF)
-        {
-            //AnalyzerHelpers::GetNumberString(frame.mData1, display_base, frame.mData2, number_str1, 128);
-            //stream << "Stuff bits: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_ADDR)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 17, number_str1, 128);
-            stream << "Addr: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_DATA)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Hexadecimal, 8, number_str1, 128);
-            stream << "Data: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD52_FLAGS)
+        else
         {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Binary, 8, number_str1, 128);
-            stream << "Response flags: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD53_BLOCK)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Decimal, 1, number_str1, 128);
-            stream << "Block mode: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD53_OP)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Decimal, 1, number_str1, 128);
-            stream << "Op: " << number_str1 << " | ";
-        }
-        else if (frame.mType == SDIOAnalyzer::FRAME_CMD53_COUNT)
-        {
-            AnalyzerHelpers::GetNumberString(frame.mData1, Decimal, 9, number_str1, 128);
-            stream << "Count: " << number_str1 << " | ";
+            Field argument = {SDIODecoder::FRAME_ARG, 32, arg, 0};
+            f[count++] = argument;
         }
 
-    } // for( U64 i = first_frame_id; i <= last_frame_id; i++ )
+        Field crc = {SDIODecoder::FRAME_CRC, 7, (raw >> 1) & 0x7F, 0};
+        f[count++] = crc;
+    }
 
+    S64 start = packet.mStartingSampleInclusive;
+    S64 length = packet.mEndingSampleInclusive - packet.mStartingSampleInclusive + 1;
+    U32 bit = 0;
+    for (U32 i = 0; i < count; i++)
+    {
+        fields[i].mStartingSampleInclusive = start + length * bit / totalBits;
+        bit += f[i].bits;
+        fields[i].mEndingSampleInclusive = start + length * bit / totalBits - 1;
+        fields[i].mType = f[i].type;
+        fields[i].mFlags = 0;
+        fields[i].mData1 = f[i].data1;
+        fields[i].mData2 = f[i].data2;
+    }
+    return count;
 }
+
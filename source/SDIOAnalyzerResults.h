@@ -25,8 +25,10 @@
 
 #include <AnalyzerResults.h>
 #include <ostream>
+#include "SDIODecoder.h"
 
 class SDIOAnalyzer;
+class SDIOTextFormatter;
 class SDIOAnalyzerSettings;
 
 class SDIOAnalyzerResults : public AnalyzerResults
@@ -41,8 +43,24 @@ public:
     virtual void GenerateFrameTabularText(U64 frame_index, DisplayBase display_base );
     virtual void GeneratePacketTabularText( U64 packet_id, DisplayBase display_base );
     virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
+
+    // Most field frames a single packet decodes into
+    enum {MAX_PACKET_FIELDS = SDIODecoder::MAX_PACKET_FIELDS};
+
+    // Bus number from the frame flags, 0 when there is a single bus
+    static U32 GetFrameBus(const Frame &frame);
+    // Field by field, as the SDK's Frame has no assignment operator of its own
+    static void CopyFrame(const Frame &frame, Frame &copy);
+    // Text of one frame of a packet, as in the tabular text and the export.
+    // Also used by SDIOLiveExport on its writer thread.
+    static void AppendFrameDescription(const Frame &frame, DisplayBase display_base, U32 sample_rate, SDIOTextFormatter &text);
+    static U32 ExpandPacketFrame(const Frame &packet, Frame *fields);
+    // Line of the text export for the frames of one packet, starting with the
+    // newline before it.  Used by the export threads and SDIOLiveExport.
+    static void AppendExportLine(const Frame *frames, U32 count, DisplayBase display_base, U64 trigger_sample, U32 sample_rate, SDIOTextFormatter &text);
 private:
-    void GeneratePacketDescription(U64 packet_id, DisplayBase display_base, std::ostream &stream);
+    void GeneratePacketDescription(U64 packet_id, DisplayBase display_base, SDIOTextFormatter &text);
+    void GenerateTraceFile(std::ostream &file_stream, U64 trigger_sample, U32 sample_rate);
 
 protected: //functions
 
@@ -21,8 +21,15 @@
 // THE SOFTWARE.
 
 #include "SDIOAnalyzerSettings.h"
+#include "SDIODecoder.h"
+#include "SDIOTraceExport.h"
 #include <AnalyzerHelpers.h>
+#include <stdio.h>
 
+// One row for each further bus
+static const char* sBusLineNames[SDIOAnalyzerSettings::MAX_BUSES - 1][SDIOAnalyzerSettings::BUS_LINES] = {
+    {"Bus 2 Command", "Bus 2 DAT0", "Bus 2 DAT1", "Bus 2 DAT2", "Bus 2 DAT3"}
+};
 
 SDIOAnalyzerSettings::SDIOAnalyzerSettings()
 :    mClockChannel( UNDEFINED_CHANNEL ),
@@ -30,7 +37,19 @@ SDIOAnalyzerSettings::SDIOAnalyzerSettings()
     mDAT0Channel( UNDEFINED_CHANNEL ),
     mDAT1Channel( UNDEFINED_CHANNEL ),
     mDAT2Channel( UNDEFINED_CHANNEL ),
-    mDAT3Channel( UNDEFINED_CHANNEL )
+    mDAT3Channel( UNDEFINED_CHANNEL ),
+    mDAT4Channel( UNDEFINED_CHANNEL ),
+    mDAT5Channel( UNDEFINED_CHANNEL ),
+    mDAT6Channel( UNDEFINED_CHANNEL ),
+    mDAT7Channel( UNDEFINED_CHANNEL ),
+    mDecodeDetail( DETAIL_FULL ),
+    mFunctionFilter( SDIODecodeOptions::FUNCTION_ALL ),
+    mCommandMask( ~U64(0) ),
+    mStartSample( 0 ),
+    mEndSample( ~U64(0) ),
+    mRepeatedPolls( POLLS_SHOW_ALL ),
+    mTimingChecks( TIMING_OFF ),
+    mDecodeOrder( ORDER_CAPTURE )
 {
     mClockChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
     mCmdChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
@@ -38,6 +57,10 @@ SDIOAnalyzerSettings::SDIOAnalyzerSettings()
     mDAT1ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
     mDAT2ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
     mDAT3ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
+    mDAT4ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
+    mDAT5ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
+    mDAT6ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
+    mDAT7ChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
 
     mClockChannelInterface->SetTitleAndTooltip( "Clock", "Standard SDIO" );
     mCmdChannelInterface->SetTitleAndTooltip( "Command", "Standard SDIO" );
@@ -45,6 +68,10 @@ SDIOAnalyzerSettings::SDIOAnalyzerSettings()
     mDAT1ChannelInterface->SetTitleAndTooltip( "DAT1", "Standard SDIO" );
     mDAT2ChannelInterface->SetTitleAndTooltip( "DAT2", "Standard SDIO" );
     mDAT3ChannelInterface->SetTitleAndTooltip( "DAT3", "Standard SDIO" );
+    mDAT4ChannelInterface->SetTitleAndTooltip( "DAT4", "8 bit bus only" );
+    mDAT5ChannelInterface->SetTitleAndTooltip( "DAT5", "8 bit bus only" );
+    mDAT6ChannelInterface->SetTitleAndTooltip( "DAT6", "8 bit bus only" );
+    mDAT7ChannelInterface->SetTitleAndTooltip( "DAT7", "8 bit bus only" );
 
     mClockChannelInterface->SetChannel( mClockChannel );
     mCmdChannelInterface->SetChannel( mCmdChannel );
@@ -52,6 +79,10 @@ SDIOAnalyzerSettings::SDIOAnalyzerSettings()
     mDAT1ChannelInterface->SetChannel( mDAT1Channel );
     mDAT2ChannelInterface->SetChannel( mDAT2Channel );
     mDAT3ChannelInterface->SetChannel( mDAT3Channel );
+    mDAT4ChannelInterface->SetChannel( mDAT4Channel );
+    mDAT5ChannelInterface->SetChannel( mDAT5Channel );
+    mDAT6ChannelInterface->SetChannel( mDAT6Channel );
+    mDAT7ChannelInterface->SetChannel( mDAT7Channel );
 
     mClockChannelInterface->SetSelectionOfNoneIsAllowed( false );
     mCmdChannelInterface->SetSelectionOfNoneIsAllowed( false );
@@ -59,18 +90,128 @@ SDIOAnalyzerSettings::SDIOAnalyzerSettings()
     mDAT1ChannelInterface->SetSelectionOfNoneIsAllowed( true );
     mDAT2ChannelInterface->SetSelectionOfNoneIsAllowed( true );
     mDAT3ChannelInterface->SetSelectionOfNoneIsAllowed( true );
+    mDAT4ChannelInterface->SetSelectionOfNoneIsAllowed( true );
+    mDAT5ChannelInterface->SetSelectionOfNoneIsAllowed( true );
+    mDAT6ChannelInterface->SetSelectionOfNoneIsAllowed( true );
+    mDAT7ChannelInterface->SetSelectionOfNoneIsAllowed( true );
 
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+    {
+        for (U32 line = 0; line < BUS_LINES; line++)
+        {
+            mBusChannels[bus][line] = UNDEFINED_CHANNEL;
+            mBusChannelInterfaces[bus][line].reset( new AnalyzerSettingInterfaceChannel() );
+            mBusChannelInterfaces[bus][line]->SetTitleAndTooltip( sBusLineNames[bus][line], "Line of a further SDIO bus on the same clock, None for a single bus" );
+            mBusChannelInterfaces[bus][line]->SetChannel( mBusChannels[bus][line] );
+            mBusChannelInterfaces[bus][line]->SetSelectionOfNoneIsAllowed( true );
+        }
+    }
+
+    // Overview mode only stores one frame per packet; the field frames are
+    // rebuilt from that frame's raw bits when the packet is displayed or exported.
+    mDecodeDetailInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mDecodeDetailInterface->SetTitleAndTooltip( "Decode detail", "Amount of frames stored for each packet" );
+    mDecodeDetailInterface->AddNumber( DETAIL_FULL, "Full (all field frames)", "Decode every field of every packet into its own frame" );
+    mDecodeDetailInterface->AddNumber( DETAIL_OVERVIEW, "Overview (one frame per packet)", "Store packet boundaries only, decode fields on demand" );
+    mDecodeDetailInterface->SetNumber( mDecodeDetail );
+
+    mPayloadDirectoryInterface.reset( new AnalyzerSettingInterfaceText() );
+    mPayloadDirectoryInterface->SetTitleAndTooltip( "CMD53 payload folder", "Write the CMD53 data of each function and direction to files in this folder, leave empty to disable" );
+    mPayloadDirectoryInterface->SetTextType( AnalyzerSettingInterfaceText::FolderPath );
+    mPayloadDirectoryInterface->SetText( mPayloadDirectory.c_str() );
+
+    mCommandFilterInterface.reset( new AnalyzerSettingInterfaceText() );
+    mCommandFilterInterface->SetTitleAndTooltip( "Command filter", "Comma separated command indexes to decode, e.g. 52,53.  Start with ! to decode all commands but these.  Leave empty to decode all commands" );
+    mCommandFilterInterface->SetText( mCommandFilter.c_str() );
+
+    mFunctionFilterInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mFunctionFilterInterface->SetTitleAndTooltip( "Function filter", "Only decode the CMD52/CMD53 packets of this function, other commands are not affected" );
+    mFunctionFilterInterface->AddNumber( SDIODecodeOptions::FUNCTION_ALL, "All functions", "Decode the CMD52/CMD53 packets of all functions" );
+    for (U32 fn = 0; fn < SDIODecodeOptions::FUNCTION_ALL; fn++)
+    {
+        char name[16];
+        snprintf( name, sizeof(name), "Function %u", fn );
+        mFunctionFilterInterface->AddNumber( fn, name, "" );
+    }
+    mFunctionFilterInterface->SetNumber( mFunctionFilter );
+
+    mSampleRangeInterface.reset( new AnalyzerSettingInterfaceText() );
+    mSampleRangeInterface->SetTitleAndTooltip( "Sample range", "First and last sample to decode as start-end, either may be left out.  Leave empty to decode the whole capture" );
+    mSampleRangeInterface->SetText( mSampleRange.c_str() );
+
+    // Identical CMD52 command/response pairs in a row become one counted frame
+    mRepeatedPollsInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mRepeatedPollsInterface->SetTitleAndTooltip( "Repeated CMD52 polls", "What to store for CMD52 command/response pairs that repeat the previous pair" );
+    mRepeatedPollsInterface->AddNumber( POLLS_SHOW_ALL, "Show every poll", "Store the frames of every CMD52 command and response" );
+    mRepeatedPollsInterface->AddNumber( POLLS_COLLAPSE, "Collapse into runs", "Store one frame with a repeat count and interval for identical pairs in a row" );
+    mRepeatedPollsInterface->SetNumber( mRepeatedPolls );
 
+    // Clock cycles between packets against the SD spec, see SDIOResponseTiming
+    mTimingChecksInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mTimingChecksInterface->SetTitleAndTooltip( "Response timing", "Mark commands without a response and gaps between packets outside of the NCR, NID, NCC, NRC and NWR bounds" );
+    mTimingChecksInterface->AddNumber( TIMING_CHECK, "Mark violations", "Add an error frame for each response timeout and gap out of bounds" );
+    mTimingChecksInterface->AddNumber( TIMING_OFF, "Off", "Only count them for the response timing export" );
+    mTimingChecksInterface->SetNumber( mTimingChecks );
+
+    mLiveExportFileInterface.reset( new AnalyzerSettingInterfaceText() );
+    mLiveExportFileInterface->SetTitleAndTooltip( "Live export file", "Write the text export to this file while decoding, leave empty to disable" );
+    mLiveExportFileInterface->SetTextType( AnalyzerSettingInterfaceText::FilePath );
+    mLiveExportFileInterface->SetText( mLiveExportFile.c_str() );
+
+    mCacheDirectoryInterface.reset( new AnalyzerSettingInterfaceText() );
+    mCacheDirectoryInterface->SetTitleAndTooltip( "Decode cache folder", "Keep the decoded packets in this folder and load them instead of decoding the same capture with the same settings again, leave empty to disable" );
+    mCacheDirectoryInterface->SetTextType( AnalyzerSettingInterfaceText::FolderPath );
+    mCacheDirectoryInterface->SetText( mCacheDirectory.c_str() );
+
+    mTraceOffsetInterface.reset( new AnalyzerSettingInterfaceText() );
+    mTraceOffsetInterface->SetTitleAndTooltip( "Trace time offset", "Seconds added to the timestamps of the trace event export, e.g. the host clock at the trigger, to line it up with ftrace or perf captures" );
+    mTraceOffsetInterface->SetText( mTraceOffset.c_str() );
+
+    mDecodeOrderInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mDecodeOrderInterface->SetTitleAndTooltip( "Decode order", "Where the decode starts.  Trigger first only applies to a single bus." );
+    mDecodeOrderInterface->AddNumber( ORDER_CAPTURE, "From the start", "Decode the capture from its first clock edge on" );
+    mDecodeOrderInterface->AddNumber( ORDER_TRIGGER_FIRST, "Trigger first", "Decode from just before the trigger to the end of the capture first, then the whole capture from its start in a second run" );
+    mDecodeOrderInterface->SetNumber( mDecodeOrder );
     AddInterface( mClockChannelInterface.get() );
     AddInterface( mCmdChannelInterface.get() );
     AddInterface( mDAT0ChannelInterface.get() );
     AddInterface( mDAT1ChannelInterface.get() );
     AddInterface( mDAT2ChannelInterface.get() );
     AddInterface( mDAT3ChannelInterface.get() );
+    AddInterface( mDAT4ChannelInterface.get() );
+    AddInterface( mDAT5ChannelInterface.get() );
+    AddInterface( mDAT6ChannelInterface.get() );
+    AddInterface( mDAT7ChannelInterface.get() );
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            AddInterface( mBusChannelInterfaces[bus][line].get() );
+    AddInterface( mDecodeDetailInterface.get() );
+    AddInterface( mPayloadDirectoryInterface.get() );
+    AddInterface( mCommandFilterInterface.get() );
+    AddInterface( mFunctionFilterInterface.get() );
+    AddInterface( mSampleRangeInterface.get() );
+    AddInterface( mRepeatedPollsInterface.get() );
+    AddInterface( mTimingChecksInterface.get() );
+    AddInterface( mLiveExportFileInterface.get() );
+    AddInterface( mCacheDirectoryInterface.get() );
+    AddInterface( mTraceOffsetInterface.get() );
+    AddInterface( mDecodeOrderInterface.get() );
 
-    AddExportOption( 0, "Export as text/csv file" );
-    AddExportExtension( 0, "text", "txt" );
-    AddExportExtension( 0, "csv", "csv" );
+    AddExportOption( EXPORT_TEXT, "Export as text/csv file" );
+    AddExportExtension( EXPORT_TEXT, "text", "txt" );
+    AddExportExtension( EXPORT_TEXT, "csv", "csv" );
+    AddExportOption( EXPORT_TIMELINE, "Export enumeration timeline" );
+    AddExportExtension( EXPORT_TIMELINE, "csv", "csv" );
+    AddExportOption( EXPORT_TIMING, "Export response timing" );
+    AddExportExtension( EXPORT_TIMING, "csv", "csv" );
+    AddExportOption( EXPORT_REGISTERS, "Export hot registers" );
+    AddExportExtension( EXPORT_REGISTERS, "csv", "csv" );
+    AddExportOption( EXPORT_TRACE, "Export as trace events for Perfetto" );
+    AddExportExtension( EXPORT_TRACE, "json", "json" );
+#ifdef SDIO_INSTRUMENTATION
+    AddExportOption( EXPORT_COUNTERS, "Export decode counters" );
+    AddExportExtension( EXPORT_COUNTERS, "csv", "csv" );
+#endif
 
     ClearChannels();
     // AddChannel( mInputChannel, "Serial", false );
@@ -80,6 +221,13 @@ SDIOAnalyzerSettings::SDIOAnalyzerSettings()
     AddChannel( mDAT1Channel, "DAT1", false );
     AddChannel( mDAT2Channel, "DAT2", false );
     AddChannel( mDAT3Channel, "DAT3", false );
+    AddChannel( mDAT4Channel, "DAT4", false );
+    AddChannel( mDAT5Channel, "DAT5", false );
+    AddChannel( mDAT6Channel, "DAT6", false );
+    AddChannel( mDAT7Channel, "DAT7", false );
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            AddChannel( mBusChannels[bus][line], sBusLineNames[bus][line], false );
 }
 
 SDIOAnalyzerSettings::~SDIOAnalyzerSettings()
@@ -93,11 +241,15 @@ bool SDIOAnalyzerSettings::SetSettingsFromInterfaces()
 
     // check channel selection
     {
-        Channel d0, d1, d2, d3;
+        Channel d0, d1, d2, d3, d4, d5, d6, d7;
         d0 = mDAT0ChannelInterface->GetChannel();
         d1 = mDAT1ChannelInterface->GetChannel();
         d2 = mDAT2ChannelInterface->GetChannel();
         d3 = mDAT3ChannelInterface->GetChannel();
+        d4 = mDAT4ChannelInterface->GetChannel();
+        d5 = mDAT5ChannelInterface->GetChannel();
+        d6 = mDAT6ChannelInterface->GetChannel();
+        d7 = mDAT7ChannelInterface->GetChannel();
 
         if (d1 == UNDEFINED_CHANNEL && d2 == UNDEFINED_CHANNEL && d3 == UNDEFINED_CHANNEL)
         {
@@ -114,14 +266,46 @@ bool SDIOAnalyzerSettings::SetSettingsFromInterfaces()
             return false;
         }
 
+        // 8 bit bus, DAT4-DAT7 on top of a 4 bit one
+        if (d4 == UNDEFINED_CHANNEL && d5 == UNDEFINED_CHANNEL && d6 == UNDEFINED_CHANNEL && d7 == UNDEFINED_CHANNEL)
+        {
+            // 1 or 4 bit bus, continue
+        }
+        else if (d1 == UNDEFINED_CHANNEL || d4 == UNDEFINED_CHANNEL || d5 == UNDEFINED_CHANNEL ||
+                 d6 == UNDEFINED_CHANNEL || d7 == UNDEFINED_CHANNEL)
+        {
+            SetErrorText("Invalid data line selection. An 8 bit bus needs all of D0-D7 set.");
+            return false;
+        }
+
         std::vector<Channel> channels;
         channels.push_back(d0);
         channels.push_back(d1);
         channels.push_back(d2);
         channels.push_back(d3);
+        channels.push_back(d4);
+        channels.push_back(d5);
+        channels.push_back(d6);
+        channels.push_back(d7);
         channels.push_back(mClockChannelInterface->GetChannel());
         channels.push_back(mCmdChannelInterface->GetChannel());
 
+        for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        {
+            bool lines_set[BUS_LINES];
+            for (U32 line = 0; line < BUS_LINES; line++)
+            {
+                channels.push_back(mBusChannelInterfaces[bus][line]->GetChannel());
+                lines_set[line] = channels.back() != UNDEFINED_CHANNEL;
+            }
+            bool data_lines = lines_set[BUS_DAT1] == lines_set[BUS_DAT2] && lines_set[BUS_DAT1] == lines_set[BUS_DAT3];
+            if (lines_set[BUS_CMD] != lines_set[BUS_DAT0] || !data_lines || (!lines_set[BUS_CMD] && lines_set[BUS_DAT1]))
+            {
+                SetErrorText("Invalid bus line selection. A further bus needs its command and DAT0 lines, and either all or none of its other data lines.");
+                return false;
+            }
+        }
+
         if (AnalyzerHelpers::DoChannelsOverlap(channels.data(), channels.size()) == true)
         {
             SetErrorText("Channel selections must be unique");
@@ -129,12 +313,51 @@ bool SDIOAnalyzerSettings::SetSettingsFromInterfaces()
         }
     }
 
+    U64 command_mask, start_sample, end_sample;
+    if (!SDIODecodeOptions::ParseCommandFilter( mCommandFilterInterface->GetText(), command_mask ))
+    {
+        SetErrorText("Invalid command filter. Use comma separated command indexes from 0 to 63, optionally starting with !.");
+        return false;
+    }
+    if (!SDIODecodeOptions::ParseSampleRange( mSampleRangeInterface->GetText(), start_sample, end_sample ))
+    {
+        SetErrorText("Invalid sample range. Use start-end, e.g. 1000-250000, 1000- or -250000.");
+        return false;
+    }
+    double trace_offset;
+    if (!SDIOTraceExport::ParseOffset( mTraceOffsetInterface->GetText(), trace_offset ))
+    {
+        SetErrorText("Invalid trace time offset. Use seconds, e.g. 1234.5678.");
+        return false;
+    }
+
     mClockChannel = mClockChannelInterface->GetChannel();
     mCmdChannel = mCmdChannelInterface->GetChannel();
     mDAT0Channel = mDAT0ChannelInterface->GetChannel();
     mDAT1Channel = mDAT1ChannelInterface->GetChannel();
     mDAT2Channel = mDAT2ChannelInterface->GetChannel();
     mDAT3Channel = mDAT3ChannelInterface->GetChannel();
+    mDAT4Channel = mDAT4ChannelInterface->GetChannel();
+    mDAT5Channel = mDAT5ChannelInterface->GetChannel();
+    mDAT6Channel = mDAT6ChannelInterface->GetChannel();
+    mDAT7Channel = mDAT7ChannelInterface->GetChannel();
+    mDecodeDetail = U32( mDecodeDetailInterface->GetNumber() );
+    mPayloadDirectory = mPayloadDirectoryInterface->GetText();
+    mCommandFilter = mCommandFilterInterface->GetText();
+    mFunctionFilter = U32( mFunctionFilterInterface->GetNumber() );
+    mSampleRange = mSampleRangeInterface->GetText();
+    mRepeatedPolls = U32( mRepeatedPollsInterface->GetNumber() );
+    mTimingChecks = U32( mTimingChecksInterface->GetNumber() );
+    mLiveExportFile = mLiveExportFileInterface->GetText();
+    mCacheDirectory = mCacheDirectoryInterface->GetText();
+    mTraceOffset = mTraceOffsetInterface->GetText();
+    mDecodeOrder = U32( mDecodeOrderInterface->GetNumber() );
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            mBusChannels[bus][line] = mBusChannelInterfaces[bus][line]->GetChannel();
+    mCommandMask = command_mask;
+    mStartSample = start_sample;
+    mEndSample = end_sample;
 
     ClearChannels();
     // AddChannel( mInputChannel, "SDIO", true );
@@ -145,6 +368,13 @@ bool SDIOAnalyzerSettings::SetSettingsFromInterfaces()
     AddChannel( mDAT1Channel, "DAT1", mDAT1Channel != UNDEFINED_CHANNEL);
     AddChannel( mDAT2Channel, "DAT2", mDAT2Channel != UNDEFINED_CHANNEL);
     AddChannel( mDAT3Channel, "DAT3", mDAT3Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT4Channel, "DAT4", mDAT4Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT5Channel, "DAT5", mDAT5Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT6Channel, "DAT6", mDAT6Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT7Channel, "DAT7", mDAT7Channel != UNDEFINED_CHANNEL);
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            AddChannel( mBusChannels[bus][line], sBusLineNames[bus][line], mBusChannels[bus][line] != UNDEFINED_CHANNEL );
     return true;
 }
 
@@ -158,6 +388,24 @@ void SDIOAnalyzerSettings::UpdateInterfacesFromSettings()
     mDAT1ChannelInterface->SetChannel( mDAT1Channel );
     mDAT2ChannelInterface->SetChannel( mDAT2Channel );
     mDAT3ChannelInterface->SetChannel( mDAT3Channel );
+    mDAT4ChannelInterface->SetChannel( mDAT4Channel );
+    mDAT5ChannelInterface->SetChannel( mDAT5Channel );
+    mDAT6ChannelInterface->SetChannel( mDAT6Channel );
+    mDAT7ChannelInterface->SetChannel( mDAT7Channel );
+    mDecodeDetailInterface->SetNumber( mDecodeDetail );
+    mPayloadDirectoryInterface->SetText( mPayloadDirectory.c_str() );
+    mCommandFilterInterface->SetText( mCommandFilter.c_str() );
+    mFunctionFilterInterface->SetNumber( mFunctionFilter );
+    mSampleRangeInterface->SetText( mSampleRange.c_str() );
+    mRepeatedPollsInterface->SetNumber( mRepeatedPolls );
+    mTimingChecksInterface->SetNumber( mTimingChecks );
+    mLiveExportFileInterface->SetText( mLiveExportFile.c_str() );
+    mCacheDirectoryInterface->SetText( mCacheDirectory.c_str() );
+    mTraceOffsetInterface->SetText( mTraceOffset.c_str() );
+    mDecodeOrderInterface->SetNumber( mDecodeOrder );
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            mBusChannelInterfaces[bus][line]->SetChannel( mBusChannels[bus][line] );
 }
 
 void SDIOAnalyzerSettings::LoadSettings( const char* settings )
@@ -172,6 +420,68 @@ void SDIOAnalyzerSettings::LoadSettings( const char* settings )
     text_archive >> mDAT2Channel;
     text_archive >> mDAT3Channel;
 
+    // Settings saved by older versions end here
+    U32 decode_detail;
+    if (text_archive >> decode_detail)
+        mDecodeDetail = decode_detail;
+    const char* payload_directory;
+    if (text_archive >> &payload_directory)
+        mPayloadDirectory = payload_directory;
+    const char* command_filter;
+    if (text_archive >> &command_filter)
+        mCommandFilter = command_filter;
+    U32 function_filter;
+    if (text_archive >> function_filter)
+        mFunctionFilter = function_filter;
+    const char* sample_range;
+    if (text_archive >> &sample_range)
+        mSampleRange = sample_range;
+    U32 repeated_polls;
+    if (text_archive >> repeated_polls)
+        mRepeatedPolls = repeated_polls;
+    const char* live_export_file;
+    if (text_archive >> &live_export_file)
+        mLiveExportFile = live_export_file;
+    const char* cache_directory;
+    if (text_archive >> &cache_directory)
+        mCacheDirectory = cache_directory;
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+    {
+        for (U32 line = 0; line < BUS_LINES; line++)
+        {
+            Channel channel;
+            if (text_archive >> channel)
+                mBusChannels[bus][line] = channel;
+        }
+    }
+    Channel upper_lines[4];
+    if (text_archive >> upper_lines[0] && text_archive >> upper_lines[1] &&
+        text_archive >> upper_lines[2] && text_archive >> upper_lines[3])
+    {
+        mDAT4Channel = upper_lines[0];
+        mDAT5Channel = upper_lines[1];
+        mDAT6Channel = upper_lines[2];
+        mDAT7Channel = upper_lines[3];
+    }
+    U32 timing_checks;
+    if (text_archive >> timing_checks)
+        mTimingChecks = timing_checks;
+    const char* trace_offset;
+    if (text_archive >> &trace_offset)
+        mTraceOffset = trace_offset;
+    U32 decode_order;
+    if (text_archive >> decode_order)
+        mDecodeOrder = decode_order;
+
+    // Hand edited settings fall back to decoding everything
+    if (!SDIODecodeOptions::ParseCommandFilter( mCommandFilter.c_str(), mCommandMask ))
+        mCommandMask = ~U64(0);
+    if (!SDIODecodeOptions::ParseSampleRange( mSampleRange.c_str(), mStartSample, mEndSample ))
+    {
+        mStartSample = 0;
+        mEndSample = ~U64(0);
+    }
+
     ClearChannels();
 
     AddChannel( mClockChannel, "Clock", true );
@@ -180,10 +490,38 @@ void SDIOAnalyzerSettings::LoadSettings( const char* settings )
     AddChannel( mDAT1Channel, "DAT1", mDAT1Channel != UNDEFINED_CHANNEL);
     AddChannel( mDAT2Channel, "DAT2", mDAT2Channel != UNDEFINED_CHANNEL);
     AddChannel( mDAT3Channel, "DAT3", mDAT3Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT4Channel, "DAT4", mDAT4Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT5Channel, "DAT5", mDAT5Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT6Channel, "DAT6", mDAT6Channel != UNDEFINED_CHANNEL);
+    AddChannel( mDAT7Channel, "DAT7", mDAT7Channel != UNDEFINED_CHANNEL);
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            AddChannel( mBusChannels[bus][line], sBusLineNames[bus][line], mBusChannels[bus][line] != UNDEFINED_CHANNEL );
 
     UpdateInterfacesFromSettings();
 }
 
+U32 SDIOAnalyzerSettings::GetBusCount() const
+{
+    U32 count = 1;
+    while (count < MAX_BUSES && mBusChannels[count - 1][BUS_CMD] != UNDEFINED_CHANNEL &&
+           mBusChannels[count - 1][BUS_DAT0] != UNDEFINED_CHANNEL)
+        count++;
+    return count;
+}
+
+U32 SDIOAnalyzerSettings::GetChannelBus(const Channel &channel) const
+{
+    U32 count = GetBusCount();
+    if (count == 1)
+        return 0;
+    for (U32 bus = 1; bus < count; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            if (mBusChannels[bus - 1][line] == channel)
+                return bus + 1;
+    return 1;
+}
+
 const char* SDIOAnalyzerSettings::SaveSettings()
 {
     SimpleArchive text_archive;
@@ -194,6 +532,24 @@ const char* SDIOAnalyzerSettings::SaveSettings()
     text_archive << mDAT1Channel;
     text_archive << mDAT2Channel;
     text_archive << mDAT3Channel;
+    text_archive << mDecodeDetail;
+    text_archive << mPayloadDirectory.c_str();
+    text_archive << mCommandFilter.c_str();
+    text_archive << mFunctionFilter;
+    text_archive << mSampleRange.c_str();
+    text_archive << mRepeatedPolls;
+    text_archive << mLiveExportFile.c_str();
+    text_archive << mCacheDirectory.c_str();
+    for (U32 bus = 0; bus < MAX_BUSES - 1; bus++)
+        for (U32 line = 0; line < BUS_LINES; line++)
+            text_archive << mBusChannels[bus][line];
+    text_archive << mDAT4Channel;
+    text_archive << mDAT5Channel;
+    text_archive << mDAT6Channel;
+    text_archive << mDAT7Channel;
+    text_archive << mTimingChecks;
+    text_archive << mTraceOffset.c_str();
+    text_archive << mDecodeOrder;
     // text_archive << mInputChannel;
     // text_archive << mBitRate;
 
@@ -25,6 +25,8 @@
 
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
+#include <string>
+#include "SDIOMultiBusDecoder.h"
 
 class SDIOAnalyzerSettings : public AnalyzerSettings
 {
@@ -44,9 +46,57 @@ public:
     Channel mDAT1Channel;
     Channel mDAT2Channel;
     Channel mDAT3Channel;
+    // DAT4-DAT7 of an 8 bit bus, all of them or none
+    Channel mDAT4Channel;
+    Channel mDAT5Channel;
+    Channel mDAT6Channel;
+    Channel mDAT7Channel;
     Channel mInputChannel;
     Channel mBitRate;
 
+    enum DecodeDetail {DETAIL_FULL, DETAIL_OVERVIEW};
+    enum ExportType {EXPORT_TEXT, EXPORT_COUNTERS, EXPORT_TIMELINE, EXPORT_TIMING, EXPORT_REGISTERS, EXPORT_TRACE};
+    U32 mDecodeDetail;
+    std::string mPayloadDirectory;
+
+    // Decode scope, packets outside of it are framed but not stored.  See
+    // SDIODecodeOptions for the parsed values.
+    std::string mCommandFilter;
+    U32 mFunctionFilter;
+    std::string mSampleRange;
+    U64 mCommandMask;
+    U64 mStartSample;
+    U64 mEndSample;
+
+    enum RepeatedPolls {POLLS_SHOW_ALL, POLLS_COLLAPSE};
+    U32 mRepeatedPolls;
+
+    enum TimingChecks {TIMING_OFF, TIMING_CHECK};
+    U32 mTimingChecks;
+
+    // Text export written while decoding, empty for none
+    std::string mLiveExportFile;
+
+    // Folder of the decode cache files, empty for none
+    std::string mCacheDirectory;
+
+    // Seconds added to the trace event export timestamps
+    std::string mTraceOffset;
+
+    // With the trigger first, a first run starts just before the trigger and
+    // a second one decodes the whole capture
+    enum DecodeOrder {ORDER_CAPTURE, ORDER_TRIGGER_FIRST};
+    U32 mDecodeOrder;
+
+    // CMD/DAT groups of further buses on the same clock, decoded in the same
+    // pass.  A bus is used when its command and DAT0 lines are set.
+    enum {MAX_BUSES = SDIOMultiBusDecoder::MAX_BUSES};
+    enum BusLines {BUS_CMD, BUS_DAT0, BUS_DAT1, BUS_DAT2, BUS_DAT3, BUS_LINES};
+    Channel mBusChannels[MAX_BUSES - 1][BUS_LINES];
+    U32 GetBusCount() const;
+    // Bus of a line as in the frame flags, 0 when there is a single bus
+    U32 GetChannelBus(const Channel &channel) const;
+
 protected:
     std::auto_ptr< AnalyzerSettingInterfaceChannel >    mClockChannelInterface;
     std::auto_ptr< AnalyzerSettingInterfaceChannel >    mCmdChannelInterface;
@@ -54,6 +104,22 @@ protected:
     std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT1ChannelInterface;
     std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT2ChannelInterface;
     std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT3ChannelInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT4ChannelInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT5ChannelInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT6ChannelInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceChannel >    mDAT7ChannelInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceNumberList > mDecodeDetailInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceText >       mPayloadDirectoryInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceText >       mCommandFilterInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceNumberList > mFunctionFilterInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceText >       mSampleRangeInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceNumberList > mRepeatedPollsInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceNumberList > mTimingChecksInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceText >       mLiveExportFileInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceText >       mCacheDirectoryInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceText >       mTraceOffsetInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceNumberList > mDecodeOrderInterface;
+    std::auto_ptr< AnalyzerSettingInterfaceChannel >    mBusChannelInterfaces[MAX_BUSES - 1][BUS_LINES];
 };
 
 #endif //SDIO_ANALYZER_SETTINGS
@@ -0,0 +1,277 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIODecodeCache.h"
+#include <string.h>
+
+static inline U64 Rotate(U64 value, U32 bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static bool Seek(FILE* file, U64 offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, __int64(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+}
+
+//Four independent multiply and rotate lanes, a large capture is hashed at
+//close to the speed it can be read
+U64 SDIODecodeCache::Hash(const void* data, size_t length, U64 seed)
+{
+    const U64 prime1 = 0x9E3779B185EBCA87ULL;
+    const U64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+    const U8* bytes = (const U8*)data;
+    U64 lanes[4] = {seed + prime1, seed ^ prime2, seed - prime1, Rotate(seed, 32)};
+
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32){
+        for (U32 lane = 0; lane < 4; lane++){
+            U64 word;
+            memcpy(&word, bytes + i + lane * 8, 8);
+            lanes[lane] = Rotate(lanes[lane] + word * prime2, 31) * prime1;
+        }
+    }
+
+    U64 hash = U64(length);
+    for (U32 lane = 0; lane < 4; lane++){
+        hash = Rotate(hash ^ lanes[lane] * prime2, 27) * prime1;
+    }
+    for ( ; i < length; i++){
+        hash = (hash ^ bytes[i]) * prime1;
+    }
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+std::string SDIODecodeCache::FileName(const std::string &directory, U64 key)
+{
+    char name[40];
+    snprintf(name, sizeof(name), "/sdio-%016llx.cache", (unsigned long long)key);
+    return directory + name;
+}
+
+bool SDIODecodeCache::CheckHeader(const Header &header, U64 key)
+{
+    return memcmp(header.mMagic, "SDIOCACH", 8) == 0 && header.mVersion == VERSION &&
+           header.mCheckpointSize == sizeof(SDIODecoderCheckpoint) && header.mKey == key;
+}
+
+size_t SDIODecodeCache::Replay(const U8* data, size_t length, SDIOFrameSink &sink)
+{
+    size_t offset = 0;
+    while (length - offset >= RECORD_HEADER_SIZE){
+        U16 frames, markers;
+        memcpy(&frames, data + offset, 2);
+        memcpy(&markers, data + offset + 2, 2);
+        size_t size = RECORD_HEADER_SIZE + frames * size_t(FRAME_SIZE) + markers * sizeof(U64);
+        if (length - offset < size){
+            break;
+        }
+
+        const U8* record = data + offset + RECORD_HEADER_SIZE;
+        for (U32 i = 0; i < frames; i++, record += FRAME_SIZE){
+            SDIOFrame frame;
+            memcpy(&frame.mStartingSampleInclusive, record, 8);
+            memcpy(&frame.mEndingSampleInclusive, record + 8, 8);
+            memcpy(&frame.mData1, record + 16, 8);
+            memcpy(&frame.mData2, record + 24, 8);
+            frame.mType = record[32];
+            frame.mFlags = record[33];
+            sink.AddFrame(frame);
+        }
+        for (U32 i = 0; i < markers; i++, record += sizeof(U64)){
+            U64 sample;
+            memcpy(&sample, record, sizeof(sample));
+            sink.AddMarker(sample);
+        }
+        sink.CommitPacket();
+        offset += size;
+    }
+    return offset;
+}
+
+SDIODecodeCacheWriter::SDIODecodeCacheWriter()
+:    mFile(nullptr),
+    mPackets(0),
+    mLength(0),
+    mFrameCount(0),
+    mMarkerCount(0)
+{
+    memset((void*)&mHeader, 0, sizeof(mHeader));
+}
+
+SDIODecodeCacheWriter::~SDIODecodeCacheWriter()
+{
+    Close();
+}
+
+bool SDIODecodeCacheWriter::Open(const char* file_name, U64 key)
+{
+    Close();
+    mFile = fopen(file_name, "wb");
+    if (mFile == nullptr){
+        return false;
+    }
+
+    //Nothing is valid until the first checkpoint
+    memset((void*)&mHeader, 0, sizeof(mHeader));
+    memcpy(mHeader.mMagic, "SDIOCACH", 8);
+    mHeader.mVersion = SDIODecodeCache::VERSION;
+    mHeader.mCheckpointSize = sizeof(SDIODecoderCheckpoint);
+    mHeader.mKey = key;
+    mPackets = 0;
+    mLength = 0;
+    return WriteHeader();
+}
+
+bool SDIODecodeCacheWriter::Append(const char* file_name, const SDIODecodeCache::Header &header)
+{
+    Close();
+    mFile = fopen(file_name, "r+b");
+    if (mFile == nullptr){
+        return false;
+    }
+
+    //Records after the valid ones are from a run that was stopped, they are
+    //written over
+    mHeader = header;
+    mHeader.mComplete = 0;
+    mPackets = header.mPackets;
+    mLength = header.mLength;
+    if (!Seek(mFile, sizeof(mHeader) + mLength)){
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SDIODecodeCacheWriter::Close()
+{
+    if (mFile != nullptr){
+        fclose(mFile);
+        mFile = nullptr;
+    }
+    mRecord.clear();
+    mMarkers.clear();
+    mFrameCount = 0;
+    mMarkerCount = 0;
+}
+
+bool SDIODecodeCacheWriter::Finish()
+{
+    if (mFile == nullptr){
+        return false;
+    }
+    mHeader.mPackets = mPackets;
+    mHeader.mLength = mLength;
+    mHeader.mComplete = 1;
+    bool written = WriteHeader();
+    Close();
+    return written;
+}
+
+void SDIODecodeCacheWriter::AddFrame(const SDIOFrame &frame)
+{
+    if (mFile == nullptr){
+        return;
+    }
+    if (mRecord.empty()){
+        mRecord.resize(SDIODecodeCache::RECORD_HEADER_SIZE);
+    }
+    size_t offset = mRecord.size();
+    mRecord.resize(offset + SDIODecodeCache::FRAME_SIZE);
+    U8* record = &mRecord[offset];
+    memcpy(record, &frame.mStartingSampleInclusive, 8);
+    memcpy(record + 8, &frame.mEndingSampleInclusive, 8);
+    memcpy(record + 16, &frame.mData1, 8);
+    memcpy(record + 24, &frame.mData2, 8);
+    record[32] = frame.mType;
+    record[33] = frame.mFlags;
+    mFrameCount++;
+}
+
+void SDIODecodeCacheWriter::AddMarker(U64 sample)
+{
+    if (mFile == nullptr){
+        return;
+    }
+    size_t offset = mMarkers.size();
+    mMarkers.resize(offset + sizeof(sample));
+    memcpy(&mMarkers[offset], &sample, sizeof(sample));
+    mMarkerCount++;
+}
+
+void SDIODecodeCacheWriter::CommitPacket()
+{
+    if (mFile == nullptr){
+        return;
+    }
+    if (mRecord.empty()){
+        mRecord.resize(SDIODecodeCache::RECORD_HEADER_SIZE);
+    }
+    U16 frames = U16(mFrameCount);
+    U16 markers = U16(mMarkerCount);
+    memcpy(&mRecord[0], &frames, 2);
+    memcpy(&mRecord[2], &markers, 2);
+    mRecord.insert(mRecord.end(), mMarkers.begin(), mMarkers.end());
+
+    if (fwrite(&mRecord[0], 1, mRecord.size(), mFile) != mRecord.size()){
+        //Out of space, what was valid before stays valid
+        Close();
+        return;
+    }
+    mLength += mRecord.size();
+    mPackets++;
+    mRecord.clear();
+    mMarkers.clear();
+    mFrameCount = 0;
+    mMarkerCount = 0;
+}
+
+void SDIODecodeCacheWriter::AddCheckpoint(const SDIODecoderCheckpoint &checkpoint)
+{
+    if (mFile == nullptr){
+        return;
+    }
+    mHeader.mPackets = mPackets;
+    mHeader.mLength = mLength;
+    mHeader.mHasCheckpoint = 1;
+    mHeader.mCheckpoint = checkpoint;
+    WriteHeader();
+}
+
+//The records go out before the header that makes them valid
+bool SDIODecodeCacheWriter::WriteHeader()
+{
+    bool written = fflush(mFile) == 0 && Seek(mFile, 0) &&
+                   fwrite(&mHeader, sizeof(mHeader), 1, mFile) == 1 && fflush(mFile) == 0 &&
+                   Seek(mFile, sizeof(mHeader) + mLength);
+    if (!written){
+        Close();
+    }
+    return written;
+}
@@ -0,0 +1,107 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_DECODE_CACHE
+#define SDIO_DECODE_CACHE
+
+#include <LogicPublicTypes.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "SDIODecoder.h"
+
+// Sidecar file of what a decode committed, so a later run over the same data
+// with the same settings replays it instead of decoding again.
+//
+// A fixed size header is followed by a record per packet: the number of
+// frames and markers, then the frames and the markers.  The header holds how
+// many bytes of records are valid and the decoder checkpoint they end at.  It
+// is rewritten at every checkpoint, a decode that is stopped halfway leaves a
+// file that is good up to its last one.  A decode that ran to the end of the
+// data marks the file complete, all of it is valid then.
+//
+// The frames and the checkpoint are kept as they are in memory, a file is
+// only read back by the same build.
+class SDIODecodeCache
+{
+public:
+    enum {VERSION = 3, FRAME_SIZE = 34, RECORD_HEADER_SIZE = 4};
+
+    struct Header
+    {
+        char mMagic[8];
+        U32 mVersion;
+        U32 mCheckpointSize;
+        U64 mKey;
+        U64 mPackets;
+        U64 mLength;
+        U32 mComplete;
+        U32 mHasCheckpoint;
+        SDIODecoderCheckpoint mCheckpoint;
+    };
+
+    // 64 bit hash of the data, chained over several buffers through seed
+    static U64 Hash(const void* data, size_t length, U64 seed);
+    // <directory>/sdio-<key>.cache
+    static std::string FileName(const std::string &directory, U64 key);
+
+    // Whether header starts a cache file for key written by this build
+    static bool CheckHeader(const Header &header, U64 key);
+    // Replays the complete records at the start of data to the sink, returns
+    // the number of bytes they take up
+    static size_t Replay(const U8* data, size_t length, SDIOFrameSink &sink);
+};
+
+// Writes a cache file while decoding, it gets the same calls as the sink
+class SDIODecodeCacheWriter
+{
+public:
+    SDIODecodeCacheWriter();
+    ~SDIODecodeCacheWriter();
+
+    bool Open(const char* file_name, U64 key);
+    // Carries on with a file after the records header says are valid
+    bool Append(const char* file_name, const SDIODecodeCache::Header &header);
+    // Keeps the file as of the last checkpoint
+    void Close();
+    // All records are valid, the file is complete
+    bool Finish();
+    bool IsOpen() const { return mFile != nullptr; }
+
+    void AddFrame(const SDIOFrame &frame);
+    void AddMarker(U64 sample);
+    void CommitPacket();
+    void AddCheckpoint(const SDIODecoderCheckpoint &checkpoint);
+
+protected:
+    bool WriteHeader();
+
+    FILE* mFile;
+    SDIODecodeCache::Header mHeader;
+    U64 mPackets;
+    U64 mLength;
+    U32 mFrameCount;
+    U32 mMarkerCount;
+    std::vector<U8> mRecord;
+    std::vector<U8> mMarkers;
+};
+
+#endif //SDIO_DECODE_CACHE
@@ -0,0 +1,108 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIODecodeCounters.h"
+#include "SDIOTextFormatter.h"
+#include <chrono>
+#include <string.h>
+
+static U64 Now()
+{
+    return U64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+SDIODecodeCounters::SDIODecodeCounters()
+{
+    Reset();
+}
+
+void SDIODecodeCounters::Reset()
+{
+    clockEdges = 0;
+    seeks = 0;
+    memset(advanceCalls, 0, sizeof(advanceCalls));
+    framesAdded = 0;
+    markersAdded = 0;
+    packetCommits = 0;
+    resultCommits = 0;
+    packets = 0;
+    argumentPackets = 0;
+    cmd52Packets = 0;
+    cmd53Packets = 0;
+    crc7Packets = 0;
+    crc16Errors = 0;
+    resyncs = 0;
+    skippedPackets = 0;
+    collapsedPolls = 0;
+    memset(phaseNanoseconds, 0, sizeof(phaseNanoseconds));
+    mPhase = PHASE_SEEK;
+    mPhaseStart = Now();
+}
+
+//The time of the phase that is running is not included until it ends.  At
+//the end of a capture that is the seek waiting for edges that never come.
+void SDIODecodeCounters::SwitchPhase(U32 phase)
+{
+    U64 now = Now();
+    phaseNanoseconds[mPhase] += now - mPhaseStart;
+    mPhase = phase;
+    mPhaseStart = now;
+}
+
+static void AppendCounter(SDIOTextFormatter &text, const char* name, U64 value)
+{
+    text.Append(name);
+    text.Append(",");
+    text.AppendNumber(value, Decimal, 64);
+    text.Append("\n");
+}
+
+void SDIODecodeCounters::Format(SDIOTextFormatter &text) const
+{
+    text.Append("Counter,Value\n");
+    AppendCounter(text, "clock edges", clockEdges);
+    AppendCounter(text, "edge seeks", seeks);
+    AppendCounter(text, "advance clock", advanceCalls[LINE_CLOCK]);
+    AppendCounter(text, "advance cmd", advanceCalls[LINE_CMD]);
+    AppendCounter(text, "advance dat0", advanceCalls[LINE_DAT0]);
+    AppendCounter(text, "advance dat1", advanceCalls[LINE_DAT1]);
+    AppendCounter(text, "advance dat2", advanceCalls[LINE_DAT2]);
+    AppendCounter(text, "advance dat3", advanceCalls[LINE_DAT3]);
+    AppendCounter(text, "advance dat4-dat7", advanceCalls[LINE_DAT4_7]);
+    AppendCounter(text, "frames", framesAdded);
+    AppendCounter(text, "markers", markersAdded);
+    AppendCounter(text, "packet commits", packetCommits);
+    AppendCounter(text, "result commits", resultCommits);
+    AppendCounter(text, "packets", packets);
+    AppendCounter(text, "packets ARGUMENT", argumentPackets);
+    AppendCounter(text, "packets CMD52_ARGUMENT", cmd52Packets);
+    AppendCounter(text, "packets CMD53_ARGUMENT", cmd53Packets);
+    AppendCounter(text, "packets CRC7", crc7Packets);
+    AppendCounter(text, "data CRC16 errors", crc16Errors);
+    AppendCounter(text, "resyncs", resyncs);
+    AppendCounter(text, "out of scope packets", skippedPackets);
+    AppendCounter(text, "collapsed polls", collapsedPolls);
+    AppendCounter(text, "seek ns", phaseNanoseconds[PHASE_SEEK]);
+    AppendCounter(text, "packet ns", phaseNanoseconds[PHASE_PACKET]);
+    AppendCounter(text, "data ns", phaseNanoseconds[PHASE_DATA]);
+}
@@ -0,0 +1,83 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_DECODE_COUNTERS
+#define SDIO_DECODE_COUNTERS
+
+#include <LogicPublicTypes.h>
+
+class SDIOTextFormatter;
+
+// Counts what the decoder does on its hot path so the cost of a capture can
+// be broken down.  Only the worker thread writes to the counters, so they are
+// plain integers.  The SDIO_COUNT()/SDIO_PHASE() macros used by the decoder
+// compile to nothing unless SDIO_INSTRUMENTATION is defined.
+class SDIODecodeCounters
+{
+public:
+    SDIODecodeCounters();
+
+    void Reset();
+
+    // Time is only taken when the phase changes, a few times per packet
+    void EnterPhase(U32 phase) { if (phase != mPhase) SwitchPhase(phase); }
+
+    // One "name,value" line per counter
+    void Format(SDIOTextFormatter &text) const;
+
+    enum phases {PHASE_SEEK, PHASE_PACKET, PHASE_DATA, PHASE_COUNT};
+    enum lines {LINE_CLOCK, LINE_CMD, LINE_DAT0, LINE_DAT1, LINE_DAT2, LINE_DAT3, LINE_DAT4_7, LINE_COUNT};
+
+    U64 clockEdges;
+    U64 seeks;
+    U64 advanceCalls[LINE_COUNT];
+    U64 framesAdded;
+    U64 markersAdded;
+    U64 packetCommits;
+    U64 resultCommits;
+    U64 packets;
+    U64 argumentPackets;
+    U64 cmd52Packets;
+    U64 cmd53Packets;
+    U64 crc7Packets;
+    U64 crc16Errors;
+    U64 resyncs;
+    U64 skippedPackets;
+    U64 collapsedPolls;
+    U64 phaseNanoseconds[PHASE_COUNT];
+
+protected:
+    void SwitchPhase(U32 phase);
+
+    U32 mPhase;
+    U64 mPhaseStart;
+};
+
+#ifdef SDIO_INSTRUMENTATION
+#define SDIO_COUNT(counter) (mCounters.counter++)
+#define SDIO_PHASE(phase) mCounters.EnterPhase(SDIODecodeCounters::phase)
+#else
+#define SDIO_COUNT(counter) ((void)0)
+#define SDIO_PHASE(phase) ((void)0)
+#endif
+
+#endif //SDIO_DECODE_COUNTERS
@@ -0,0 +1,1640 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIODecoder.h"
+#include <stdlib.h>
+
+SDIODecodeOptions::SDIODecodeOptions()
+:    mOverview(false),
+    mCollapsePolls(false),
+    mCommandMask(~U64(0)),
+    mFunctionFilter(FUNCTION_ALL),
+    mStartSample(0),
+    mEndSample(~U64(0)),
+    mCheckpointInterval(0),
+    mCheckTiming(false)
+{
+}
+
+bool SDIODecodeOptions::IsScoped() const
+{
+    return mCommandMask != ~U64(0) || mFunctionFilter != FUNCTION_ALL ||
+           mStartSample != 0 || mEndSample != ~U64(0);
+}
+
+// "52,53" selects only these commands, "!52" all but these, "" all of them
+bool SDIODecodeOptions::ParseCommandFilter( const char* filter, U64& mask )
+{
+    while (*filter == ' ')
+        filter++;
+    if (*filter == 0)
+    {
+        mask = ~U64(0);
+        return true;
+    }
+
+    bool exclude = *filter == '!';
+    if (exclude)
+        filter++;
+
+    U64 selected = 0;
+    for ( ; ; )
+    {
+        char* end;
+        unsigned long index = strtoul( filter, &end, 10 );
+        if (end == filter || index > 63)
+            return false;
+        selected |= U64(1) << index;
+
+        while (*end == ' ')
+            end++;
+        if (*end == 0)
+            break;
+        if (*end != ',')
+            return false;
+        filter = end + 1;
+    }
+
+    mask = exclude ? ~selected : selected;
+    return true;
+}
+
+// "start-end" where either end may be left out, "" for the whole capture
+bool SDIODecodeOptions::ParseSampleRange( const char* range, U64& start, U64& end )
+{
+    start = 0;
+    end = ~U64(0);
+
+    while (*range == ' ')
+        range++;
+    if (*range == 0)
+        return true;
+
+    char* next;
+    if (*range != '-')
+    {
+        start = strtoull( range, &next, 10 );
+        if (next == range)
+            return false;
+        range = next;
+    }
+    while (*range == ' ')
+        range++;
+    if (*range++ != '-')
+        return false;
+    while (*range == ' ')
+        range++;
+    if (*range != 0)
+    {
+        end = strtoull( range, &next, 10 );
+        if (next == range || *next != 0)
+            return false;
+    }
+    return start <= end;
+}
+
+SDIODecoder::SDIODecoder()
+:    mClock(nullptr),
+    mCmd(nullptr),
+    mDAT0(nullptr),
+    mDAT1(nullptr),
+    mDAT2(nullptr),
+    mDAT3(nullptr),
+    mDataLines(),
+    mSink(nullptr),
+    packetState(WAITING_FOR_PACKET),
+    frameState(TRANSMISSION_BIT),
+    app(false),
+    respType(RESP_NORMAL)
+{
+}
+
+void SDIODecoder::Start(SDIOChannel* clock, SDIOChannel* cmd, SDIOChannel* dat0, SDIOChannel* dat1,
+                        SDIOChannel* dat2, SDIOChannel* dat3, SDIOFrameSink* sink, const SDIODecodeOptions &options)
+{
+    mClock = clock;
+    mHashedCmd.SetChannel(cmd);
+    mCmd = options.mCheckpointInterval != 0 ? &mHashedCmd : cmd;
+    mDAT0 = dat0;
+    mDAT1 = dat1;
+    mDAT2 = dat2;
+    mDAT3 = dat3;
+    mDataLines[0] = dat0;
+    mDataLines[1] = dat1;
+    mDataLines[2] = dat2;
+    mDataLines[3] = dat3;
+    mSink = sink;
+    mOptions = options;
+    overviewMode = options.mOverview;
+
+    //Assume the widest bus the data lines are connected for until a write to
+    //the bus interface control register says otherwise
+    busWidth = MaxBusWidth();
+    //DAT1 alone still signals interrupts on a 1 bit bus
+    connectedLines = busWidth == 1 && mDAT1 ? 2 : busWidth;
+    SelectLoop();
+    //A decode that starts in the middle of the traffic may see a response
+    //first
+    packetState = WAITING_FOR_PACKET;
+    frameState = TRANSMISSION_BIT;
+    respLength = 32;
+    respType = RESP_NORMAL;
+    dataState = DATA_IDLE;
+    dataWrite = false;
+    blockStarted = false;
+    for (U32 fn = 0; fn < 8; fn++){
+        blockSize[fn] = 512;
+    }
+    cmd52Write = false;
+    cmd52Function = 0;
+    cmd52Address = 0;
+    mPayload.Open(mOptions.mPayloadDirectory.c_str());
+    mCounters.Reset();
+    mTimeline.Reset();
+    mTiming.Reset();
+    mRegisters.Reset();
+    clockCount = 0;
+    startClock = 0;
+
+    scoped = mOptions.IsScoped();
+    packetInScope = true;
+    commandInScope = true;
+    pendingFrameCount = 0;
+    pendingMarkerCount = 0;
+    holdFields = false;
+    lastFrameEnd = 0;
+    irqAsserted = false;
+    irqAtPacketStart = false;
+    pollAwaiting = false;
+    pollActive = false;
+    pollHeld = false;
+    pollCount = 0;
+
+    mCheckpoints.clear();
+    packetCount = 0;
+    nextCheckpoint = mOptions.mCheckpointInterval;
+
+    mClock->AdvanceToNextEdge();
+    AdvanceLinesTo(mClock->GetSampleNumber());
+    dat1State = mDAT1 ? mDAT1->GetBitState() : BIT_HIGH;
+    firstCmdEdge = mOptions.mCheckpointInterval != 0 ? mCmd->GetSampleOfNextEdge() : 0;
+}
+
+void SDIODecoder::SetUpperDataLines(SDIOChannel* dat4, SDIOChannel* dat5, SDIOChannel* dat6, SDIOChannel* dat7)
+{
+    mDataLines[4] = dat4;
+    mDataLines[5] = dat5;
+    mDataLines[6] = dat6;
+    mDataLines[7] = dat7;
+}
+
+size_t SDIODecoder::FindCheckpoint(const std::vector<SDIODecoderCheckpoint> &checkpoints, U64 sample) const
+{
+    size_t count = 0;
+    while (count < checkpoints.size() && checkpoints[count].mSample <= sample &&
+           checkpoints[count].mFirstCmdEdge == firstCmdEdge){
+        count++;
+    }
+    return mOptions.mCheckpointInterval != 0 ? count : 0;
+}
+
+bool SDIODecoder::Resume(const std::vector<SDIODecoderCheckpoint> &checkpoints, size_t count)
+{
+    const SDIODecoderCheckpoint &checkpoint = checkpoints[count - 1];
+    //The command line has to have the same edges up to the checkpoint, the
+    //other lines only move once it does
+    while (mCmd->WouldAdvancingToAbsPositionCauseTransition(checkpoint.mNextCmdEdge - 1)){
+        mCmd->AdvanceToNextEdge();
+    }
+    if (mHashedCmd.GetHash() != checkpoint.mCmdHash || mCmd->GetSampleOfNextEdge() != checkpoint.mNextCmdEdge){
+        return false;
+    }
+    mClock->AdvanceToAbsPosition(checkpoint.mSample);
+    AdvanceLinesTo(checkpoint.mSample);
+    lastFallingClockEdge = checkpoint.mSample;
+    lastFrameEnd = checkpoint.mLastFrameEnd;
+    app = checkpoint.mApp != 0;
+    busWidth = checkpoint.mBusWidth;
+    SelectLoop();
+    for (U32 fn = 0; fn < 8; fn++){
+        blockSize[fn] = checkpoint.mBlockSize[fn];
+    }
+    dat1State = BitState(checkpoint.mDat1State);
+    irqAsserted = checkpoint.mIrqAsserted != 0;
+    irqStart = checkpoint.mIrqStart;
+    pollActive = checkpoint.mPollActive != 0;
+    pollCommand = checkpoint.mPollCommand;
+    pollResponse = checkpoint.mPollResponse;
+    pollStart = checkpoint.mPollStart;
+    mTimeline = checkpoint.mTimeline;
+    mTiming = checkpoint.mTiming;
+    clockCount = checkpoint.mClockCount;
+
+    mCheckpoints.assign(checkpoints.begin(), checkpoints.begin() + count);
+    packetCount = checkpoint.mPackets;
+    nextCheckpoint = packetCount + mOptions.mCheckpointInterval;
+    return true;
+}
+
+//Only right after a response, nothing of the packet before is needed then
+void SDIODecoder::TakeCheckpoint()
+{
+    packetCount++;
+    if (packetCount < nextCheckpoint || isCmd || dataState != DATA_IDLE || pollCount != 0 || pollHeld){
+        return;
+    }
+    nextCheckpoint = packetCount + mOptions.mCheckpointInterval;
+
+    SDIODecoderCheckpoint checkpoint;
+    checkpoint.mSample = mClock->GetSampleNumber();
+    checkpoint.mFirstCmdEdge = firstCmdEdge;
+    checkpoint.mNextCmdEdge = mCmd->GetSampleOfNextEdge();
+    checkpoint.mCmdHash = mHashedCmd.GetHash();
+    checkpoint.mPackets = packetCount;
+    checkpoint.mLastFrameEnd = lastFrameEnd;
+    checkpoint.mIrqStart = irqStart;
+    checkpoint.mPollStart = pollStart;
+    checkpoint.mClockCount = clockCount;
+    checkpoint.mPollCommand = pollCommand;
+    checkpoint.mPollResponse = pollResponse;
+    for (U32 fn = 0; fn < 8; fn++){
+        checkpoint.mBlockSize[fn] = blockSize[fn];
+    }
+    checkpoint.mApp = app;
+    checkpoint.mBusWidth = U8(busWidth);
+    checkpoint.mDat1State = U8(dat1State);
+    checkpoint.mIrqAsserted = irqAsserted;
+    checkpoint.mPollActive = pollActive;
+    checkpoint.mTimeline = mTimeline;
+    checkpoint.mTiming = mTiming;
+    mCheckpoints.push_back(checkpoint);
+    mSink->AddCheckpoint(checkpoint);
+}
+
+bool SDIODecoder::GetNextSample(U64 &sample)
+{
+    if (packetState == IN_PACKET || !DataWaitsForEdge()){
+        sample = mClock->GetSampleNumber();
+        return true;
+    }
+
+    //As in Step(), a run of polls does not wait for more data
+    if ((pollCount != 0 || pollHeld) && !mCmd->DoMoreTransitionsExistInCurrentData()){
+        EndRun();
+    }
+
+    //The seek goes to the next command edge, or DAT0 edge if it comes first
+    //and data is expected
+    bool found = false;
+    sample = ~U64(0);
+    if (mCmd->DoMoreTransitionsExistInCurrentData()){
+        sample = mCmd->GetSampleOfNextEdge();
+        found = true;
+    }
+    if (dataState != DATA_IDLE && mDAT0->DoMoreTransitionsExistInCurrentData()){
+        U64 dataEdge = mDAT0->GetSampleOfNextEdge();
+        sample = dataEdge < sample ? dataEdge : sample;
+        found = true;
+    }
+    return found;
+}
+
+U64 SDIODecoder::GetFrameBound() const
+{
+    U64 bound = packetState == IN_PACKET ? startOfPacket : lastFallingClockEdge;
+    if (pollCount != 0 && runStart < bound){
+        bound = runStart;
+    }
+    if (pollHeld && heldStart < bound){
+        bound = heldStart;
+    }
+    if (irqAsserted && irqStart < bound){
+        bound = irqStart;
+    }
+    if (dataState == DATA_BUSY_LOW && busyStart < bound){
+        bound = busyStart;
+    }
+    return bound > lastFrameEnd ? bound : lastFrameEnd + 1;
+}
+
+void SDIODecoder::Step()
+{
+    (this->*mLoop)();
+
+    mSink->CommitResults();
+    SDIO_COUNT(resultCommits);
+}
+
+void SDIODecoder::Finish()
+{
+    EndRun();
+    mSink->CommitResults();
+}
+
+//Determine whether or not we are in a packet
+template <U32 LINES, U32 WIDTH> void SDIODecoder::PacketStateMachine()
+{
+    if (packetState == WAITING_FOR_PACKET && DataWaitsForEdge())
+    {
+        //If we are not in a packet, let's advance to the next edge on the
+        //command line, or on DAT0 if it comes first and a data transfer is
+        //expected
+        SDIO_PHASE(PHASE_SEEK);
+        SDIO_COUNT(seeks);
+        //A run of polls is only added once it ends, don't let it wait for
+        //more data
+        if ((pollCount != 0 || pollHeld) && !mCmd->DoMoreTransitionsExistInCurrentData()){
+            EndRun();
+        }
+        bool dataEdge = false;
+        if (dataState != DATA_IDLE){
+            if (mCmd->DoMoreTransitionsExistInCurrentData()){
+                dataEdge = mDAT0->WouldAdvancingToAbsPositionCauseTransition(mCmd->GetSampleOfNextEdge());
+            }else{
+                //Don't wait for the next command if the data is already there
+                dataEdge = mDAT0->DoMoreTransitionsExistInCurrentData();
+            }
+        }
+
+        //Interrupts only change DAT1, step through its edges on the way
+        if (LINES >= 2){
+            U64 nextEdge = dataEdge ? mDAT0->GetSampleOfNextEdge() : mCmd->GetSampleOfNextEdge();
+            while (mDAT1->WouldAdvancingToAbsPositionCauseTransition(nextEdge)){
+                mDAT1->AdvanceToNextEdge();
+                CheckInterruptLine(mDAT1->GetSampleNumber());
+            }
+        }
+
+        U64 sampleNumber;
+        if (dataEdge){
+            mDAT0->AdvanceToNextEdge();
+            sampleNumber = mDAT0->GetSampleNumber();
+        }else{
+            mCmd->AdvanceToNextEdge();
+            sampleNumber = mCmd->GetSampleNumber();
+        }
+        lastFallingClockEdge = sampleNumber;
+        dataSample = sampleNumber;
+        U64 edgeSample = sampleNumber;
+        if (mOptions.mCheckTiming){
+            //The timing checks count the clock cycles of the gap
+            while (mClock->WouldAdvancingToAbsPositionCauseTransition(sampleNumber)){
+                mClock->AdvanceToNextEdge();
+                SDIO_COUNT(clockEdges);
+                if (mClock->GetBitState() == BIT_HIGH){
+                    clockCount++;
+                }
+            }
+        }
+        mClock->AdvanceToAbsPosition(sampleNumber);
+        SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_CLOCK]);
+        //After advancing to the next command line edge the clock can either
+        //high or low.  If it is high, we need to advance two clock edges.  If
+        //it is low, we only need to advance one clock edge.
+        if (mClock->GetBitState() == BIT_HIGH){
+            mClock->AdvanceToNextEdge();
+        }
+
+        mClock->AdvanceToNextEdge();
+        SDIO_COUNT(clockEdges);
+        clockCount++;
+        AdvanceLinesTo<LINES>(mClock->GetSampleNumber());
+        if (LINES >= 2){
+            CheckInterruptLine(mClock->GetSampleNumber());
+        }
+
+        if (mCmd->GetBitState() == BIT_LOW){
+            StartPacket(edgeSample);
+        }else if (!dataEdge){
+            //The command line edge was not a start bit, look for the next one
+            SDIO_COUNT(resyncs);
+        }
+        if (dataState != DATA_IDLE){
+            DataStateMachine<WIDTH>();
+        }
+    }
+    else
+    {
+        //Either a packet or a data block is being clocked in, go edge by edge
+        if (packetState == IN_PACKET){
+            SDIO_PHASE(PHASE_PACKET);
+        }else{
+            SDIO_PHASE(PHASE_DATA);
+        }
+        mClock->AdvanceToNextEdge();
+        SDIO_COUNT(clockEdges);
+        AdvanceLinesTo<LINES>(mClock->GetSampleNumber());
+        if (LINES >= 2){
+            CheckInterruptLine(mClock->GetSampleNumber());
+        }
+        dataSample = mClock->GetSampleNumber();
+
+        if (mClock->GetBitState() == BIT_HIGH){
+            clockCount++;
+            if (packetState == IN_PACKET){
+                AddClockMarker();
+                if (FrameStateMachine()==1){
+                    if (packetInScope){
+                        mSink->CommitPacket();
+                        SDIO_COUNT(packetCommits);
+                    }
+                    mSink->CommitResults();
+                    SDIO_COUNT(resultCommits);
+                    packetState = WAITING_FOR_PACKET;
+                    if (mOptions.mCheckpointInterval != 0){
+                        TakeCheckpoint();
+                    }
+                }
+            }else if (mCmd->GetBitState() == BIT_LOW){
+                //Start bit of a packet sent while a data block is in progress
+                StartPacket(lastFallingClockEdge);
+            }
+            if (dataState != DATA_IDLE){
+                DataStateMachine<WIDTH>();
+            }
+        }else{
+            lastFallingClockEdge = mClock->GetSampleNumber();
+        }
+    }
+}
+
+//Bring the command and data lines up to the clock
+template <U32 LINES> void SDIODecoder::AdvanceLinesTo(U64 sampleNumber)
+{
+    mCmd->AdvanceToAbsPosition(sampleNumber);
+    mDAT0->AdvanceToAbsPosition(sampleNumber);
+    SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_CMD]);
+    SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_DAT0]);
+    if (LINES >= 2){
+        mDAT1->AdvanceToAbsPosition(sampleNumber);
+        SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_DAT1]);
+    }
+    if (LINES >= 4){
+        mDAT2->AdvanceToAbsPosition(sampleNumber);
+        mDAT3->AdvanceToAbsPosition(sampleNumber);
+        SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_DAT2]);
+        SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_DAT3]);
+    }
+    if (LINES == 8){
+        mDataLines[4]->AdvanceToAbsPosition(sampleNumber);
+        mDataLines[5]->AdvanceToAbsPosition(sampleNumber);
+        mDataLines[6]->AdvanceToAbsPosition(sampleNumber);
+        mDataLines[7]->AdvanceToAbsPosition(sampleNumber);
+        SDIO_COUNT(advanceCalls[SDIODecodeCounters::LINE_DAT4_7]);
+    }
+}
+
+//Outside of the decode loop, when starting or resuming
+void SDIODecoder::AdvanceLinesTo(U64 sampleNumber)
+{
+    if (connectedLines == 8){
+        AdvanceLinesTo<8>(sampleNumber);
+    }else if (connectedLines == 4){
+        AdvanceLinesTo<4>(sampleNumber);
+    }else if (connectedLines == 2){
+        AdvanceLinesTo<2>(sampleNumber);
+    }else{
+        AdvanceLinesTo<1>(sampleNumber);
+    }
+}
+
+//The decode loop for the lines connected and the bus width in use, so the
+//per clock path tests for neither.  Picked again when the width changes.
+void SDIODecoder::SelectLoop()
+{
+    if (connectedLines == 8){
+        mLoop = busWidth == 8 ? &SDIODecoder::PacketStateMachine<8, 8> :
+                busWidth == 4 ? &SDIODecoder::PacketStateMachine<8, 4> : &SDIODecoder::PacketStateMachine<8, 1>;
+    }else if (connectedLines == 4){
+        mLoop = busWidth == 4 ? &SDIODecoder::PacketStateMachine<4, 4> : &SDIODecoder::PacketStateMachine<4, 1>;
+    }else if (connectedLines == 2){
+        mLoop = &SDIODecoder::PacketStateMachine<2, 1>;
+    }else{
+        mLoop = &SDIODecoder::PacketStateMachine<1, 1>;
+    }
+}
+
+//Frames and markers are held back when something may have to be added
+//before them once the packet is complete, e.g. the CRC error or busy frame of
+//a data block that ends while the packet is sent
+void SDIODecoder::StartPacket(U64 sampleNumber)
+{
+    startOfPacket = sampleNumber;
+    packetState = IN_PACKET;
+    startClock = TimingClock();
+    irqAtPacketStart = irqAsserted;
+    holdFields = scoped || irqAsserted || dataState != DATA_IDLE || mOptions.mCollapsePolls ||
+                 mOptions.mCheckTiming;
+}
+
+//Clock cycle for the timing checks, 0 when they are off
+U64 SDIODecoder::TimingClock()
+{
+    if (!mOptions.mCheckTiming){
+        return 0;
+    }
+    U64 count;
+    return mClock->GetRisingEdgeCount(count) ? count : clockCount;
+}
+
+//In 4 bit mode DAT1 only signals an interrupt while no data is transferred
+void SDIODecoder::CheckInterruptLine(U64 sampleNumber)
+{
+    BitState state = mDAT1->GetBitState();
+    if (state == dat1State){
+        return;
+    }
+    dat1State = state;
+    if (state == BIT_LOW && !irqAsserted && (busWidth == 1 || dataState == DATA_IDLE)){
+        irqAsserted = true;
+        irqStart = sampleNumber;
+    }
+}
+
+//The interrupt is serviced when the host reads the interrupt pending register
+void SDIODecoder::ServiceInterrupt()
+{
+    U32 index = U32(packetBits >> 40) & 0x3F;
+    U32 argument = U32(packetBits >> 8);
+    if (index == 52 && (argument >> 31) == 0 && ((argument >> 28) & 0x7) == 0 &&
+        ((argument >> 9) & 0x1FFFF) == 0x05){
+        AddTimingFrame(FRAME_IRQ, irqStart, startOfPacket - 1, startOfPacket - 1 - irqStart);
+        irqAsserted = false;
+    }
+}
+
+//Counted in any case, the frames are only added when asked for
+void SDIODecoder::AddTimingViolation(const SDIOResponseTiming::Violation &violation)
+{
+    if (mOptions.mCheckTiming){
+        AddTimingFrame(FRAME_TIMING, violation.mStart, violation.mEnd, SDIOResponseTiming::Pack(violation));
+    }
+}
+
+//Timed frames get a packet of their own.  They cover the part of their time
+//not already taken by the frames of other packets.
+void SDIODecoder::AddTimingFrame(U8 type, U64 start, U64 end, U64 data1)
+{
+    if (start < mOptions.mStartSample || start > mOptions.mEndSample){
+        return;
+    }
+    EndRun();
+
+    SDIOFrame frame;
+    frame.mStartingSampleInclusive = start > lastFrameEnd ? start : lastFrameEnd + 1;
+    frame.mEndingSampleInclusive = end;
+    if (packetState == IN_PACKET && end >= startOfPacket){
+        frame.mEndingSampleInclusive = startOfPacket - 1;
+    }
+    if (frame.mEndingSampleInclusive < frame.mStartingSampleInclusive ||
+        (packetState == IN_PACKET && !holdFields && !overviewMode)){
+        return;
+    }
+    frame.mType = type;
+    frame.mFlags = 0;
+    frame.mData1 = data1;
+    frame.mData2 = start;
+    AddResultFrame(frame);
+    mSink->CommitPacket();
+    SDIO_COUNT(packetCommits);
+}
+
+//True while the data lines only need to be looked at when DAT0 changes
+bool SDIODecoder::DataWaitsForEdge()
+{
+    return dataState == DATA_IDLE || dataState == DATA_WAIT_START ||
+           dataState == DATA_WAIT_STATUS || dataState == DATA_BUSY_LOW;
+}
+
+U32 SDIODecoder::MaxBusWidth() const
+{
+    if (!mDAT1 || !mDAT2 || !mDAT3){
+        return 1;
+    }
+    return mDataLines[4] && mDataLines[5] && mDataLines[6] && mDataLines[7] ? 8 : 4;
+}
+
+//The data lines in use as one value, bit n from DATn
+template <U32 WIDTH> U8 SDIODecoder::GatherDataLines()
+{
+    U32 lines = 0;
+    for (U32 line = 0; line < WIDTH; line++){
+        lines |= U32(mDataLines[line]->GetBitState() == BIT_HIGH) << line;
+    }
+    return U8(lines);
+}
+
+//One clock of the CRC16 (x^16 + x^12 + x^5 + 1) of every line.  Shifting
+//the 16 bytes by one byte shifts all the CRCs by one bit.
+void SDIODecoder::UpdateDataCrc(U8 lines)
+{
+    U64 feedback = U8(crcHigh >> 56) ^ lines;
+    crcHigh = crcHigh << 8 | crcLow >> 56;
+    crcLow = crcLow << 8 | feedback;
+    crcLow ^= feedback << 40;
+    crcHigh ^= feedback << 32;
+}
+
+//Clocks in the data blocks of a CMD53 transfer on each rising clock edge.
+//Each block is a start bit, the data, a CRC16 per line and an end bit.  For
+//writes the card answers every block with a CRC status token on DAT0 and then
+//holds DAT0 low while it is busy.
+template <U32 WIDTH> void SDIODecoder::DataStateMachine()
+{
+    if (dataState == DATA_WAIT_START)
+    {
+        if (mDAT0->GetBitState() == BIT_LOW){
+            dataState = DATA_BLOCK;
+            blockStart = dataSample;
+            blockStarted = true;
+            SDIOResponseTiming::Violation violation;
+            if (dataWrite && mTiming.AddWriteBlock(blockStart, TimingClock(), violation)){
+                AddTimingViolation(violation);
+            }
+            dataCounter = blockLength * 8 / WIDTH;
+            dataByte = 0;
+            dataBits = 0;
+            dataLength = 0;
+            crcLow = 0;
+            crcHigh = 0;
+        }
+    }
+    else if (dataState == DATA_BLOCK)
+    {
+        //DAT7 (or DAT3, DAT0) holds the most significant bit
+        U8 lines = GatherDataLines<WIDTH>();
+        UpdateDataCrc(lines);
+        dataByte = U8(dataByte << WIDTH | lines);
+        dataBits += WIDTH;
+        if (dataBits == 8){
+            dataBuffer[dataLength++] = dataByte;
+            dataByte = 0;
+            dataBits = 0;
+        }
+
+        dataCounter--;
+        if (dataCounter == 0){
+            dataState = DATA_CRC;
+            dataCounter = 16;
+            crcReceivedLow = 0;
+            crcReceivedHigh = 0;
+        }
+    }
+    else if (dataState == DATA_CRC)
+    {
+        //The CRC comes most significant bit first, on every line at once
+        U8 lines = GatherDataLines<WIDTH>();
+        crcReceivedHigh = crcReceivedHigh << 8 | crcReceivedLow >> 56;
+        crcReceivedLow = crcReceivedLow << 8 | lines;
+        dataCounter--;
+        if (dataCounter == 0){
+            dataState = DATA_END;
+        }
+    }
+    else if (dataState == DATA_END)
+    {
+        U64 errors = (crcLow ^ crcReceivedLow) | (crcHigh ^ crcReceivedHigh);
+        errors |= errors >> 32;
+        errors |= errors >> 16;
+        errors |= errors >> 8;
+        errors &= (1u << WIDTH) - 1;
+        if (errors != 0){
+            SDIO_COUNT(crc16Errors);
+            AddTimingFrame(FRAME_DATA_CRC, blockStart, dataSample, errors);
+        }
+        mPayload.AddData(dataFunction, dataWrite, dataBuffer, dataLength);
+        if (dataWrite){
+            dataState = DATA_WAIT_STATUS;
+        }else{
+            EndOfDataBlock();
+        }
+    }
+    else if (dataState == DATA_WAIT_STATUS)
+    {
+        if (mDAT0->GetBitState() == BIT_LOW){
+            //Start bit of the CRC status token, 3 status bits and an end bit follow
+            dataState = DATA_STATUS;
+            dataCounter = 4;
+        }
+    }
+    else if (dataState == DATA_STATUS)
+    {
+        dataCounter--;
+        if (dataCounter == 0){
+            //The card may take a couple of clocks before it signals busy
+            dataState = DATA_BUSY;
+            dataCounter = 2;
+        }
+    }
+    else if (dataState == DATA_BUSY)
+    {
+        if (mDAT0->GetBitState() == BIT_LOW){
+            dataState = DATA_BUSY_LOW;
+            busyStart = dataSample;
+            if (!blockStarted){
+                //R1b busy, the card's time counts as the data phase
+                blockStart = dataSample;
+                blockStarted = true;
+            }
+        }else if (--dataCounter == 0){
+            EndOfDataBlock();
+        }
+    }
+    else if (dataState == DATA_BUSY_LOW)
+    {
+        if (mDAT0->GetBitState() == BIT_HIGH){
+            AddTimingFrame(FRAME_BUSY, busyStart, dataSample, dataSample - busyStart);
+            EndOfDataBlock();
+        }
+    }
+}
+
+//A block count of 0 in block mode keeps the transfer going until it is aborted
+void SDIODecoder::EndOfDataBlock()
+{
+    if (blockStarted){
+        if (blockStart >= mOptions.mStartSample && blockStart <= mOptions.mEndSample){
+            mSink->AddDataBlock(blockStart, dataSample);
+        }
+        blockStarted = false;
+    }
+    if (dataWrite){
+        mTiming.EndWriteBlock(dataSample, TimingClock());
+    }
+    if (blocksRemaining == 1){
+        dataState = DATA_IDLE;
+    }else{
+        if (blocksRemaining != 0){
+            blocksRemaining--;
+        }
+        dataState = DATA_WAIT_START;
+    }
+}
+
+//Called at the end of every packet to follow the CMD53 transfers and the
+//registers that control their data phase
+void SDIODecoder::TrackTransfers()
+{
+    if (longPacket){
+        return;
+    }
+
+    U32 index = U32(packetBits >> 40) & 0x3F;
+    U32 argument = U32(packetBits >> 8);
+
+    if (isCmd && index == 52)
+    {
+        cmd52Write = (argument >> 31) != 0;
+        cmd52Function = (argument >> 28) & 0x7;
+        cmd52Address = (argument >> 9) & 0x1FFFF;
+        if (cmd52Write && cmd52Function == 0){
+            SetRegister(cmd52Address, U8(argument));
+        }
+    }
+    else if (!isCmd && index == 52)
+    {
+        //Registers read back by the host tell us as much as the writes, but
+        //reading the I/O abort register does not abort anything
+        if (!cmd52Write && cmd52Function == 0 && cmd52Address != 0x06){
+            SetRegister(cmd52Address, U8(argument));
+        }
+    }
+    else if (!isCmd && (index == 7 || index == 12) && dataState == DATA_IDLE)
+    {
+        //R1b, the card may hold DAT0 low while it is busy.  The end bit of
+        //the response is counted as well.  The busy is not of a write block.
+        dataWrite = false;
+        blocksRemaining = 1;
+        dataState = DATA_BUSY;
+        dataCounter = 3;
+    }
+    else if (isCmd && index == 53)
+    {
+        //A partial block of a previous transfer is not going to complete
+        if (dataState == DATA_BLOCK && dataLength > 0){
+            mPayload.AddData(dataFunction, dataWrite, dataBuffer, dataLength);
+        }
+
+        U32 count = argument & 0x1FF;
+        blockStarted = false;
+        dataWrite = (argument >> 31) != 0;
+        dataFunction = (argument >> 28) & 0x7;
+        if ((argument >> 27) & 0x1){
+            blockLength = blockSize[dataFunction];
+            blocksRemaining = count;
+        }else{
+            blockLength = count == 0 ? 512 : count;
+            blocksRemaining = 1;
+        }
+        dataState = blockLength == 0 ? DATA_IDLE : DATA_WAIT_START;
+    }
+}
+
+//Function 0 register writes that change how data blocks are clocked in
+void SDIODecoder::SetRegister(U32 address, U8 value)
+{
+    if (address == 0x06)
+    {
+        //I/O abort of the function in ASx stops the current transfer
+        if ((value & 0x7) == dataFunction && dataState != DATA_IDLE){
+            if (dataState == DATA_BLOCK && dataLength > 0){
+                mPayload.AddData(dataFunction, dataWrite, dataBuffer, dataLength);
+            }
+            dataState = DATA_IDLE;
+            blockStarted = false;
+        }
+    }
+    else if (address == 0x07)
+    {
+        //Bus width, 0 for 1 bit, 2 for 4 bit and 3 for 8 bit
+        U32 width = (value & 0x3) == 0x3 ? 8 : (value & 0x3) == 0x2 ? 4 : 1;
+        busWidth = width <= MaxBusWidth() ? width : 1;
+        SelectLoop();
+    }
+    else if ((address & 0xFF) == 0x10 || (address & 0xFF) == 0x11)
+    {
+        //Block size of function 0 in the CCCR, of functions 1-7 in their FBR
+        U32 fn = address >> 8;
+        if (fn < 8){
+            if (address & 0x1){
+                blockSize[fn] = (blockSize[fn] & 0x00FF) | (value << 8);
+            }else{
+                blockSize[fn] = (blockSize[fn] & 0xFF00) | value;
+            }
+            if (blockSize[fn] > sizeof(dataBuffer)){
+                blockSize[fn] = sizeof(dataBuffer);
+            }
+        }
+    }
+}
+
+
+//This state machine will deal with accepting the different parts of the
+//transmitted information.  In order to correctly interpret the data stream,
+//we need to be able to distinguish between 4 different kinds of packets.
+//They are:
+//    - Command
+//      - Short Response
+//  - Long Response
+//  - Data
+
+//CRC7 of the first 40 bits of a 48 bit packet against the 7 bits after
+//them, followed by the end bit
+static bool CommandCrcValid(U64 bits)
+{
+    U8 crc = 0;
+    for (int i = 47; i >= 8; i--){
+        U8 feedback = U8((crc >> 6) ^ (bits >> i)) & 1;
+        crc = (crc << 1) & 0x7F;
+        if (feedback){
+            crc ^= 0x09;
+        }
+    }
+    return (bits & 0xFF) == U64(crc << 1 | 1);
+}
+
+//The command line is sampled on the rising clock edges, as by the decoder,
+//into a 48 bit window that slides one bit at a time.  A start bit and host
+//direction bit in front of a matching CRC7 and end bit is a command.
+bool SDIODecoder::SeekCommand(SDIOChannel* const* lines, U32 count, U64 sample)
+{
+    SDIOChannel* clock = lines[0];
+    SDIOChannel* cmd = lines[1];
+    for (U32 i = 0; i < count; i++){
+        if (lines[i]){
+            lines[i]->AdvanceToAbsPosition(sample);
+        }
+    }
+
+    U64 bits = 0;
+    U32 bitCount = 0;
+    for ( ; ; ){
+        if (!clock->DoMoreTransitionsExistInCurrentData()){
+            return false;
+        }
+        clock->AdvanceToNextEdge();
+        if (clock->GetBitState() != BIT_HIGH){
+            continue;
+        }
+        cmd->AdvanceToAbsPosition(clock->GetSampleNumber());
+        bits = (bits << 1 | U64(cmd->GetBitState() == BIT_HIGH)) & 0xFFFFFFFFFFFFULL;
+        bitCount++;
+        if (bitCount >= 48 && (bits >> 46) == 1 && CommandCrcValid(bits)){
+            break;
+        }
+    }
+
+    for (U32 i = 2; i < count; i++){
+        if (lines[i]){
+            lines[i]->AdvanceToAbsPosition(clock->GetSampleNumber());
+        }
+    }
+    return true;
+}
+
+U32 SDIODecoder::FrameStateMachine()
+{
+    //Keep the raw bits of the whole packet, the start bit is always 0
+    if (frameState == TRANSMISSION_BIT){
+        packetBits = 0;
+        longPacket = false;
+    }
+    packetBits = packetBits << 1 | mCmd->GetBitState();
+
+    if (frameState == TRANSMISSION_BIT)
+    {
+        SDIOFrame frame;
+        frame.mStartingSampleInclusive = lastFallingClockEdge;
+        frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+        frame.mFlags = 0;
+        frame.mData1 = mCmd->GetBitState();
+        frame.mType = FRAME_DIR;
+        AddFieldFrame(frame);
+
+        //The transmission bit tells us the origin of the packet
+        //If the bit is high the packet comes from the host
+        //If the bit is low, the packet comes from the slave
+        isCmd = mCmd->GetBitState();
+
+
+        frameState = COMMAND;
+        frameCounter = 6;
+
+        startOfNextFrame = (frame.mEndingSampleInclusive + 1);
+        temp = 0;
+    }
+    else if (frameState == COMMAND)
+    {
+        temp = temp<<1 | mCmd->GetBitState();
+
+        frameCounter--;
+        if (frameCounter == 0)
+        {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp; // Select the first 6 bits
+            frame.mType = FRAME_CMD;
+            AddFieldFrame(frame);
+
+            //Once we have the arguement
+
+            //Find the expected length of the next reponse based on the command
+            if (isCmd && app){
+                //Deal with the application commands first
+                //All Application commands have a 48 bit response
+                respLength = 32;
+            }else if (isCmd){
+                //Deal with standard commands now
+                //CMD2, CMD9 and CMD10 respond with R2
+                if (temp == 2 || temp == 9 || temp == 10){
+                    respLength = 127;
+                    respType = RESP_LONG;
+                }else{
+                    // All others have 48 bit responses
+                    respLength = 32;
+                    respType = RESP_NORMAL;
+                }
+
+            }
+
+            if (temp == 52)
+              {
+                frameState = CMD52_ARGUMENT;
+                SDIO_COUNT(cmd52Packets);
+
+                cmd52State = isCmd ? CMD52_RWFLAG : CMD52_RESP_STUFF;
+              }
+            else if (temp == 53)
+              {
+                frameState = CMD53_ARGUMENT;
+                SDIO_COUNT(cmd53Packets);
+                // Are we decoding a command from host or response from device
+                // Based on this choose which state to start in
+                cmd53State = isCmd ? CMD53_RWFLAG : CMD53_RESP_STUFF;
+              }
+            else
+              {
+                frameState = ARGUMENT;
+                SDIO_COUNT(argumentPackets);
+              }
+
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+            if (isCmd){
+                frameCounter = 32;
+            }else{
+                frameCounter = respLength;
+            }
+        }
+
+    }
+    else if (frameState == ARGUMENT)
+    {
+        temp = temp << 1 | mCmd->GetBitState();
+
+        frameCounter--;
+
+        if (!isCmd && frameCounter == 1 && respType == RESP_LONG){
+            temp = temp<<1;
+
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp2;
+            frame.mData2 = temp;
+            frame.mType = FRAME_LONG_ARG;
+            AddFieldFrame(frame);
+
+            longPacket = true;
+            longArgLow = temp;
+
+            frameState = STOP;
+            frameCounter = 1;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+
+        }else if (frameCounter == 0){
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp; // Select the first 6 bits
+            frame.mType = FRAME_ARG;
+            AddFieldFrame(frame);
+
+            frameState = CRC7;
+            frameCounter = 7;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+        }else if (frameCounter == 63 && !isCmd){
+            temp2 = temp;
+            temp = 0;
+        }
+    }
+    else if (frameState == CMD52_ARGUMENT)
+    {
+        temp = temp << 1 | mCmd->GetBitState();
+
+        frameCounter--;
+        if (cmd52State == CMD52_RWFLAG)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = mCmd->GetBitState();
+            frame.mType = FRAME_CMD52_RWFLAG;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_FN;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            // Keep track of if we're reading or writing
+            cmd52writenotread = mCmd->GetBitState() ? true : false;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_FN && frameCounter == 28)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD52_FN;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_RAW;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+          }
+        else if (cmd52State == CMD52_RAW)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = mCmd->GetBitState();
+            frame.mType = FRAME_CMD52_RAW;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_STUFF1;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_STUFF1)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = mCmd->GetBitState();
+            frame.mData2 = 1;
+            frame.mType = FRAME_CMD52_STUFF;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_ADDR;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_ADDR && frameCounter == 9)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD52_ADDR;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_STUFF2;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_STUFF2 && ((cmd52writenotread == false && frameCounter == 0)
+                            || cmd52writenotread == true))
+          {
+            // If we're writing, we'll only have a single STUFF2 bit,
+            // else if we're reading it'll be stuff bits until the end of the CMD52 argument field.
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD52_STUFF;
+
+            if (cmd52writenotread)
+              {
+            cmd52State = CMD52_DATA;
+            frame.mData2 = 1; // Store the length of the stuff bits in this case in data2
+              }
+            else
+              {
+            frame.mData2 = 9; // Store the length of the stuff bits in this case in data2
+            frameState = CRC7;
+            frameCounter = 7;
+              }
+            AddFieldFrame(frame);
+
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_DATA && frameCounter == 0)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD52_DATA;
+            AddFieldFrame(frame);
+
+            frameState = CRC7;
+            frameCounter = 7;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_RESP_STUFF && frameCounter == 16)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mData2 = 16;
+            frame.mType = FRAME_CMD52_STUFF;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_RESP_FLAGS;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd52State == CMD52_RESP_FLAGS && frameCounter == 8)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mData2 = 16;
+            frame.mType = FRAME_CMD52_FLAGS;
+            AddFieldFrame(frame);
+
+            cmd52State = CMD52_DATA;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+    }
+    else if (frameState == CMD53_ARGUMENT)
+    {
+        temp = temp << 1 | mCmd->GetBitState();
+
+        frameCounter--;
+        if (cmd53State == CMD53_RWFLAG)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = mCmd->GetBitState();
+            frame.mType = FRAME_CMD52_RWFLAG;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_FN;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_FN && frameCounter == 28)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD52_FN;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_BLOCK;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+          }
+        else if (cmd53State == CMD53_BLOCK)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = mCmd->GetBitState();
+            frame.mType = FRAME_CMD53_BLOCK;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_OP;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_OP)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = mCmd->GetBitState();
+            frame.mType = FRAME_CMD53_OP;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_ADDR;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_ADDR && frameCounter == 9)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD52_ADDR;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_COUNT;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_COUNT && frameCounter == 0)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mType = FRAME_CMD53_COUNT;
+            AddFieldFrame(frame);
+
+            frameState = CRC7;
+            frameCounter = 7;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_RESP_STUFF && frameCounter == 16)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mData2 = 16;
+            frame.mType = FRAME_CMD52_STUFF;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_RESP_FLAGS;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_RESP_FLAGS && frameCounter == 8)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mData2 = 16;
+            frame.mType = FRAME_CMD52_FLAGS;
+            AddFieldFrame(frame);
+
+            cmd53State = CMD53_RESP_STUFF2;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+        else if (cmd53State == CMD53_RESP_STUFF2 && frameCounter == 0)
+          {
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp;
+            frame.mData2 = 16;
+            frame.mType = FRAME_CMD52_STUFF;
+            AddFieldFrame(frame);
+
+            frameState = CRC7;
+            frameCounter = 7;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+          }
+    }
+    else if (frameState == CRC7)
+    {
+        temp = temp << 1 | mCmd->GetBitState();
+
+        frameCounter--;
+        if (frameCounter == 0){
+            SDIOFrame frame;
+            frame.mStartingSampleInclusive = startOfNextFrame;
+            frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+            frame.mFlags = 0;
+            frame.mData1 = temp; // Select the first 6 bits
+            frame.mType = FRAME_CRC;
+            AddFieldFrame(frame);
+            SDIO_COUNT(crc7Packets);
+
+            frameState = STOP;
+            startOfNextFrame = frame.mEndingSampleInclusive + 1;
+            temp = 0;
+        }
+    }
+    else if (frameState == STOP)
+    {
+        if (isCmd && irqAtPacketStart && irqAsserted && !longPacket){
+            ServiceInterrupt();
+        }
+        SDIOResponseTiming::Violation violation;
+        if (mTiming.AddPacket(isCmd, longPacket, packetBits, startOfPacket, mClock->GetSampleNumber(),
+                              startClock, TimingClock(), violation)){
+            AddTimingViolation(violation);
+        }
+        packetInScope = !scoped || PacketInScope();
+        if (packetInScope){
+            if (overviewMode){
+                AddPacketFrame();
+            }else{
+                SDIOFrame frame;
+                GetPacketFrame(frame);
+                mSink->AddPacketSummary(frame);
+            }
+            if (mOptions.mCollapsePolls){
+                packetInScope = CollapsePoll();
+            }
+            if (packetInScope && holdFields){
+                FlushPendingFields();
+            }
+        }else{
+            SDIO_COUNT(skippedPackets);
+        }
+        pendingFrameCount = 0;
+        pendingMarkerCount = 0;
+        holdFields = false;
+        //Out of scope packets still matter for the transfers that follow
+        TrackTransfers();
+        mTimeline.AddPacket(isCmd, longPacket, packetBits, startOfPacket, mClock->GetSampleNumber());
+        mRegisters.AddPacket(isCmd, longPacket, packetBits, startOfPacket, mClock->GetSampleNumber());
+        SDIO_COUNT(packets);
+        frameState = TRANSMISSION_BIT;
+        return 1;
+    }
+    return 0;
+}
+
+//In full mode every field of the packet gets its own frame
+void SDIODecoder::AddFieldFrame(SDIOFrame &frame)
+{
+    if (overviewMode){
+        return;
+    }
+    if (holdFields){
+        if (pendingFrameCount < MAX_PACKET_FIELDS){
+            pendingFrames[pendingFrameCount++] = frame;
+        }
+    }else{
+        AddResultFrame(frame);
+    }
+}
+
+//Marks every rising clock edge of a packet in full mode
+void SDIODecoder::AddClockMarker()
+{
+    if (overviewMode){
+        return;
+    }
+    if (holdFields){
+        if (pendingMarkerCount < sizeof(pendingMarkers) / sizeof(pendingMarkers[0])){
+            pendingMarkers[pendingMarkerCount++] = mClock->GetSampleNumber();
+        }
+    }else{
+        mSink->AddMarker(mClock->GetSampleNumber());
+        SDIO_COUNT(markersAdded);
+    }
+}
+
+void SDIODecoder::FlushPendingFields()
+{
+    for (U32 i = 0; i < pendingMarkerCount; i++){
+        mSink->AddMarker(pendingMarkers[i]);
+        SDIO_COUNT(markersAdded);
+    }
+    for (U32 i = 0; i < pendingFrameCount; i++){
+        AddResultFrame(pendingFrames[i]);
+    }
+}
+
+//Host commands are checked against the command and function filters,
+//responses follow the command they answer.  Both have to start within the
+//sample range.
+bool SDIODecoder::PacketInScope()
+{
+    if (isCmd && !longPacket){
+        U32 index = U32(packetBits >> 40) & 0x3F;
+        commandInScope = ((mOptions.mCommandMask >> index) & 1) != 0;
+        if (commandInScope && (index == 52 || index == 53) &&
+            mOptions.mFunctionFilter != SDIODecodeOptions::FUNCTION_ALL){
+            commandInScope = (U32(packetBits >> 36) & 0x7) == mOptions.mFunctionFilter;
+        }
+    }
+    return commandInScope && startOfPacket >= mOptions.mStartSample &&
+           startOfPacket <= mOptions.mEndSample;
+}
+
+//Decides at the end of a packet whether it is stored, false if it is part of
+//a run of polls.  Only CMD52 pairs with the same argument in the command and
+//in the response repeat the pair before them, any other packet ends the run.
+bool SDIODecoder::CollapsePoll()
+{
+    U32 index = U32(packetBits >> 40) & 0x3F;
+    U32 argument = U32(packetBits >> 8);
+    bool cmd52 = index == 52 && !longPacket;
+
+    if (cmd52 && isCmd){
+        if (pollHeld){
+            //The command before went unanswered
+            EndRun();
+        }
+        if (pollActive && argument == pollCommand){
+            HoldPoll();
+            return false;
+        }
+        EndRun();
+        pollCommand = argument;
+        pollStart = startOfPacket;
+        pollAwaiting = true;
+        return true;
+    }
+
+    if (cmd52 && pollHeld && argument == pollResponse){
+        U64 interval = heldStart - pollStart;
+        if (pollCount == 0){
+            runStart = heldStart;
+            minInterval = interval;
+            maxInterval = interval;
+        }
+        minInterval = interval < minInterval ? interval : minInterval;
+        maxInterval = interval > maxInterval ? interval : maxInterval;
+        pollStart = heldStart;
+        runEnd = mClock->GetSampleOfNextEdge() - 1;
+        pollCount++;
+        pollHeld = false;
+        SDIO_COUNT(collapsedPolls);
+        return false;
+    }
+
+    //The response changed, its command starts the next run
+    bool awaiting = pollAwaiting || pollHeld;
+    U64 start = pollHeld ? heldStart : pollStart;
+    EndRun();
+    if (cmd52 && awaiting){
+        pollResponse = argument;
+        pollStart = start;
+        pollActive = true;
+    }
+    return true;
+}
+
+//Keeps the command of what may be another poll of the run until its response
+void SDIODecoder::HoldPoll()
+{
+    heldStart = startOfPacket;
+    heldFrameCount = pendingFrameCount;
+    heldMarkerCount = pendingMarkerCount < 48 ? pendingMarkerCount : 48;
+    for (U32 i = 0; i < heldFrameCount; i++){
+        heldFrames[i] = pendingFrames[i];
+    }
+    for (U32 i = 0; i < heldMarkerCount; i++){
+        heldMarkers[i] = pendingMarkers[i];
+    }
+    pollHeld = true;
+}
+
+//Adds the counted frame of the run and a command still held, each in their
+//own packet
+void SDIODecoder::EndRun()
+{
+    if (pollCount != 0){
+        SDIOFrame frame;
+        frame.mStartingSampleInclusive = runStart;
+        frame.mEndingSampleInclusive = runEnd;
+        frame.mType = FRAME_REPEAT;
+        frame.mFlags = 0;
+        frame.mData1 = pollCount;
+        frame.mData2 = (minInterval > 0xFFFFFFFF ? 0xFFFFFFFF : minInterval) |
+                       (maxInterval > 0xFFFFFFFF ? 0xFFFFFFFF : maxInterval) << 32;
+        AddResultFrame(frame);
+        mSink->CommitPacket();
+        SDIO_COUNT(packetCommits);
+    }
+    if (pollHeld){
+        for (U32 i = 0; i < heldMarkerCount; i++){
+            mSink->AddMarker(heldMarkers[i]);
+            SDIO_COUNT(markersAdded);
+        }
+        for (U32 i = 0; i < heldFrameCount; i++){
+            AddResultFrame(heldFrames[i]);
+        }
+        mSink->CommitPacket();
+        SDIO_COUNT(packetCommits);
+    }
+    pollCount = 0;
+    pollHeld = false;
+    pollActive = false;
+    pollAwaiting = false;
+}
+
+//In overview mode the whole packet is stored as a single frame holding its
+//raw bits, SDIOAnalyzerResults expands it into the field frames on demand
+void SDIODecoder::AddPacketFrame()
+{
+    SDIOFrame frame;
+    GetPacketFrame(frame);
+    if (holdFields){
+        pendingFrames[pendingFrameCount++] = frame;
+    }else{
+        AddResultFrame(frame);
+    }
+}
+
+void SDIODecoder::GetPacketFrame(SDIOFrame &frame)
+{
+    frame.mStartingSampleInclusive = startOfPacket;
+    frame.mEndingSampleInclusive = mClock->GetSampleOfNextEdge() - 1;
+    frame.mType = FRAME_PACKET;
+    if (longPacket){
+        frame.mFlags = PACKET_FLAG_LONG;
+        frame.mData1 = temp2;
+        frame.mData2 = longArgLow;
+    }else{
+        frame.mFlags = 0;
+        frame.mData1 = packetBits;
+        frame.mData2 = 0;
+    }
+}
+
+void SDIODecoder::AddResultFrame(SDIOFrame &frame)
+{
+    mSink->AddFrame(frame);
+    lastFrameEnd = frame.mEndingSampleInclusive;
+    SDIO_COUNT(framesAdded);
+}
@@ -0,0 +1,447 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_DECODER
+#define SDIO_DECODER
+
+#include <LogicPublicTypes.h>
+#include <string>
+#include <vector>
+#include "SDIOPayloadExtractor.h"
+#include "SDIODecodeCounters.h"
+#include "SDIOEnumerationTimeline.h"
+#include "SDIOResponseTiming.h"
+#include "SDIORegisterHeatmap.h"
+
+// A line the decoder reads.  Same cursor as AnalyzerChannelData, so the plugin
+// and the offline tools can drive the decoder through SDIOChannelAdapter.
+class SDIOChannel
+{
+public:
+    virtual ~SDIOChannel() {}
+
+    virtual U64 GetSampleNumber() = 0;
+    virtual BitState GetBitState() = 0;
+    virtual void AdvanceToNextEdge() = 0;
+    virtual void AdvanceToAbsPosition(U64 sample) = 0;
+    virtual U64 GetSampleOfNextEdge() = 0;
+    virtual bool WouldAdvancingToAbsPositionCauseTransition(U64 sample) = 0;
+    virtual bool DoMoreTransitionsExistInCurrentData() = 0;
+
+    // Rising edges up to the current position, for a clock that keeps count
+    // of the edges it skips.  The decoder counts those it passes otherwise.
+    virtual bool GetRisingEdgeCount(U64 & /*count*/) { return false; }
+};
+
+template <class T> class SDIOChannelAdapter : public SDIOChannel
+{
+public:
+    SDIOChannelAdapter() : mData(nullptr) {}
+
+    void SetChannel(T* data) { mData = data; }
+    SDIOChannel* Get() { return mData ? this : nullptr; }
+
+    virtual U64 GetSampleNumber() { return mData->GetSampleNumber(); }
+    virtual BitState GetBitState() { return mData->GetBitState(); }
+    virtual void AdvanceToNextEdge() { mData->AdvanceToNextEdge(); }
+    virtual void AdvanceToAbsPosition(U64 sample) { mData->AdvanceToAbsPosition(sample); }
+    virtual U64 GetSampleOfNextEdge() { return mData->GetSampleOfNextEdge(); }
+    virtual bool WouldAdvancingToAbsPositionCauseTransition(U64 sample) { return mData->WouldAdvancingToAbsPositionCauseTransition(sample); }
+    virtual bool DoMoreTransitionsExistInCurrentData() { return mData->DoMoreTransitionsExistInCurrentData(); }
+
+protected:
+    T* mData;
+};
+
+// Passes a line on and hashes the samples of the edges it moves over, seeks
+// included, so a checkpoint can tell whether the line before it is the same
+class SDIOHashedChannel : public SDIOChannel
+{
+public:
+    SDIOHashedChannel() : mChannel(nullptr), mHash(0) {}
+
+    void SetChannel(SDIOChannel* channel) { mChannel = channel; mHash = 0; }
+    U64 GetHash() const { return mHash; }
+
+    virtual U64 GetSampleNumber() { return mChannel->GetSampleNumber(); }
+    virtual BitState GetBitState() { return mChannel->GetBitState(); }
+    virtual void AdvanceToNextEdge()
+    {
+        mChannel->AdvanceToNextEdge();
+        mHash = (mHash ^ mChannel->GetSampleNumber()) * 1099511628211ULL;
+    }
+    virtual void AdvanceToAbsPosition(U64 sample)
+    {
+        while (mChannel->WouldAdvancingToAbsPositionCauseTransition(sample))
+            AdvanceToNextEdge();
+        mChannel->AdvanceToAbsPosition(sample);
+    }
+    virtual U64 GetSampleOfNextEdge() { return mChannel->GetSampleOfNextEdge(); }
+    virtual bool WouldAdvancingToAbsPositionCauseTransition(U64 sample) { return mChannel->WouldAdvancingToAbsPositionCauseTransition(sample); }
+    virtual bool DoMoreTransitionsExistInCurrentData() { return mChannel->DoMoreTransitionsExistInCurrentData(); }
+
+protected:
+    SDIOChannel* mChannel;
+    U64 mHash;
+};
+
+// The fields of the SDK Frame the decoder fills in
+struct SDIOFrame
+{
+    U64 mStartingSampleInclusive;
+    U64 mEndingSampleInclusive;
+    U64 mData1;
+    U64 mData2;
+    U8 mType;
+    U8 mFlags;
+};
+
+struct SDIODecoderCheckpoint;
+
+// Where the decoded frames go: the analyzer results in the plugin, a text or
+// JSON writer in sdio-decode.  Markers are the rising clock edges of a packet.
+class SDIOFrameSink
+{
+public:
+    virtual ~SDIOFrameSink() {}
+
+    virtual void AddFrame(const SDIOFrame &frame) = 0;
+    virtual void AddMarker(U64 sample) = 0;
+    virtual void CommitPacket() = 0;
+    virtual void CommitResults() = 0;
+
+    // Span of a data block on the DAT lines, from its start bit to its end bit
+    // or to the end of the busy signal after it.  Only the diff tool uses it.
+    virtual void AddDataBlock(U64 /*start*/, U64 /*end*/) {}
+
+    // Every packet committed so far ends before the checkpoint.  Only the
+    // decode cache uses it.
+    virtual void AddCheckpoint(const SDIODecoderCheckpoint &/*checkpoint*/) {}
+
+    // A packet in scope as the one FRAME_PACKET frame of overview mode, given
+    // in full mode before its field frames are committed.  Only the decoder of
+    // several buses uses it.
+    virtual void AddPacketSummary(const SDIOFrame &/*frame*/) {}
+};
+
+// What to decode, taken from SDIOAnalyzerSettings or the command line
+struct SDIODecodeOptions
+{
+    SDIODecodeOptions();
+
+    enum {FUNCTION_ALL = 8};
+
+    bool mOverview;
+    bool mCollapsePolls;
+    std::string mPayloadDirectory;
+    U64 mCommandMask;
+    U32 mFunctionFilter;
+    U64 mStartSample;
+    U64 mEndSample;
+    // Packets between decoder checkpoints, 0 for none
+    U32 mCheckpointInterval;
+    // Add FRAME_TIMING frames for response timeouts and gaps out of bounds
+    bool mCheckTiming;
+
+    bool IsScoped() const;
+
+    static bool ParseCommandFilter( const char* filter, U64& mask );
+    static bool ParseSampleRange( const char* range, U64& start, U64& end );
+};
+
+// Decoder state at the end of a response with no data transfer, busy signal
+// or run of polls in progress.  That is all the decoder needs to carry on from
+// mSample as if the capture had been decoded from its start.  Plain data, it
+// can be written to a file as is.
+struct SDIODecoderCheckpoint
+{
+    U64 mSample;
+    // Command line edges before and after, and a hash of all the edges up to
+    // the next, tell whether a checkpoint is of this capture
+    U64 mFirstCmdEdge;
+    U64 mNextCmdEdge;
+    U64 mCmdHash;
+    U64 mPackets;
+    U64 mLastFrameEnd;
+    U64 mIrqStart;
+    U64 mPollStart;
+    U64 mClockCount;
+    U32 mPollCommand;
+    U32 mPollResponse;
+    U32 mBlockSize[8];
+    U8 mApp;
+    U8 mBusWidth;
+    U8 mDat1State;
+    U8 mIrqAsserted;
+    U8 mPollActive;
+    SDIOEnumerationTimeline mTimeline;
+    SDIOResponseTiming mTiming;
+};
+
+// Turns the clock, command and data lines into frames.  Step() handles either
+// a seek to the next edge that matters or a single clock edge, the caller
+// decides when to stop.  DAT1-DAT3 may be left out for a 1 bit bus, DAT4-DAT7
+// are only there for an 8 bit bus.
+class SDIODecoder
+{
+public:
+    SDIODecoder();
+
+    void Start(SDIOChannel* clock, SDIOChannel* cmd, SDIOChannel* dat0, SDIOChannel* dat1,
+               SDIOChannel* dat2, SDIOChannel* dat3, SDIOFrameSink* sink, const SDIODecodeOptions &options);
+    // DAT4-DAT7 of an 8 bit bus, set before Start()
+    void SetUpperDataLines(SDIOChannel* dat4, SDIOChannel* dat5, SDIOChannel* dat6, SDIOChannel* dat7);
+    void Step();
+    // For a decode that does not begin at the start of the capture, before
+    // Start().  Moves the clock, command and data lines from sample to the
+    // end of the first host command with a valid CRC7, the packet after it
+    // is the first one decoded.  False if the captured data runs out first,
+    // it never waits for more.
+    static bool SeekCommand(SDIOChannel* const* lines, U32 count, U64 sample);
+    // Adds what is still held back, e.g. a run of polls, at the end of the data
+    void Finish();
+
+    // With a checkpoint interval set, taken every that many packets
+    const std::vector<SDIODecoderCheckpoint>& GetCheckpoints() const { return mCheckpoints; }
+    // Number of checkpoints up to the last one of this capture at or before
+    // sample, 0 if there is none
+    size_t FindCheckpoint(const std::vector<SDIODecoderCheckpoint> &checkpoints, U64 sample) const;
+    // Called right after Start(), carries on from checkpoints[count - 1].  If
+    // the capture turns out to differ after all false is returned.  The lines
+    // are at the checkpoint then and what came before it is lost, the decode
+    // has to start again with new lines from the start of the data.
+    bool Resume(const std::vector<SDIODecoderCheckpoint> &checkpoints, size_t count);
+
+    // Only counted when built with SDIO_INSTRUMENTATION
+    const SDIODecodeCounters& GetDecodeCounters() const { return mCounters; }
+    const SDIOEnumerationTimeline& GetEnumerationTimeline() const { return mTimeline; }
+    const SDIOResponseTiming& GetResponseTiming() const { return mTiming; }
+    const SDIORegisterHeatmap& GetRegisterHeatmap() const { return mRegisters; }
+
+    // For decoding several buses in time order.  The sample the next Step()
+    // moves the lines to at most, false if that is not in the data yet.  A
+    // run of polls held back is added then, as Step() would.
+    bool GetNextSample(U64 &sample);
+    // Frames added from now on start at or after this sample
+    U64 GetFrameBound() const;
+
+    enum frameTypes {FRAME_DIR, FRAME_CMD, FRAME_ARG, FRAME_LONG_ARG, FRAME_CRC,
+             FRAME_CMD52_RWFLAG,FRAME_CMD52_FN,FRAME_CMD52_RAW,FRAME_CMD52_STUFF,
+             FRAME_CMD52_ADDR,FRAME_CMD52_DATA,FRAME_CMD52_FLAGS,
+             FRAME_CMD53_BLOCK, FRAME_CMD53_OP, FRAME_CMD53_COUNT,
+             FRAME_PACKET, FRAME_IRQ, FRAME_BUSY, FRAME_REPEAT, FRAME_DATA_CRC,
+             FRAME_TIMING};
+
+    // FRAME_PACKET flags, mData1 holds the raw 48 bits of the packet or, for
+    // long responses, the upper 64 bits of the 127 bit argument (low half in mData2)
+    enum packetFlags {PACKET_FLAG_LONG = 0x01};
+
+    // Number of the bus a frame is from when several buses share the clock,
+    // 0 with a single bus.  Bits 6 and 7 are the SDK display flags.
+    enum {FRAME_BUS_SHIFT = 4, FRAME_BUS_MASK = 0x30};
+
+    // FRAME_IRQ and FRAME_BUSY are timed frames, each in its own packet.  mData1
+    // holds the duration in samples and mData2 the sample at which it started.
+    // The frame itself may start later so it does not overlap packet frames.
+
+    // FRAME_REPEAT stands for CMD52 command/response pairs identical to the
+    // pair before it, in a packet of its own.  mData1 holds the number of
+    // pairs, mData2 the shortest (low 32 bits) and longest (high 32 bits)
+    // sample count from one command to the next.
+
+    // FRAME_DATA_CRC marks a data block whose CRC16 did not match on some of
+    // its lines, in a packet of its own.  mData1 has bit n set for DATn.
+
+    // FRAME_TIMING covers a gap between packets, or before a write data block,
+    // that is out of the spec's bounds or after which a command went
+    // unanswered, in a packet of its own.  mData1 is the violation as
+    // SDIOResponseTiming::Pack() stores it.
+
+    // Most field frames a single packet decodes into
+    enum {MAX_PACKET_FIELDS = 12};
+
+protected:
+    SDIOChannel* mClock;
+    SDIOChannel* mCmd;
+    // The command line with its edges hashed, only used with checkpoints
+    SDIOHashedChannel mHashedCmd;
+    SDIOChannel* mDAT0;
+    SDIOChannel* mDAT1;
+    SDIOChannel* mDAT2;
+    SDIOChannel* mDAT3;
+    // DAT0-DAT7, the first busWidth of them are sampled together
+    SDIOChannel* mDataLines[8];
+    SDIOFrameSink* mSink;
+    SDIODecodeOptions mOptions;
+
+    SDIOPayloadExtractor mPayload;
+    SDIODecodeCounters mCounters;
+    SDIOEnumerationTimeline mTimeline;
+    SDIOResponseTiming mTiming;
+    SDIORegisterHeatmap mRegisters;
+    std::vector<SDIODecoderCheckpoint> mCheckpoints;
+
+private:
+    U64 lastFallingClockEdge;
+    //Rising clock edges so far, the seeks only count them for the timing
+    //checks.  The clock cycle of the start bit of the packet.
+    U64 clockCount;
+    U64 startClock;
+    U64 TimingClock();
+    U64 startOfNextFrame;
+    U64 startOfPacket;
+    bool overviewMode;
+    template <U32 LINES, U32 WIDTH> void PacketStateMachine();
+    template <U32 LINES> void AdvanceLinesTo(U64 sampleNumber);
+    void AdvanceLinesTo(U64 sampleNumber);
+    //PacketStateMachine() for the data lines connected (1, 2 for DAT0 and
+    //DAT1 only, 4 or 8) and the bus width in use
+    void SelectLoop();
+    void (SDIODecoder::*mLoop)();
+    U32 connectedLines;
+    void StartPacket(U64 sampleNumber);
+    enum packetStates {WAITING_FOR_PACKET, IN_PACKET};
+    U32 packetState;
+
+    U32 FrameStateMachine();
+    void AddFieldFrame(SDIOFrame &frame);
+    void AddClockMarker();
+    void AddPacketFrame();
+    void GetPacketFrame(SDIOFrame &frame);
+    void AddResultFrame(SDIOFrame &frame);
+    U64 lastFrameEnd;
+    enum frameStates {TRANSMISSION_BIT, COMMAND, ARGUMENT, CMD52_ARGUMENT, CMD53_ARGUMENT, CRC7, STOP};
+    U32 frameState;
+    U32 frameCounter;
+
+    enum cmd52States {CMD52_RWFLAG,CMD52_FN,CMD52_RAW,CMD52_STUFF1,CMD52_ADDR,
+              CMD52_STUFF2,CMD52_DATA,CMD52_RESP_STUFF,CMD52_RESP_FLAGS};
+    enum cmd53States {CMD53_RWFLAG,CMD53_FN,CMD53_BLOCK,CMD53_OP,CMD53_ADDR,
+              CMD53_COUNT,CMD53_RESP_STUFF,CMD53_RESP_FLAGS,CMD53_RESP_STUFF2};
+    U32 cmd52State;
+    U32 cmd53State;
+    bool cmd52writenotread;
+
+    bool app;
+    bool isCmd;
+    U8 respLength;
+    enum respTypes {RESP_NORMAL,RESP_LONG};
+    U8 respType;
+
+    U64 temp;
+    U64 temp2;
+    U64 packetBits;
+    U64 longArgLow;
+    bool longPacket;
+
+    //Decode scope, with a filter set the frames and markers of a packet are
+    //held back until its end shows whether it is in scope
+    bool PacketInScope();
+    void FlushPendingFields();
+    bool scoped;
+    bool holdFields;
+    bool packetInScope;
+    bool commandInScope;
+    U32 pendingFrameCount;
+    U32 pendingMarkerCount;
+    SDIOFrame pendingFrames[MAX_PACKET_FIELDS];
+    U64 pendingMarkers[144];
+
+    //Data phase of CMD53 transfers on the DAT lines
+    void TrackTransfers();
+    void SetRegister(U32 address, U8 value);
+    template <U32 WIDTH> void DataStateMachine();
+    void EndOfDataBlock();
+    bool DataWaitsForEdge();
+    enum dataStates {DATA_IDLE, DATA_WAIT_START, DATA_BLOCK, DATA_CRC, DATA_END,
+              DATA_WAIT_STATUS, DATA_STATUS, DATA_BUSY, DATA_BUSY_LOW};
+    U32 dataState;
+    U32 dataCounter;
+    U32 dataFunction;
+    bool dataWrite;
+    U32 blockLength;
+    U32 blocksRemaining;
+    //1, 4 or 8 data lines
+    U32 busWidth;
+    U32 MaxBusWidth() const;
+    template <U32 WIDTH> U8 GatherDataLines();
+    void UpdateDataCrc(U8 lines);
+    U32 blockSize[8];
+    U8 dataByte;
+    U32 dataBits;
+    U32 dataLength;
+    U8 dataBuffer[2048];
+    //CRC16 of every line at once, bit n of byte k is bit k of the CRC of
+    //DATn.  Bytes 0-7 are in the low word, 8-15 in the high word.
+    U64 crcLow;
+    U64 crcHigh;
+    U64 crcReceivedLow;
+    U64 crcReceivedHigh;
+    U64 dataSample;
+    U64 blockStart;
+    bool blockStarted;
+
+    bool cmd52Write;
+    U32 cmd52Function;
+    U32 cmd52Address;
+
+    //Interrupts signalled on DAT1 until the host reads the CCCR interrupt
+    //pending register, and busy signalled on DAT0
+    void CheckInterruptLine(U64 sampleNumber);
+    void ServiceInterrupt();
+    void AddTimingViolation(const SDIOResponseTiming::Violation &violation);
+    void AddTimingFrame(U8 type, U64 start, U64 end, U64 data1);
+    BitState dat1State;
+    bool irqAsserted;
+    bool irqAtPacketStart;
+    U64 irqStart;
+    U64 busyStart;
+
+    //Runs of identical CMD52 polls.  The first pair of a run is stored as
+    //usual, the command of each further pair is held until its response
+    //shows whether the run goes on.
+    bool CollapsePoll();
+    void HoldPoll();
+    void EndRun();
+    bool pollAwaiting;
+    bool pollActive;
+    bool pollHeld;
+    U32 pollCommand;
+    U32 pollResponse;
+    U64 pollStart;
+    U64 pollCount;
+    U64 runStart;
+    U64 runEnd;
+    U64 minInterval;
+    U64 maxInterval;
+    U64 heldStart;
+    U32 heldFrameCount;
+    U32 heldMarkerCount;
+    SDIOFrame heldFrames[MAX_PACKET_FIELDS];
+    U64 heldMarkers[48];
+
+    void TakeCheckpoint();
+    U64 firstCmdEdge;
+    U64 packetCount;
+    U64 nextCheckpoint;
+};
+
+#endif //SDIO_DECODER
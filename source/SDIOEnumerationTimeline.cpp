@@ -0,0 +1,210 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOEnumerationTimeline.h"
+#include "SDIOTextFormatter.h"
+#include <AnalyzerHelpers.h>
+#include <string.h>
+
+static const char* PhaseName(U32 phase)
+{
+    switch (phase)
+    {
+    case SDIOEnumerationTimeline::PHASE_RESET: return "CMD0 reset";
+    case SDIOEnumerationTimeline::PHASE_OCR: return "CMD5 operating conditions";
+    case SDIOEnumerationTimeline::PHASE_RCA: return "CMD3 relative address";
+    case SDIOEnumerationTimeline::PHASE_SELECT: return "CMD7 select";
+    case SDIOEnumerationTimeline::PHASE_BUS_WIDTH: return "CCCR bus width";
+    case SDIOEnumerationTimeline::PHASE_HIGH_SPEED: return "CCCR high speed";
+    case SDIOEnumerationTimeline::PHASE_FN_ENABLE: return "Function enable";
+    case SDIOEnumerationTimeline::PHASE_FN_READY: return "Function ready";
+    case SDIOEnumerationTimeline::PHASE_CLOCK: return "Clock switch";
+    }
+    return "";
+}
+
+SDIOEnumerationTimeline::SDIOEnumerationTimeline()
+{
+    Reset();
+}
+
+void SDIOEnumerationTimeline::Reset()
+{
+    memset(mPhases, 0, sizeof(mPhases));
+    mPendingPhase = PHASE_COUNT;
+    mEnabledFunctions = 0;
+    mInitialPeriod = 0;
+    mLastSlowEnd = 0;
+}
+
+void SDIOEnumerationTimeline::AddPacket(bool host, bool long_packet, U64 raw, U64 start, U64 end)
+{
+    if (mPhases[PHASE_CLOCK].done && mPhases[PHASE_FN_READY].done)
+        return;
+
+    //Cards start at 400 kHz or less, the host switches to the full speed clock
+    //once they are set up.  Packets are 48 or 136 clocks long.
+    U64 period = (end - start) / (long_packet ? 136 : 48);
+    if (!mPhases[PHASE_CLOCK].done)
+    {
+        if (mInitialPeriod == 0)
+        {
+            mInitialPeriod = period;
+        }
+        else if (period * 2 < mInitialPeriod)
+        {
+            mPhases[PHASE_CLOCK].seen = true;
+            mPhases[PHASE_CLOCK].done = true;
+            mPhases[PHASE_CLOCK].start = mLastSlowEnd;
+            mPhases[PHASE_CLOCK].end = start;
+        }
+        mLastSlowEnd = end;
+    }
+
+    //R2 answers CMD2, which is not part of SDIO initialisation
+    if (long_packet)
+        return;
+
+    U32 index = U32(raw >> 40) & 0x3F;
+    U32 argument = U32(raw >> 8);
+    bool write = (argument >> 31) != 0;
+    U32 function = (argument >> 28) & 0x7;
+    U32 address = (argument >> 9) & 0x1FFFF;
+
+    if (host)
+    {
+        mPendingPhase = PHASE_COUNT;
+        if (index == 0)
+        {
+            StartCommand(PHASE_RESET, start, end);
+            Complete(PHASE_RESET, end);
+        }
+        else if (index == 5)
+            StartCommand(PHASE_OCR, start, end);
+        else if (index == 3)
+            StartCommand(PHASE_RCA, start, end);
+        else if (index == 7)
+            StartCommand(PHASE_SELECT, start, end);
+        else if (index == 52 && function == 0)
+        {
+            if (write && address == 0x07)
+                StartCommand(PHASE_BUS_WIDTH, start, end);
+            else if (write && address == 0x13)
+                StartCommand(PHASE_HIGH_SPEED, start, end);
+            else if (write && address == 0x02)
+            {
+                mEnabledFunctions = argument & 0xFE;
+                StartCommand(PHASE_FN_ENABLE, start, end);
+            }
+            else if (!write && address == 0x03 && mEnabledFunctions != 0)
+                StartCommand(PHASE_FN_READY, start, end);
+        }
+        return;
+    }
+
+    if (mPendingPhase == PHASE_COUNT)
+        return;
+
+    //Responses complete the phase of their command.  R4 has its ready bit at
+    //the top of the argument and IORx has to show all enabled functions.
+    if (mPendingPhase == PHASE_OCR)
+    {
+        if (argument & 0x80000000)
+            Complete(PHASE_OCR, end);
+    }
+    else if (mPendingPhase == PHASE_FN_READY)
+    {
+        if ((argument & mEnabledFunctions) == mEnabledFunctions)
+            Complete(PHASE_FN_READY, end);
+    }
+    else
+    {
+        Complete(mPendingPhase, end);
+    }
+    mPendingPhase = PHASE_COUNT;
+}
+
+void SDIOEnumerationTimeline::StartCommand(U32 phase, U64 start, U64 end)
+{
+    Phase &p = mPhases[phase];
+    if (p.done)
+        return;
+
+    if (!p.seen)
+    {
+        p.seen = true;
+        p.start = start;
+    }
+    p.end = end;
+    p.commands++;
+    mPendingPhase = phase;
+}
+
+void SDIOEnumerationTimeline::Complete(U32 phase, U64 end)
+{
+    mPhases[phase].done = true;
+    mPhases[phase].end = end;
+}
+
+void SDIOEnumerationTimeline::Format(SDIOTextFormatter &text, U64 trigger_sample, U32 sample_rate) const
+{
+    char time_str[128];
+    bool any = false;
+    U64 first = 0;
+    U64 last = 0;
+
+    text.Append("Phase,Start [s],Duration,Commands,Retries,Completed\n");
+    for (U32 i = 0; i < PHASE_COUNT; i++)
+    {
+        const Phase &p = mPhases[i];
+        if (!p.seen)
+            continue;
+
+        if (!any || p.start < first)
+            first = p.start;
+        if (!any || p.end > last)
+            last = p.end;
+        any = true;
+
+        AnalyzerHelpers::GetTimeString(p.start, trigger_sample, sample_rate, time_str, 128);
+        text.Append(PhaseName(i));
+        text.Append(",");
+        text.Append(time_str);
+        text.Append(",");
+        text.AppendDuration(p.end - p.start, sample_rate);
+        text.Append(",");
+        text.AppendNumber(p.commands, Decimal, 32);
+        text.Append(",");
+        text.AppendNumber(p.commands > 1 ? p.commands - 1 : 0, Decimal, 32);
+        text.Append(p.done ? ",yes\n" : ",no\n");
+    }
+
+    if (any)
+    {
+        AnalyzerHelpers::GetTimeString(first, trigger_sample, sample_rate, time_str, 128);
+        text.Append("Total,");
+        text.Append(time_str);
+        text.Append(",");
+        text.AppendDuration(last - first, sample_rate);
+        text.Append(",,,\n");
+    }
+}
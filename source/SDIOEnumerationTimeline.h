@@ -0,0 +1,72 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_ENUMERATION_TIMELINE
+#define SDIO_ENUMERATION_TIMELINE
+
+#include <LogicPublicTypes.h>
+
+class SDIOTextFormatter;
+
+// Follows the card initialisation sequence and times each of its phases, from
+// CMD0 to the functions being ready and the switch to the full speed clock.
+// Only the first enumeration of a capture is recorded.
+class SDIOEnumerationTimeline
+{
+public:
+    SDIOEnumerationTimeline();
+
+    void Reset();
+
+    // Every decoded packet, raw holds its 48 bits unless it is a long response
+    void AddPacket(bool host, bool long_packet, U64 raw, U64 start, U64 end);
+
+    // CSV with one line per phase seen and the total from the first to the last
+    void Format(SDIOTextFormatter &text, U64 trigger_sample, U32 sample_rate) const;
+
+    enum phases {PHASE_RESET, PHASE_OCR, PHASE_RCA, PHASE_SELECT, PHASE_BUS_WIDTH,
+                 PHASE_HIGH_SPEED, PHASE_FN_ENABLE, PHASE_FN_READY, PHASE_CLOCK,
+                 PHASE_COUNT};
+
+    struct Phase
+    {
+        bool seen;
+        bool done;
+        U64 start;
+        U64 end;
+        U32 commands;
+    };
+
+    const Phase& GetPhase(U32 phase) const { return mPhases[phase]; }
+
+protected:
+    void StartCommand(U32 phase, U64 start, U64 end);
+    void Complete(U32 phase, U64 end);
+
+    Phase mPhases[PHASE_COUNT];
+    U32 mPendingPhase;
+    U32 mEnabledFunctions;
+    U64 mInitialPeriod;
+    U64 mLastSlowEnd;
+};
+
+#endif //SDIO_ENUMERATION_TIMELINE
@@ -0,0 +1,142 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIOLiveExport.h"
+#include "SDIOAnalyzerResults.h"
+#include "SDIOTextFormatter.h"
+#include <chrono>
+
+SDIOLiveExport::SDIOLiveExport()
+:    mFile(nullptr),
+    mTriggerSample(0),
+    mSampleRate(1),
+    mDroppedFrames(0),
+    mHead(0),
+    mTail(0),
+    mClosing(false)
+{
+    mPending.mCount = 0;
+    mPending.mDropped = 0;
+}
+
+SDIOLiveExport::~SDIOLiveExport()
+{
+    Close();
+}
+
+bool SDIOLiveExport::Open(const char* file_name, U64 trigger_sample, U32 sample_rate)
+{
+    Close();
+    mFile = fopen(file_name, "wb");
+    if (mFile == nullptr){
+        return false;
+    }
+    fputs("Time [s],Value", mFile);
+
+    mTriggerSample = trigger_sample;
+    mSampleRate = sample_rate;
+    mQueue.resize(QUEUE_SIZE);
+    mPending.mCount = 0;
+    mPending.mDropped = 0;
+    mDroppedFrames = 0;
+    mHead = 0;
+    mTail = 0;
+    mClosing = false;
+    mWriter = std::thread(&SDIOLiveExport::WriterThread, this);
+    return true;
+}
+
+void SDIOLiveExport::Close()
+{
+    if (mFile == nullptr){
+        return;
+    }
+    mClosing = true;
+    mWriter.join();
+    fputs("\n", mFile);
+    fclose(mFile);
+    mFile = nullptr;
+}
+
+void SDIOLiveExport::AddFrame(const Frame &frame)
+{
+    if (mPending.mCount < PACKET_FRAMES){
+        SDIOAnalyzerResults::CopyFrame(frame, mPending.mFrames[mPending.mCount++]);
+    }else{
+        mPending.mDropped++;
+        mDroppedFrames++;
+    }
+}
+
+void SDIOLiveExport::CommitPacket()
+{
+    if (mPending.mCount == 0){
+        return;
+    }
+    U64 head = mHead.load(std::memory_order_relaxed);
+    while (head - mTail.load(std::memory_order_acquire) == QUEUE_SIZE){
+        std::this_thread::yield();
+    }
+    Packet &packet = mQueue[head % QUEUE_SIZE];
+    for (U32 i = 0; i < mPending.mCount; i++){
+        SDIOAnalyzerResults::CopyFrame(mPending.mFrames[i], packet.mFrames[i]);
+    }
+    packet.mCount = mPending.mCount;
+    packet.mDropped = mPending.mDropped;
+    mHead.store(head + 1, std::memory_order_release);
+    mPending.mCount = 0;
+    mPending.mDropped = 0;
+}
+
+//Drains the ring and flushes the file whenever it runs empty, so the file is
+//up to date while the decode waits for more data
+void SDIOLiveExport::WriterThread()
+{
+    for ( ; ; ){
+        bool closing = mClosing.load(std::memory_order_acquire);
+        U64 tail = mTail.load(std::memory_order_relaxed);
+        U64 head = mHead.load(std::memory_order_acquire);
+        if (tail == head){
+            fflush(mFile);
+            if (closing){
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        for ( ; tail != head; tail++){
+            WritePacket(mQueue[tail % QUEUE_SIZE]);
+            mTail.store(tail + 1, std::memory_order_release);
+        }
+    }
+}
+
+void SDIOLiveExport::WritePacket(const Packet &packet)
+{
+    SDIOTextFormatter text;
+    SDIOAnalyzerResults::AppendExportLine(packet.mFrames, packet.mCount, Hexadecimal, mTriggerSample, mSampleRate, text);
+    if (packet.mDropped != 0){
+        text.Append("Frames not written: ");
+        text.AppendNumber(packet.mDropped, Decimal, 32);
+        text.Append(" | ");
+    }
+    fwrite(text.GetText(), 1, text.GetLength(), mFile);
+}
@@ -0,0 +1,90 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_LIVE_EXPORT
+#define SDIO_LIVE_EXPORT
+
+#include <AnalyzerResults.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#include "SDIODecoder.h"
+
+// Writes the text export while the decode runs instead of walking the results
+// afterwards.  The decode thread copies the frames of each committed packet
+// into a bounded single producer/single consumer ring, a writer thread
+// formats and writes them.  The decode thread only waits when the writer is a
+// whole ring behind.
+//
+// The lines are those of the text export in hexadecimal, without the packet
+// count line since the number of packets is not known while decoding.
+class SDIOLiveExport
+{
+public:
+    SDIOLiveExport();
+    ~SDIOLiveExport();
+
+    bool Open(const char* file_name, U64 trigger_sample, U32 sample_rate);
+    // Waits for the writer to write everything that was committed
+    void Close();
+    bool IsOpen() const { return mFile != nullptr; }
+
+    // Called by the decode thread only
+    void AddFrame(const Frame &frame);
+    void CommitPacket();
+
+    // Frames left out of packets with more than PACKET_FRAMES, since Open()
+    U64 GetDroppedFrames() const { return mDroppedFrames; }
+
+    enum {QUEUE_SIZE = 1024};
+
+protected:
+    // Room for the fields of a packet.  Frames past it are counted and the
+    // line says how many are missing.
+    enum {PACKET_FRAMES = SDIODecoder::MAX_PACKET_FIELDS};
+    struct Packet
+    {
+        U32 mCount;
+        U32 mDropped;
+        Frame mFrames[PACKET_FRAMES];
+    };
+
+    void WriterThread();
+    void WritePacket(const Packet &packet);
+
+    FILE* mFile;
+    U64 mTriggerSample;
+    U32 mSampleRate;
+
+    std::vector<Packet> mQueue;
+    Packet mPending;
+    U64 mDroppedFrames;
+    // Packets pushed by the decode thread and popped by the writer, each only
+    // written by one side.  Kept apart so they do not share a cache line.
+    std::atomic<U64> mHead;
+    char mPadding[64];
+    std::atomic<U64> mTail;
+    std::atomic<bool> mClosing;
+    std::thread mWriter;
+};
+
+#endif //SDIO_LIVE_EXPORT
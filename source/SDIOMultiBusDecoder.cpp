@@ -0,0 +1,409 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOMultiBusDecoder.h"
+
+SDIOClockView::SDIOClockView()
+:    mClock(nullptr),
+    mIndex(0),
+    mSample(0),
+    mState(BIT_LOW)
+{
+}
+
+void SDIOClockView::Start(SDIOSharedClock* clock)
+{
+    mClock = clock;
+    mIndex = clock->GetFirst();
+    mSample = clock->GetEdge(mIndex).mSample;
+    mState = clock->GetEdge(mIndex).mState;
+}
+
+//A bus waiting for a packet may be behind the edges still kept, it moves
+//past them before it looks at the clock again
+void SDIOClockView::SkipReleased()
+{
+    if (mIndex < mClock->GetFirst()){
+        mIndex = mClock->GetFirst();
+    }
+}
+
+void SDIOClockView::AdvanceToNextEdge()
+{
+    SkipReleased();
+    if (mIndex + 1 == mClock->GetEnd()){
+        mClock->Pull();
+    }
+    mIndex++;
+    mSample = mClock->GetEdge(mIndex).mSample;
+    mState = mClock->GetEdge(mIndex).mState;
+}
+
+void SDIOClockView::AdvanceToAbsPosition(U64 sample)
+{
+    mClock->Reach(sample);
+    SkipReleased();
+    while (mIndex + 1 < mClock->GetEnd() && mClock->GetEdge(mIndex + 1).mSample <= sample){
+        mIndex++;
+    }
+    mSample = sample;
+    mState = mClock->GetEdge(mIndex).mState;
+}
+
+U64 SDIOClockView::GetSampleOfNextEdge()
+{
+    SkipReleased();
+    if (mIndex + 1 == mClock->GetEnd()){
+        mClock->Pull();
+    }
+    return mClock->GetEdge(mIndex + 1).mSample;
+}
+
+bool SDIOClockView::WouldAdvancingToAbsPositionCauseTransition(U64 sample)
+{
+    SkipReleased();
+    if (mIndex + 1 < mClock->GetEnd()){
+        return mClock->GetEdge(mIndex + 1).mSample <= sample;
+    }
+    return mClock->mChannel->WouldAdvancingToAbsPositionCauseTransition(sample);
+}
+
+bool SDIOClockView::DoMoreTransitionsExistInCurrentData()
+{
+    SkipReleased();
+    return mIndex + 1 < mClock->GetEnd() || mClock->mChannel->DoMoreTransitionsExistInCurrentData();
+}
+
+//The edges a bus skips were released by the others, the buffer still knows
+//how many there were
+bool SDIOClockView::GetRisingEdgeCount(U64 &count)
+{
+    SkipReleased();
+    count = mClock->GetEdge(mIndex).mRising;
+    return true;
+}
+
+SDIOSharedClock::SDIOSharedClock()
+:    mChannel(nullptr),
+    mFirst(0),
+    mFloor(0),
+    mRising(0),
+    mCountEdges(false)
+{
+}
+
+void SDIOSharedClock::Start(SDIOChannel* clock, bool count_edges)
+{
+    mChannel = clock;
+    mEdges.clear();
+    mFirst = 0;
+    mFloor = 0;
+    mRising = 0;
+    mCountEdges = count_edges;
+    Reset();
+}
+
+void SDIOSharedClock::Release(U64 floor)
+{
+    mFloor = floor;
+    while (mEdges.size() > 1 && mEdges[1].mSample <= floor){
+        mEdges.pop_front();
+        mFirst++;
+    }
+}
+
+void SDIOSharedClock::Wait()
+{
+    mChannel->AdvanceToNextEdge();
+    if (mChannel->GetBitState() == BIT_HIGH){
+        mRising++;
+    }
+    Reset();
+}
+
+void SDIOSharedClock::Pull()
+{
+    mChannel->AdvanceToNextEdge();
+    if (mChannel->GetBitState() == BIT_HIGH){
+        mRising++;
+    }
+    Edge edge = {mChannel->GetSampleNumber(), mChannel->GetBitState(), mRising};
+    mEdges.push_back(edge);
+}
+
+void SDIOSharedClock::Reach(U64 sample)
+{
+    if (sample <= mChannel->GetSampleNumber()){
+        return;
+    }
+    //No bus looks at the edges before the floor, go straight there or only
+    //count them on the way
+    if (sample <= mFloor){
+        while (mCountEdges && mChannel->WouldAdvancingToAbsPositionCauseTransition(sample)){
+            mChannel->AdvanceToNextEdge();
+            if (mChannel->GetBitState() == BIT_HIGH){
+                mRising++;
+            }
+        }
+        mChannel->AdvanceToAbsPosition(sample);
+        Reset();
+        return;
+    }
+    while (mChannel->WouldAdvancingToAbsPositionCauseTransition(sample)){
+        Pull();
+    }
+}
+
+//The buffer starts over at where the channel is
+void SDIOSharedClock::Reset()
+{
+    mFirst += mEdges.size();
+    mEdges.clear();
+    Edge edge = {mChannel->GetSampleNumber(), mChannel->GetBitState(), mRising};
+    mEdges.push_back(edge);
+}
+
+void SDIOMultiBusDecoder::BusSink::AddFrame(const SDIOFrame &frame)
+{
+    if (mPending.mFrames.empty() && mPending.mMarkers.empty()){
+        mPending.mStart = frame.mStartingSampleInclusive;
+    }
+    mPending.mEnd = frame.mEndingSampleInclusive;
+    mPending.mFrames.push_back(frame);
+    mPending.mFrames.back().mFlags = (frame.mFlags & ~SDIODecoder::FRAME_BUS_MASK) | mTag;
+}
+
+void SDIOMultiBusDecoder::BusSink::AddMarker(U64 sample)
+{
+    if (mPending.mFrames.empty() && mPending.mMarkers.empty()){
+        mPending.mStart = sample;
+    }
+    if (mPending.mFrames.empty()){
+        mPending.mEnd = sample;
+    }
+    mPending.mMarkers.push_back(sample);
+}
+
+void SDIOMultiBusDecoder::BusSink::AddPacketSummary(const SDIOFrame &frame)
+{
+    mSummaries.push_back(frame);
+    mSummaries.back().mFlags = (frame.mFlags & ~SDIODecoder::FRAME_BUS_MASK) | mTag;
+}
+
+void SDIOMultiBusDecoder::BusSink::CommitPacket()
+{
+    if (mPending.mFrames.empty() && mPending.mMarkers.empty()){
+        return;
+    }
+    //Markers come before the first frame, the frame says where it starts
+    mPending.mHasSummary = false;
+    if (!mPending.mFrames.empty()){
+        mPending.mStart = mPending.mFrames[0].mStartingSampleInclusive;
+        //Field frames come before FRAME_PACKET.  Packets of commands go out in
+        //order, the summaries that end before this one are of polls collapsed
+        //into a run.  The start bit is not a field, the summary starts with it.
+        if (mPending.mFrames[0].mType < SDIODecoder::FRAME_PACKET){
+            while (!mSummaries.empty() && mSummaries.front().mEndingSampleInclusive < mPending.mStart){
+                mSummaries.pop_front();
+            }
+            if (!mSummaries.empty() && mSummaries.front().mStartingSampleInclusive <= mPending.mStart){
+                mPending.mHasSummary = true;
+                mPending.mSummary = mSummaries.front();
+                mPending.mSummary.mStartingSampleInclusive = mPending.mStart;
+                mSummaries.pop_front();
+            }
+        }
+    }
+    mPackets.push_back(mPending);
+    mPending.mFrames.clear();
+    mPending.mMarkers.clear();
+}
+
+SDIOMultiBusDecoder::SDIOMultiBusDecoder()
+:    mFramesOut(false),
+    mLastEnd(0),
+    mBusCount(0),
+    mSink(nullptr)
+{
+}
+
+void SDIOMultiBusDecoder::Start(SDIOChannel* clock, SDIOChannel* const* lines, U32 bus_count, SDIOFrameSink* sink,
+                                const SDIODecodeOptions &options)
+{
+    mBusCount = bus_count < U32(MAX_BUSES) ? bus_count : U32(MAX_BUSES);
+    mSink = sink;
+    mFramesOut = false;
+    mClock.Start(clock, options.mCheckTiming);
+
+    for (U32 bus = 0; bus < mBusCount; bus++){
+        Bus &state = mBuses[bus];
+        SDIODecodeOptions bus_options = options;
+        bus_options.mCheckpointInterval = 0;
+        if (bus != 0){
+            bus_options.mPayloadDirectory.clear();
+        }
+        state.mClock.Start(&mClock);
+        state.mSink.mTag = U8((bus + 1) << SDIODecoder::FRAME_BUS_SHIFT);
+        state.mSink.mPending.mFrames.clear();
+        state.mSink.mPending.mMarkers.clear();
+        state.mSink.mPackets.clear();
+        state.mSink.mSummaries.clear();
+        state.mIdle = false;
+
+        SDIOChannel* const* bus_lines = lines + bus * LINE_COUNT;
+        state.mDecoder.Start(&state.mClock, bus_lines[LINE_CMD], bus_lines[LINE_DAT0], bus_lines[LINE_DAT1],
+                             bus_lines[LINE_DAT2], bus_lines[LINE_DAT3], &state.mSink, bus_options);
+    }
+}
+
+void SDIOMultiBusDecoder::Step()
+{
+    U32 next = mBusCount;
+    U64 nextSample = ~U64(0);
+    for (U32 bus = 0; bus < mBusCount; bus++){
+        U64 sample;
+        mBuses[bus].mIdle = !mBuses[bus].mDecoder.GetNextSample(sample);
+        if (!mBuses[bus].mIdle && sample < nextSample){
+            next = bus;
+            nextSample = sample;
+        }
+    }
+
+    if (next == mBusCount){
+        Release(false);
+        mSink->CommitResults();
+        mClock.Wait();
+        return;
+    }
+
+    //The other buses are at or after nextSample
+    mClock.Release(nextSample);
+    mBuses[next].mDecoder.Step();
+    Release(false);
+    mSink->CommitResults();
+}
+
+void SDIOMultiBusDecoder::Finish()
+{
+    for (U32 bus = 0; bus < mBusCount; bus++){
+        mBuses[bus].mDecoder.Finish();
+    }
+    Release(true);
+    mSink->CommitResults();
+}
+
+//The earliest packet goes out once every other bus either has a packet
+//queued or is past the end of it, so it is known which packet of another bus
+//it runs into, if any.  A bus with nothing to decode does not hold the others
+//up, should it still add a timed frame from before, e.g. an interrupt that is
+//still asserted, that one is late.
+void SDIOMultiBusDecoder::Release(bool all)
+{
+    for ( ; ; ){
+        U32 first = mBusCount;
+        U64 start = ~U64(0);
+        for (U32 bus = 0; bus < mBusCount; bus++){
+            const std::deque<Packet> &packets = mBuses[bus].mSink.mPackets;
+            if (!packets.empty() && packets.front().mStart < start){
+                first = bus;
+                start = packets.front().mStart;
+            }
+        }
+        if (first == mBusCount){
+            return;
+        }
+
+        //The next packet of the same bus starts after this one ends
+        Packet &packet = mBuses[first].mSink.mPackets.front();
+        U64 next = ~U64(0);
+        for (U32 bus = 0; bus < mBusCount; bus++){
+            const Bus &other = mBuses[bus];
+            if (bus == first){
+                continue;
+            }
+            if (!other.mSink.mPackets.empty()){
+                U64 other_start = other.mSink.mPackets.front().mStart;
+                next = other_start < next ? other_start : next;
+                continue;
+            }
+            if (all){
+                continue;
+            }
+            const Packet &pending = other.mSink.mPending;
+            if (!pending.mFrames.empty() || !pending.mMarkers.empty()){
+                if (pending.mStart <= packet.mEnd){
+                    return;
+                }
+            }else if (!other.mIdle && other.mDecoder.GetFrameBound() <= packet.mEnd){
+                return;
+            }
+        }
+
+        PassPacket(packet, next);
+        mBuses[first].mSink.mPackets.pop_front();
+    }
+}
+
+//The SDK takes frames in order and without overlap.  A packet ends before the
+//packet of another bus that starts in it, the way the timing frames of a
+//single bus are cut short by the packet they run into.  Packets of commands
+//are cut short as the one frame of overview mode, so none of their fields go
+//missing.  A frame that starts where the frames passed on already cover is a
+//late timed frame, it starts after them as in the decoder of a single bus,
+//or a packet starting on the same sample as the one of another bus, it loses
+//that sample.  Every frame keeps at least one sample.
+void SDIOMultiBusDecoder::PassPacket(Packet &packet, U64 next)
+{
+    std::vector<SDIOFrame> &frames = packet.mFrames;
+    if (!frames.empty() && packet.mEnd >= next){
+        if (frames.size() > 1 && packet.mHasSummary){
+            frames.assign(1, packet.mSummary);
+        }
+        while (frames.size() > 1 && frames.back().mStartingSampleInclusive >= next){
+            frames.pop_back();
+        }
+        SDIOFrame &last = frames.back();
+        last.mEndingSampleInclusive = next > last.mStartingSampleInclusive ? next - 1 : last.mStartingSampleInclusive;
+    }
+
+    bool added = false;
+    for (size_t i = 0; i < frames.size(); i++){
+        SDIOFrame &frame = frames[i];
+        if (mFramesOut && frame.mStartingSampleInclusive <= mLastEnd){
+            frame.mStartingSampleInclusive = mLastEnd + 1;
+            if (frame.mEndingSampleInclusive < frame.mStartingSampleInclusive){
+                continue;
+            }
+        }
+        mSink->AddFrame(frame);
+        mFramesOut = true;
+        mLastEnd = frame.mEndingSampleInclusive;
+        added = true;
+    }
+    for (size_t i = 0; i < packet.mMarkers.size(); i++){
+        mSink->AddMarker(packet.mMarkers[i]);
+        added = true;
+    }
+    if (added){
+        mSink->CommitPacket();
+    }
+}
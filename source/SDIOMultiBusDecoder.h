@@ -0,0 +1,187 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_MULTI_BUS_DECODER
+#define SDIO_MULTI_BUS_DECODER
+
+#include <LogicPublicTypes.h>
+#include <deque>
+#include <vector>
+#include "SDIODecoder.h"
+
+class SDIOSharedClock;
+
+// The clock as one of the buses sharing it sees it.  The edges come from the
+// buffer of the shared clock, each bus keeps its own position in it.
+class SDIOClockView : public SDIOChannel
+{
+public:
+    SDIOClockView();
+
+    void Start(SDIOSharedClock* clock);
+
+    virtual U64 GetSampleNumber() { return mSample; }
+    virtual BitState GetBitState() { return mState; }
+    virtual void AdvanceToNextEdge();
+    virtual void AdvanceToAbsPosition(U64 sample);
+    virtual U64 GetSampleOfNextEdge();
+    virtual bool WouldAdvancingToAbsPositionCauseTransition(U64 sample);
+    virtual bool DoMoreTransitionsExistInCurrentData();
+    virtual bool GetRisingEdgeCount(U64 &count);
+
+protected:
+    void SkipReleased();
+
+    SDIOSharedClock* mClock;
+    // Buffer entry at or before mSample
+    U64 mIndex;
+    U64 mSample;
+    BitState mState;
+};
+
+// Walks a clock channel once for all the buses on it.  The edges read are
+// kept from the earliest sample a bus may still move to.  A seek that no bus
+// needs the edges before skips them, as the decoder of a single bus does,
+// unless the rising edges are counted for the timing checks.
+class SDIOSharedClock
+{
+public:
+    SDIOSharedClock();
+
+    void Start(SDIOChannel* clock, bool count_edges);
+    // No view moves to a sample before floor from now on
+    void Release(U64 floor);
+    // Waits for the next clock edge while no bus has anything to decode
+    void Wait();
+
+protected:
+    friend class SDIOClockView;
+
+    // A clock edge, or where the walk started or skipped to, and the rising
+    // edges up to it
+    struct Edge
+    {
+        U64 mSample;
+        BitState mState;
+        U64 mRising;
+    };
+
+    // Entries are numbered from the start of the walk
+    const Edge& GetEdge(U64 index) const { return mEdges[size_t(index - mFirst)]; }
+    U64 GetFirst() const { return mFirst; }
+    U64 GetEnd() const { return mFirst + mEdges.size(); }
+    // Reads the next edge of the channel into the buffer
+    void Pull();
+    // Has the buffer hold every edge up to sample
+    void Reach(U64 sample);
+    void Reset();
+
+    SDIOChannel* mChannel;
+    std::deque<Edge> mEdges;
+    U64 mFirst;
+    U64 mFloor;
+    U64 mRising;
+    bool mCountEdges;
+};
+
+// Decodes the CMD/DAT groups of several buses on one clock in a single pass
+// over it.  Every bus has a decoder of its own.  The one that looks at the
+// earliest sample next is stepped, so the buses stay within a few clocks of
+// each other, and their packets are passed on in time order with the bus
+// number in the frame flags.
+class SDIOMultiBusDecoder
+{
+public:
+    // As many as SDIOAnalyzerSettings has lines for
+    enum {MAX_BUSES = 2};
+    enum lines {LINE_CMD, LINE_DAT0, LINE_DAT1, LINE_DAT2, LINE_DAT3, LINE_COUNT};
+
+    SDIOMultiBusDecoder();
+
+    // lines[bus * LINE_COUNT + line], DAT1-DAT3 may be nullptr.  The CMD53
+    // payload is only written for the first bus, checkpoints are not taken.
+    void Start(SDIOChannel* clock, SDIOChannel* const* lines, U32 bus_count, SDIOFrameSink* sink,
+               const SDIODecodeOptions &options);
+    void Step();
+    void Finish();
+
+    U32 GetBusCount() const { return mBusCount; }
+    const SDIODecoder& GetDecoder(U32 bus) const { return mBuses[bus].mDecoder; }
+
+protected:
+    struct Packet
+    {
+        U64 mStart;
+        // End of the last frame, or the last marker without frames
+        U64 mEnd;
+        std::vector<SDIOFrame> mFrames;
+        std::vector<U64> mMarkers;
+        // The packet as one frame, for full mode packets of commands
+        bool mHasSummary;
+        SDIOFrame mSummary;
+    };
+
+    // Queues the packets of one bus until no other bus can come up with one
+    // that overlaps them
+    class BusSink : public SDIOFrameSink
+    {
+    public:
+        virtual void AddFrame(const SDIOFrame &frame);
+        virtual void AddMarker(U64 sample);
+        virtual void CommitPacket();
+        virtual void CommitResults() {}
+        virtual void AddPacketSummary(const SDIOFrame &frame);
+
+        U8 mTag;
+        Packet mPending;
+        std::deque<Packet> mPackets;
+        // Of the packets not committed yet, collapsed polls are never
+        std::deque<SDIOFrame> mSummaries;
+    };
+
+    struct Bus
+    {
+        SDIOClockView mClock;
+        SDIODecoder mDecoder;
+        BusSink mSink;
+        // Nothing to decode in the data so far
+        bool mIdle;
+    };
+
+    // Passes on the packets that are next in time, or all of them.  Each
+    // packet of a bus goes out as a packet of its own.
+    void Release(bool all);
+    // Passes on a packet that the next packet of another bus starts in, or
+    // ~0 if none does
+    void PassPacket(Packet &packet, U64 next);
+
+    // End of the last frame passed on, if any
+    bool mFramesOut;
+    U64 mLastEnd;
+
+    SDIOSharedClock mClock;
+    Bus mBuses[MAX_BUSES];
+    U32 mBusCount;
+    SDIOFrameSink* mSink;
+};
+
+#endif //SDIO_MULTI_BUS_DECODER
@@ -0,0 +1,173 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIOParallelExport.h"
+#include "SDIOAnalyzerResults.h"
+#include "SDIOTextFormatter.h"
+#include <algorithm>
+
+SDIOParallelExport::SDIOParallelExport(DisplayBase display_base, U64 trigger_sample, U32 sample_rate)
+:    mDisplayBase(display_base),
+    mTriggerSample(trigger_sample),
+    mSampleRate(sample_rate),
+    mStopping(false)
+{
+}
+
+SDIOParallelExport::~SDIOParallelExport()
+{
+    Stop();
+}
+
+bool SDIOParallelExport::Write(AnalyzerResults &results, std::ostream &file)
+{
+    U64 num_packets = results.GetNumPackets();
+    U64 num_chunks = (num_packets + CHUNK_PACKETS - 1) / CHUNK_PACKETS;
+
+    //The calling thread fills and writes, one thread is left to it
+    U32 workers = std::thread::hardware_concurrency();
+    workers = workers > 1 ? workers - 1 : 1;
+    if (num_chunks < workers){
+        workers = U32(num_chunks);
+    }
+
+    //Nothing to share out, formatted on the calling thread
+    if (workers <= 1){
+        mChunks.resize(1);
+        for (U64 c = 0; c < num_chunks; c++){
+            U64 first = c * CHUNK_PACKETS;
+            U64 last = std::min<U64>(first + CHUNK_PACKETS, num_packets);
+            Fill(results, first, last, mChunks[0]);
+            Format(mChunks[0]);
+            file.write(mChunks[0].mText.data(), mChunks[0].mText.size());
+            if (results.UpdateExportProgressAndCheckForCancel(last, num_packets)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //Two slots a worker so the next chunk is ready when one finishes
+    U32 slots = workers * 2;
+    mChunks.resize(slots);
+    for (U32 s = 0; s < slots; s++){
+        mChunks[s].mState = Chunk::FREE;
+    }
+    mPending.clear();
+    mStopping = false;
+    for (U32 w = 0; w < workers; w++){
+        mWorkers.push_back(std::thread(&SDIOParallelExport::WorkerThread, this));
+    }
+
+    bool cancelled = false;
+    U64 filled = 0;
+    for (U64 written = 0; written < num_chunks && !cancelled; written++){
+        for ( ; filled < num_chunks && filled - written < slots; filled++){
+            U64 first = filled * CHUNK_PACKETS;
+            Chunk &chunk = mChunks[filled % slots];
+            Fill(results, first, std::min<U64>(first + CHUNK_PACKETS, num_packets), chunk);
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            chunk.mState = Chunk::FILLED;
+            mPending.push_back(U32(filled % slots));
+            mFilled.notify_one();
+        }
+
+        Chunk &chunk = mChunks[written % slots];
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDone.wait(lock, [&chunk]() { return chunk.mState == Chunk::DONE; });
+            chunk.mState = Chunk::FREE;
+        }
+        file.write(chunk.mText.data(), chunk.mText.size());
+        U64 completed = std::min<U64>((written + 1) * CHUNK_PACKETS, num_packets);
+        cancelled = results.UpdateExportProgressAndCheckForCancel(completed, num_packets);
+    }
+
+    Stop();
+    return !cancelled;
+}
+
+//Copies the frames so the workers never call into the results
+void SDIOParallelExport::Fill(AnalyzerResults &results, U64 first_packet, U64 last_packet, Chunk &chunk)
+{
+    chunk.mFrames.clear();
+    chunk.mPacketEnds.clear();
+    for (U64 p = first_packet; p < last_packet; p++){
+        U64 first_frame_id, last_frame_id;
+        results.GetFramesContainedInPacket(p, &first_frame_id, &last_frame_id);
+        for (U64 i = first_frame_id; i <= last_frame_id; i++){
+            chunk.mFrames.push_back(results.GetFrame(i));
+        }
+        chunk.mPacketEnds.push_back(U32(chunk.mFrames.size()));
+    }
+}
+
+void SDIOParallelExport::Format(Chunk &chunk)
+{
+    chunk.mText.clear();
+    SDIOTextFormatter text;
+    U32 begin = 0;
+    for (size_t p = 0; p < chunk.mPacketEnds.size(); p++){
+        U32 end = chunk.mPacketEnds[p];
+        text.Clear();
+        SDIOAnalyzerResults::AppendExportLine(&chunk.mFrames[begin], end - begin, mDisplayBase, mTriggerSample, mSampleRate, text);
+        chunk.mText.append(text.GetText(), text.GetLength());
+        begin = end;
+    }
+}
+
+void SDIOParallelExport::WorkerThread()
+{
+    for ( ; ; ){
+        U32 slot;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mFilled.wait(lock, [this]() { return mStopping || !mPending.empty(); });
+            if (mPending.empty()){
+                return;
+            }
+            slot = mPending.front();
+            mPending.pop_front();
+        }
+
+        Format(mChunks[slot]);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mChunks[slot].mState = Chunk::DONE;
+        mDone.notify_one();
+    }
+}
+
+//Chunks not yet picked up are dropped, they are only left after a cancel
+void SDIOParallelExport::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+        mPending.clear();
+        mFilled.notify_all();
+    }
+    for (size_t w = 0; w < mWorkers.size(); w++){
+        mWorkers[w].join();
+    }
+    mWorkers.clear();
+}
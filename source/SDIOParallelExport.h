@@ -0,0 +1,84 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_PARALLEL_EXPORT
+#define SDIO_PARALLEL_EXPORT
+
+#include <AnalyzerResults.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes the packet lines of the text export with the formatting spread over
+// several threads.  The results are only read by the calling thread: it
+// copies the frames of a chunk of packets into a free slot, a worker formats
+// the chunk into the slot's own text buffer, and the calling thread writes
+// the chunks to the file in packet order as they finish.  The buffers are
+// reused from one chunk to the next.
+//
+// The output is the same as formatting the packets one by one.
+class SDIOParallelExport
+{
+public:
+    SDIOParallelExport(DisplayBase display_base, U64 trigger_sample, U32 sample_rate);
+    ~SDIOParallelExport();
+
+    // Progress is reported between chunks, false when the export was cancelled
+    bool Write(AnalyzerResults &results, std::ostream &file);
+
+    enum {CHUNK_PACKETS = 4096};
+
+protected:
+    struct Chunk
+    {
+        enum states {FREE, FILLED, DONE};
+        U32 mState;
+        std::vector<Frame> mFrames;
+        // Index in mFrames past the last frame of each packet
+        std::vector<U32> mPacketEnds;
+        std::string mText;
+    };
+
+    void Fill(AnalyzerResults &results, U64 first_packet, U64 last_packet, Chunk &chunk);
+    void Format(Chunk &chunk);
+    void WorkerThread();
+    void Stop();
+
+    DisplayBase mDisplayBase;
+    U64 mTriggerSample;
+    U32 mSampleRate;
+
+    std::vector<Chunk> mChunks;
+    // Slots filled and waiting for a worker
+    std::deque<U32> mPending;
+    bool mStopping;
+    std::mutex mMutex;
+    std::condition_variable mFilled;
+    std::condition_variable mDone;
+    std::vector<std::thread> mWorkers;
+};
+
+#endif //SDIO_PARALLEL_EXPORT
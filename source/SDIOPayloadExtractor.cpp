@@ -0,0 +1,160 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOPayloadExtractor.h"
+#include <string.h>
+
+SDIOStreamWriter::SDIOStreamWriter()
+:    mFile(nullptr),
+    mBuffer(nullptr),
+    mHead(0),
+    mUsed(0)
+{
+}
+
+SDIOStreamWriter::~SDIOStreamWriter()
+{
+    Close();
+    delete[] mBuffer;
+}
+
+bool SDIOStreamWriter::Open(const char* file_name)
+{
+    Close();
+
+    mFile = fopen(file_name, "wb");
+    if (mFile == nullptr)
+        return false;
+
+    // The buffer is kept across Close()/Open() so re-runs reuse it
+    if (mBuffer == nullptr)
+        mBuffer = new U8[BUFFER_SIZE];
+    mHead = 0;
+    mUsed = 0;
+    return true;
+}
+
+void SDIOStreamWriter::Write(const U8* data, U32 length)
+{
+    if (mFile == nullptr)
+        return;
+
+    while (length > 0)
+    {
+        // Only block sized chunks are ever added, so draining down to WRITE_SIZE
+        // always leaves room for them
+        if (mUsed + length > BUFFER_SIZE - WRITE_SIZE)
+            Drain(WRITE_SIZE);
+
+        U32 tail = (mHead + mUsed) % BUFFER_SIZE;
+        U32 chunk = BUFFER_SIZE - tail;
+        if (chunk > length)
+            chunk = length;
+        if (chunk > BUFFER_SIZE - mUsed)
+            chunk = BUFFER_SIZE - mUsed;
+
+        memcpy(mBuffer + tail, data, chunk);
+        mUsed += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+//Write out everything from the head of the ring up to the end of the buffer,
+//then from its start, until no more than min_length bytes are left
+void SDIOStreamWriter::Drain(U32 min_length)
+{
+    while (mUsed > min_length)
+    {
+        U32 chunk = BUFFER_SIZE - mHead;
+        if (chunk > mUsed)
+            chunk = mUsed;
+
+        fwrite(mBuffer + mHead, 1, chunk, mFile);
+        mHead = (mHead + chunk) % BUFFER_SIZE;
+        mUsed -= chunk;
+    }
+}
+
+void SDIOStreamWriter::Flush()
+{
+    if (mFile == nullptr)
+        return;
+
+    Drain(0);
+    fflush(mFile);
+}
+
+void SDIOStreamWriter::Close()
+{
+    if (mFile == nullptr)
+        return;
+
+    Drain(0);
+    fclose(mFile);
+    mFile = nullptr;
+}
+
+SDIOPayloadExtractor::SDIOPayloadExtractor()
+{
+}
+
+SDIOPayloadExtractor::~SDIOPayloadExtractor()
+{
+    Close();
+}
+
+void SDIOPayloadExtractor::Open(const char* directory)
+{
+    Close();
+    mDirectory = directory;
+}
+
+void SDIOPayloadExtractor::Close()
+{
+    for (U32 fn = 0; fn < NUM_FUNCTIONS; fn++)
+    {
+        mStreams[fn][0].Close();
+        mStreams[fn][1].Close();
+    }
+    mDirectory.clear();
+}
+
+void SDIOPayloadExtractor::AddData(U32 function, bool write, const U8* data, U32 length)
+{
+    if (mDirectory.empty() || function >= NUM_FUNCTIONS)
+        return;
+
+    SDIOStreamWriter &stream = mStreams[function][write ? 1 : 0];
+    if (!stream.IsOpen())
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "/fn%u_%s.bin", function, write ? "write" : "read");
+        if (!stream.Open((mDirectory + name).c_str()))
+        {
+            // Don't retry for every block if the folder is not writable
+            mDirectory.clear();
+            return;
+        }
+    }
+    stream.Write(data, length);
+}
@@ -0,0 +1,78 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_PAYLOAD_EXTRACTOR
+#define SDIO_PAYLOAD_EXTRACTOR
+
+#include <LogicPublicTypes.h>
+#include <stdio.h>
+#include <string>
+
+// Appends bytes to a file through a fixed size ring buffer.  The buffer is
+// only written out in large sequential chunks, so small data blocks do not
+// each cost a write.
+class SDIOStreamWriter
+{
+public:
+    SDIOStreamWriter();
+    ~SDIOStreamWriter();
+
+    bool Open(const char* file_name);
+    void Write(const U8* data, U32 length);
+    void Flush();
+    void Close();
+    bool IsOpen() const { return mFile != nullptr; }
+
+    enum {BUFFER_SIZE = 1 << 18, WRITE_SIZE = 1 << 16};
+
+protected:
+    void Drain(U32 min_length);
+
+    FILE* mFile;
+    U8* mBuffer;
+    U32 mHead;
+    U32 mUsed;
+};
+
+// Reassembles the data phase of CMD53 transfers into one byte stream per
+// function and direction, written to <directory>/fn<n>_read.bin and
+// <directory>/fn<n>_write.bin.  Files are created on their first data.
+class SDIOPayloadExtractor
+{
+public:
+    SDIOPayloadExtractor();
+    ~SDIOPayloadExtractor();
+
+    void Open(const char* directory);
+    void Close();
+    bool IsEnabled() const { return !mDirectory.empty(); }
+
+    void AddData(U32 function, bool write, const U8* data, U32 length);
+
+    enum {NUM_FUNCTIONS = 8};
+
+protected:
+    std::string mDirectory;
+    SDIOStreamWriter mStreams[NUM_FUNCTIONS][2];
+};
+
+#endif //SDIO_PAYLOAD_EXTRACTOR
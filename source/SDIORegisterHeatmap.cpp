@@ -0,0 +1,201 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIORegisterHeatmap.h"
+#include "SDIOTextFormatter.h"
+#include <algorithm>
+#include <string.h>
+
+SDIORegisterHeatmap::SDIORegisterHeatmap()
+{
+    Reset();
+}
+
+void SDIORegisterHeatmap::Reset()
+{
+    Register empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.key = EMPTY;
+    mTable.assign(256, empty);
+    mShift = 32 - 8;
+    mCount = 0;
+    mPending = false;
+    mPendingWrite = false;
+    mPendingKey = 0;
+    mPendingStart = 0;
+    mPendingEnd = 0;
+}
+
+//Fibonacci hashing, the top bits of the product pick the slot
+SDIORegisterHeatmap::Register& SDIORegisterHeatmap::Find(U32 key)
+{
+    U32 mask = U32(mTable.size() - 1);
+    for (U32 slot = (key * 2654435769U) >> mShift; ; slot = (slot + 1) & mask)
+    {
+        Register &r = mTable[slot];
+        if (r.key == key)
+            return r;
+        if (r.key != EMPTY)
+            continue;
+
+        //Kept at most three quarters full so probe runs stay short
+        if ((mCount + 1) * 4 > mTable.size() * 3)
+        {
+            Grow();
+            return Find(key);
+        }
+        r.key = key;
+        mCount++;
+        return r;
+    }
+}
+
+void SDIORegisterHeatmap::Grow()
+{
+    std::vector<Register> old;
+    old.swap(mTable);
+
+    Register empty;
+    memset(&empty, 0, sizeof(empty));
+    empty.key = EMPTY;
+    mTable.assign(old.size() * 2, empty);
+    mShift--;
+
+    U32 mask = U32(mTable.size() - 1);
+    for (size_t i = 0; i < old.size(); i++)
+    {
+        if (old[i].key == EMPTY)
+            continue;
+        U32 slot = (old[i].key * 2654435769U) >> mShift;
+        while (mTable[slot].key != EMPTY)
+            slot = (slot + 1) & mask;
+        mTable[slot] = old[i];
+    }
+}
+
+//An unanswered command only takes the bus for itself
+void SDIORegisterHeatmap::Account(U64 end, bool answered, U8 value)
+{
+    Register &r = Find(mPendingKey);
+    r.samples += (answered ? end : mPendingEnd) - mPendingStart;
+    if (mPendingWrite)
+    {
+        r.writes++;
+    }
+    else
+    {
+        r.reads++;
+        if (answered)
+        {
+            if (r.read && r.lastValue != value)
+                r.changes++;
+            r.lastValue = value;
+            r.read = true;
+        }
+    }
+    mPending = false;
+}
+
+void SDIORegisterHeatmap::AddPacket(bool host, bool long_packet, U64 raw, U64 start, U64 end)
+{
+    U32 index = U32(raw >> 40) & 0x3F;
+    U32 argument = U32(raw >> 8);
+    if (host)
+    {
+        if (mPending)
+            Account(0, false, 0);
+        if (index != 52)
+            return;
+        mPending = true;
+        mPendingWrite = (argument >> 31) != 0;
+        mPendingKey = (argument >> 28 & 0x7) << 17 | (argument >> 9 & 0x1FFFF);
+        mPendingStart = start;
+        mPendingEnd = end;
+    }
+    else if (mPending)
+    {
+        if (!long_packet && index == 52)
+            Account(end, true, U8(argument));
+        else
+            Account(0, false, 0);
+    }
+}
+
+static bool MoreBusTime(const SDIORegisterHeatmap::Register* a, const SDIORegisterHeatmap::Register* b)
+{
+    if (a->samples != b->samples)
+        return a->samples > b->samples;
+    return a->key < b->key;
+}
+
+static void AppendCounts(SDIOTextFormatter &text, U64 reads, U64 writes, U64 changes, U64 samples, U32 sample_rate)
+{
+    text.Append(",");
+    text.AppendNumber(reads, Decimal, 64);
+    text.Append(",");
+    text.AppendNumber(writes, Decimal, 64);
+    text.Append(",");
+    text.AppendNumber(changes, Decimal, 64);
+    text.Append(",");
+    text.AppendDuration(samples, sample_rate);
+    text.Append(",");
+    if (reads + writes != 0)
+        text.AppendDuration(samples / (reads + writes), sample_rate);
+    text.Append("\n");
+}
+
+void SDIORegisterHeatmap::Format(SDIOTextFormatter &text, U32 sample_rate) const
+{
+    std::vector<const Register*> registers;
+    registers.reserve(mCount);
+    for (size_t i = 0; i < mTable.size(); i++)
+    {
+        if (mTable[i].key != EMPTY)
+            registers.push_back(&mTable[i]);
+    }
+    size_t top = std::min<size_t>(registers.size(), TOP_REGISTERS);
+    std::partial_sort(registers.begin(), registers.begin() + top, registers.end(), MoreBusTime);
+
+    text.Append("Function,Address,Reads,Writes,Value changes,Bus time,Mean bus time\n");
+    for (size_t i = 0; i < top; i++)
+    {
+        const Register &r = *registers[i];
+        text.AppendNumber(r.key >> 17, Decimal, 3);
+        text.Append(",");
+        text.AppendNumber(r.key & 0x1FFFF, Hexadecimal, 17);
+        AppendCounts(text, r.reads, r.writes, r.changes, r.samples, sample_rate);
+    }
+
+    //Summed wider than a single register counts
+    U64 reads = 0;
+    U64 writes = 0;
+    U64 changes = 0;
+    U64 samples = 0;
+    for (size_t i = 0; i < registers.size(); i++)
+    {
+        reads += registers[i]->reads;
+        writes += registers[i]->writes;
+        changes += registers[i]->changes;
+        samples += registers[i]->samples;
+    }
+    text.Append("Total,");
+    AppendCounts(text, reads, writes, changes, samples, sample_rate);
+}
@@ -0,0 +1,87 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_REGISTER_HEATMAP
+#define SDIO_REGISTER_HEATMAP
+
+#include <LogicPublicTypes.h>
+#include <vector>
+
+class SDIOTextFormatter;
+
+// Counts the CMD52 accesses to each register, by function and address, and
+// the bus time they take from the command start bit to the end of the
+// response.  The registers are kept in an open addressing table with linear
+// probing, a lookup is a multiply and usually a single probe.
+//
+// Not part of a decoder checkpoint, after a resume it only covers the
+// packets decoded since.
+class SDIORegisterHeatmap
+{
+public:
+    SDIORegisterHeatmap();
+
+    void Reset();
+
+    // Every decoded packet, raw holds its 48 bits unless it is a long response
+    void AddPacket(bool host, bool long_packet, U64 raw, U64 start, U64 end);
+
+    // CSV of the registers that took the most bus time and the totals
+    void Format(SDIOTextFormatter &text, U32 sample_rate) const;
+
+    enum {TOP_REGISTERS = 20};
+
+    struct Register
+    {
+        // Function << 17 | address, EMPTY for a free slot
+        U32 key;
+        U32 reads;
+        U32 writes;
+        // Reads that returned another value than the read before
+        U32 changes;
+        U64 samples;
+        U8 lastValue;
+        bool read;
+    };
+
+    enum {EMPTY = ~0U};
+
+    U32 GetRegisterCount() const { return mCount; }
+
+protected:
+    Register& Find(U32 key);
+    void Grow();
+    void Account(U64 end, bool answered, U8 value);
+
+    std::vector<Register> mTable;
+    U32 mShift;
+    U32 mCount;
+
+    // CMD52 waiting for its response
+    bool mPending;
+    bool mPendingWrite;
+    U32 mPendingKey;
+    U64 mPendingStart;
+    U64 mPendingEnd;
+};
+
+#endif //SDIO_REGISTER_HEATMAP
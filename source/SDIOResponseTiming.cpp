@@ -0,0 +1,294 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIOResponseTiming.h"
+#include "SDIOTextFormatter.h"
+#include <string.h>
+
+SDIOResponseTiming::SDIOResponseTiming()
+{
+    Reset();
+}
+
+void SDIOResponseTiming::Reset()
+{
+    memset(mCommands, 0, sizeof(mCommands));
+    mLength[0] = mLength[1] = 0;
+    mBits[0] = mBits[1] = 0;
+    mLastEnd = 0;
+    mBlockEnd = 0;
+    mLastEndClock = 0;
+    mBlockEndClock = 0;
+    mLastCommand = 0;
+    mAwaitingResponse = false;
+    mLastHost = false;
+    mApp = false;
+    mLastApp = false;
+}
+
+const char* SDIOResponseTiming::GetCheckName(U32 check)
+{
+    switch (check)
+    {
+    case CHECK_NCR: return "NCR";
+    case CHECK_NID: return "NID";
+    case CHECK_NCC: return "NCC";
+    case CHECK_NRC: return "NRC";
+    case CHECK_NWR: return "NWR";
+    case CHECK_TIMEOUT: return "Timeout";
+    }
+    return "";
+}
+
+void SDIOResponseTiming::GetBounds(U32 check, U32 &min_clocks, U32 &max_clocks)
+{
+    min_clocks = 0;
+    max_clocks = 0;
+    switch (check)
+    {
+    case CHECK_NCR: min_clocks = 2; max_clocks = 64; break;
+    case CHECK_NID: min_clocks = 5; max_clocks = 5; break;
+    case CHECK_NCC: min_clocks = 8; break;
+    case CHECK_NRC: min_clocks = 8; break;
+    case CHECK_NWR: min_clocks = 2; break;
+    }
+}
+
+U64 SDIOResponseTiming::Pack(const Violation &violation)
+{
+    return violation.mCheck | violation.mCommand << 8 | U64(violation.mClocks) << 16;
+}
+
+void SDIOResponseTiming::Unpack(U64 data, Violation &violation)
+{
+    violation.mCheck = U32(data & 0xFF);
+    violation.mCommand = U32(data >> 8) & 0xFF;
+    violation.mClocks = U32(data >> 16);
+    violation.mStart = 0;
+    violation.mEnd = 0;
+}
+
+//The clocks of a gap are those between the cycle of the end bit before it
+//and the cycle of the start bit after it.  Without counts, a packet is 48 or
+//136 clocks from its start bit edge to the rising edge of its end bit, less
+//half a clock.  The start bit of the next packet is half a clock after its
+//edge, so the whole clocks between the two are about the gap's samples over
+//the period, give or take one.
+void SDIOResponseTiming::Measure(U64 start, U64 end, U64 start_clock, U64 end_clock, Gap &gap) const
+{
+    gap.start = start + 1;
+    gap.end = end - 1;
+    gap.counted = start_clock != 0 && end_clock > start_clock;
+    if (gap.counted)
+    {
+        U64 clocks = end_clock - start_clock - 1;
+        gap.clocks = clocks > ~U32(0) ? ~U32(0) : U32(clocks);
+        gap.fewest = gap.clocks;
+        gap.most = gap.clocks;
+        return;
+    }
+
+    gap.fewest = ~U32(0);
+    gap.most = 0;
+    for (U32 i = 0; i < 2; i++)
+    {
+        if (mLength[i] == 0)
+            continue;
+        U64 clocks = (end - start) * (2 * mBits[i] - 1) / (2 * mLength[i]);
+        U32 count = clocks > ~U32(0) - 1 ? ~U32(0) - 1 : U32(clocks);
+        if (count < gap.fewest)
+            gap.fewest = count;
+        if (count > gap.most)
+            gap.most = count;
+    }
+    if (gap.fewest > gap.most)
+        gap.fewest = gap.most;
+    gap.clocks = gap.fewest;
+    if (gap.fewest != 0)
+        gap.fewest--;
+    gap.most++;
+}
+
+bool SDIOResponseTiming::Check(U32 check, U32 command, const Gap &gap, Violation &violation)
+{
+    U32 min_clocks, max_clocks;
+    GetBounds(check, min_clocks, max_clocks);
+    if (min_clocks == max_clocks && !gap.counted)
+        return false;
+    if (gap.most >= min_clocks && (max_clocks == 0 || gap.fewest <= max_clocks))
+        return false;
+    violation.mClocks = gap.clocks;
+
+    mCommands[command].violations[check]++;
+    violation.mCheck = check;
+    violation.mCommand = command;
+    violation.mStart = gap.start;
+    violation.mEnd = gap.end;
+    return true;
+}
+
+bool SDIOResponseTiming::AddPacket(bool host, bool long_packet, U64 raw, U64 start, U64 end, U64 start_clock, U64 end_clock,
+                                   Violation &violation)
+{
+    mLength[1] = mLength[0];
+    mBits[1] = mBits[0];
+    mLength[0] = end - start;
+    mBits[0] = long_packet ? 136 : 48;
+
+    U32 index = U32(raw >> 40) & 0x3F;
+    U32 argument = U32(raw >> 8);
+    bool found = false;
+    if (mLastEnd != 0 && start > mLastEnd)
+    {
+        Gap gap;
+        Measure(mLastEnd, start, mLastEndClock, start_clock, gap);
+        if (host && mAwaitingResponse)
+        {
+            //The host gave up on the command before
+            mCommands[mLastCommand].violations[CHECK_TIMEOUT]++;
+            violation.mCheck = CHECK_TIMEOUT;
+            violation.mCommand = mLastCommand;
+            violation.mClocks = gap.clocks;
+            violation.mStart = gap.start;
+            violation.mEnd = gap.end;
+            found = true;
+        }
+        else if (host)
+        {
+            found = Check(mLastHost ? CHECK_NCC : CHECK_NRC, index, gap, violation);
+        }
+        else if (mAwaitingResponse)
+        {
+            Command &command = mCommands[mLastCommand];
+            if (command.responses == 0 || gap.clocks < command.minClocks)
+                command.minClocks = gap.clocks;
+            if (gap.clocks > command.maxClocks)
+                command.maxClocks = gap.clocks;
+            command.totalClocks += gap.clocks;
+            command.responses++;
+            //R2 and R3 come a fixed number of clocks after CMD2 and ACMD41
+            bool identification = mLastCommand == 2 || (mLastCommand == 41 && mLastApp);
+            found = Check(identification ? CHECK_NID : CHECK_NCR, mLastCommand, gap, violation);
+        }
+    }
+
+    if (host)
+    {
+        //CMD0, CMD4, CMD15 and CMD7 deselecting the card are not answered
+        mCommands[index].commands++;
+        mAwaitingResponse = index != 0 && index != 4 && index != 15 && !(index == 7 && (argument >> 16) == 0);
+        mLastCommand = index;
+        mLastApp = mApp;
+        mApp = index == 55;
+    }
+    else
+    {
+        mAwaitingResponse = false;
+    }
+    mLastHost = host;
+    mLastEnd = end;
+    mLastEndClock = end_clock;
+    mBlockEnd = 0;
+    mBlockEndClock = 0;
+    return found;
+}
+
+bool SDIOResponseTiming::AddWriteBlock(U64 start, U64 start_clock, Violation &violation)
+{
+    bool block = mBlockEnd > mLastEnd;
+    U64 end = block ? mBlockEnd : mLastEnd;
+    if (end == 0 || start <= end)
+        return false;
+
+    Gap gap;
+    Measure(end, start, block ? mBlockEndClock : mLastEndClock, start_clock, gap);
+    return Check(CHECK_NWR, mLastCommand, gap, violation);
+}
+
+void SDIOResponseTiming::EndWriteBlock(U64 end, U64 end_clock)
+{
+    mBlockEnd = end;
+    mBlockEndClock = end_clock;
+}
+
+void SDIOResponseTiming::Format(SDIOTextFormatter &text) const
+{
+    Command total;
+    memset(&total, 0, sizeof(total));
+
+    text.Append("Command,Commands,Responses,Min clocks to response,Max clocks to response,Mean clocks to response");
+    for (U32 check = 0; check < CHECK_COUNT; check++)
+    {
+        text.Append(",");
+        text.Append(GetCheckName(check));
+    }
+    text.Append("\n");
+
+    for (U32 index = 0; index <= 64; index++)
+    {
+        const Command &command = index < 64 ? mCommands[index] : total;
+        if (index < 64)
+        {
+            if (command.commands == 0 && command.responses == 0)
+                continue;
+            if (total.responses == 0 || (command.responses != 0 && command.minClocks < total.minClocks))
+                total.minClocks = command.minClocks;
+            if (command.maxClocks > total.maxClocks)
+                total.maxClocks = command.maxClocks;
+            total.commands += command.commands;
+            total.responses += command.responses;
+            total.totalClocks += command.totalClocks;
+            for (U32 check = 0; check < CHECK_COUNT; check++)
+                total.violations[check] += command.violations[check];
+
+            text.Append("CMD");
+            text.AppendNumber(index, Decimal, 6);
+        }
+        else
+        {
+            text.Append("Total");
+        }
+
+        text.Append(",");
+        text.AppendNumber(command.commands, Decimal, 32);
+        text.Append(",");
+        text.AppendNumber(command.responses, Decimal, 32);
+        if (command.responses != 0)
+        {
+            text.Append(",");
+            text.AppendNumber(command.minClocks, Decimal, 32);
+            text.Append(",");
+            text.AppendNumber(command.maxClocks, Decimal, 32);
+            text.Append(",");
+            text.AppendNumber(command.totalClocks / command.responses, Decimal, 32);
+        }
+        else
+        {
+            text.Append(",,,");
+        }
+        for (U32 check = 0; check < CHECK_COUNT; check++)
+        {
+            text.Append(",");
+            text.AppendNumber(command.violations[check], Decimal, 32);
+        }
+        text.Append("\n");
+    }
+}
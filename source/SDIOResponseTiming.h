@@ -0,0 +1,125 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_RESPONSE_TIMING
+#define SDIO_RESPONSE_TIMING
+
+#include <LogicPublicTypes.h>
+
+class SDIOTextFormatter;
+
+// Checks the clock cycles between packets and data blocks against the bounds
+// of the SD physical layer spec and finds commands the card never answered.
+// With the timing checks on the decoder counts the clock edges in a gap.
+// Otherwise they are estimated from its length and the clock period of the
+// packets next to it, which is off by one with rounding and by more where the
+// clock stops, so the estimate is a range and a gap only breaks a bound when
+// all of it is out.  An exact bound, as for NID, is only checked on counts.
+class SDIOResponseTiming
+{
+public:
+    SDIOResponseTiming();
+
+    void Reset();
+
+    // NCR command to response, NID the same for CMD2 and ACMD41, NCC command
+    // to command without a response, NRC response to command, NWR response or
+    // busy to write data block
+    enum checks {CHECK_NCR, CHECK_NID, CHECK_NCC, CHECK_NRC, CHECK_NWR, CHECK_TIMEOUT,
+                 CHECK_COUNT};
+
+    // A bound that was not kept, or a command the card did not answer, over
+    // the gap from the end of the packet or block before to the next start bit
+    struct Violation
+    {
+        U32 mCheck;
+        U32 mCommand;
+        U32 mClocks;
+        U64 mStart;
+        U64 mEnd;
+    };
+
+    // Every decoded packet, raw holds its 48 bits unless it is a long
+    // response.  True if the gap before it breaks a bound.  The clocks are
+    // the numbers of the clock cycles of the start and end bit, 0 when the
+    // decoder does not count them.
+    bool AddPacket(bool host, bool long_packet, U64 raw, U64 start, U64 end, U64 start_clock, U64 end_clock,
+                   Violation &violation);
+    // Start bit of a write data block, true if it comes too soon
+    bool AddWriteBlock(U64 start, U64 start_clock, Violation &violation);
+    // End of the CRC status token and busy signal after a write data block
+    void EndWriteBlock(U64 end, U64 end_clock);
+    // Where the last write block ended, 0 if a packet came after it
+    U64 GetBlockEnd() const { return mBlockEnd; }
+
+    // A violation as the mData1 of a frame and back
+    static U64 Pack(const Violation &violation);
+    static void Unpack(U64 data, Violation &violation);
+
+    static const char* GetCheckName(U32 check);
+    // Clock cycles allowed, a maximum of 0 for none
+    static void GetBounds(U32 check, U32 &min_clocks, U32 &max_clocks);
+
+    // CSV with one line per command index seen and the totals
+    void Format(SDIOTextFormatter &text) const;
+
+    struct Command
+    {
+        U32 commands;
+        U32 responses;
+        U32 violations[CHECK_COUNT];
+        U32 minClocks;
+        U32 maxClocks;
+        U64 totalClocks;
+    };
+
+    const Command& GetCommand(U32 index) const { return mCommands[index]; }
+
+protected:
+    struct Gap
+    {
+        U64 start;
+        U64 end;
+        // The count, or the estimate and the range it may be off by
+        U32 clocks;
+        U32 fewest;
+        U32 most;
+        bool counted;
+    };
+    void Measure(U64 start, U64 end, U64 start_clock, U64 end_clock, Gap &gap) const;
+    bool Check(U32 check, U32 command, const Gap &gap, Violation &violation);
+
+    Command mCommands[64];
+    // The last two packets, for the clock period
+    U64 mLength[2];
+    U32 mBits[2];
+    U64 mLastEnd;
+    U64 mBlockEnd;
+    U64 mLastEndClock;
+    U64 mBlockEndClock;
+    U32 mLastCommand;
+    bool mAwaitingResponse;
+    bool mLastHost;
+    bool mApp;
+    bool mLastApp;
+};
+
+#endif //SDIO_RESPONSE_TIMING
@@ -0,0 +1,284 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOTextFormatter.h"
+#include "SDIODecoder.h"
+#include <AnalyzerHelpers.h>
+#include <string.h>
+
+SDIOTextFormatter::SDIOTextFormatter()
+:    mLength(0)
+{
+    mText[0] = '\0';
+}
+
+void SDIOTextFormatter::Clear()
+{
+    mLength = 0;
+    mText[0] = '\0';
+}
+
+void SDIOTextFormatter::Append(const char* str)
+{
+    Append(str, U32(strlen(str)));
+}
+
+void SDIOTextFormatter::Append(const char* str, U32 length)
+{
+    if (length > CAPACITY - 1 - mLength)
+        length = CAPACITY - 1 - mLength;
+
+    memcpy(mText + mLength, str, length);
+    mLength += length;
+    mText[mLength] = '\0';
+}
+
+void SDIOTextFormatter::AppendNumber(U64 number, DisplayBase display_base, U32 num_bits)
+{
+    mLength += FormatNumber(number, display_base, num_bits, mText + mLength, CAPACITY - mLength);
+}
+
+void SDIOTextFormatter::AppendDuration(U64 samples, U32 sample_rate)
+{
+    if (sample_rate == 0)
+        sample_rate = 1;
+
+    // Split so the multiplication cannot overflow for long captures
+    U64 ns = samples / sample_rate * 1000000000ULL + samples % sample_rate * 1000000000ULL / sample_rate;
+    U64 fraction = ns % 1000;
+    AppendNumber(ns / 1000, Decimal, 64);
+    char digits[5] = {'.', char('0' + fraction / 100), char('0' + fraction / 10 % 10), char('0' + fraction % 10), 0};
+    Append(digits);
+    Append(" us");
+}
+
+void SDIOTextFormatter::AppendDirection(bool host)
+{
+    Append(host ? "H->S" : "S->H", 4);
+}
+
+void SDIOTextFormatter::AppendBus(U32 bus)
+{
+    Append("Bus: ", 5);
+    AppendNumber(bus, Decimal, 8);
+    Append(" | ", 3);
+}
+
+U32 SDIOTextFormatter::FormatNumber(U64 number, DisplayBase display_base, U32 num_bits, char* result_string, U32 result_string_max_length)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    char str[80];
+    U32 length = 0;
+
+    //The ASCII modes are left to the SDK, it writes into the buffer as well
+    if (display_base == ASCII || display_base == AsciiHex)
+    {
+        if (result_string_max_length == 0)
+            return 0;
+        AnalyzerHelpers::GetNumberString(number, display_base, num_bits, result_string, result_string_max_length);
+        return U32(strlen(result_string));
+    }
+
+    if (num_bits == 0 || num_bits > 64)
+        num_bits = 64;
+    if (num_bits < 64)
+        number &= (1ULL << num_bits) - 1;
+
+    if (display_base == Decimal)
+    {
+        char digits[20];
+        U32 count = 0;
+        do {
+            digits[count++] = char('0' + number % 10);
+            number /= 10;
+        } while (number != 0);
+        while (count > 0)
+            str[length++] = digits[--count];
+    }
+    else if (display_base == Binary)
+    {
+        str[length++] = '0';
+        str[length++] = 'b';
+        for (U32 i = num_bits; i > 0; i--)
+            str[length++] = char('0' + ((number >> (i - 1)) & 0x1));
+    }
+    else
+    {
+        str[length++] = '0';
+        str[length++] = 'x';
+        for (U32 i = (num_bits + 3) / 4; i > 0; i--)
+            str[length++] = hex_digits[(number >> ((i - 1) * 4)) & 0xF];
+    }
+
+    if (result_string_max_length == 0)
+        return 0;
+    if (length > result_string_max_length - 1)
+        length = result_string_max_length - 1;
+    memcpy(result_string, str, length);
+    result_string[length] = '\0';
+    return length;
+}
+
+void SDIOTextFormatter::AppendField(U8 type, U64 data1, U64 data2, DisplayBase display_base)
+{
+    if (type == SDIODecoder::FRAME_DIR)
+    {
+        AppendDirection(data1 != 0);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD)
+    {
+        Append("CMD: ");
+        AppendNumber(data1, Decimal, 6);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_ARG)
+    {
+        Append("ARG: ");
+        AppendNumber(data1, display_base, 32);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_LONG_ARG)
+    {
+        Append("LARG: ");
+        AppendNumber(data1, display_base, 64);
+        Append(" ");
+        AppendNumber(data2, display_base, 64);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CRC)
+    {
+        Append("CRC: ");
+        AppendNumber(data1, Hexadecimal, 7);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD52_RWFLAG)
+    {
+        Append(data1 ? "W |" : "R |");
+    }
+    else if (type == SDIODecoder::FRAME_CMD52_FN)
+    {
+        Append("Func: ");
+        AppendNumber(data1, Decimal, 3);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD52_RAW)
+    {
+        Append("Read after write: ");
+        AppendNumber(data1, Decimal, 1);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD52_ADDR)
+    {
+        Append("Addr: ");
+        AppendNumber(data1, display_base, 17);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD52_DATA)
+    {
+        Append("Data: ");
+        AppendNumber(data1, Hexadecimal, 8);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD52_FLAGS)
+    {
+        Append("Response flags: ");
+        AppendNumber(data1, Binary, 8);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD53_BLOCK)
+    {
+        Append("Block mode: ");
+        AppendNumber(data1, Decimal, 1);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD53_OP)
+    {
+        Append("Op: ");
+        AppendNumber(data1, Decimal, 1);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_CMD53_COUNT)
+    {
+        Append("Count: ");
+        AppendNumber(data1, Decimal, 9);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_DATA_CRC)
+    {
+        Append("Data CRC16 error: ");
+        AppendNumber(data1, Binary, 8);
+        Append(" | ");
+    }
+    else if (type == SDIODecoder::FRAME_TIMING)
+    {
+        //"NCR: 70 clocks (2-64) | CMD: 52 | ", "NRC: 3 clocks (8+) | CMD: 52 | "
+        //or "Timeout: 120 clocks | CMD: 5 | "
+        SDIOResponseTiming::Violation violation;
+        SDIOResponseTiming::Unpack(data1, violation);
+        U32 min_clocks, max_clocks;
+        SDIOResponseTiming::GetBounds(violation.mCheck, min_clocks, max_clocks);
+        Append(SDIOResponseTiming::GetCheckName(violation.mCheck));
+        Append(": ");
+        AppendNumber(violation.mClocks, Decimal, 32);
+        Append(" clocks");
+        if (violation.mCheck != SDIOResponseTiming::CHECK_TIMEOUT)
+        {
+            Append(" (");
+            AppendNumber(min_clocks, Decimal, 32);
+            if (max_clocks == 0)
+            {
+                Append("+");
+            }
+            else if (max_clocks != min_clocks)
+            {
+                Append("-");
+                AppendNumber(max_clocks, Decimal, 32);
+            }
+            Append(")");
+        }
+        Append(" | CMD: ");
+        AppendNumber(violation.mCommand, Decimal, 6);
+        Append(" | ");
+    }
+    // Stuff bits are left out of the description
+}
+
+// "IRQ latency: 12.345 us | " from interrupt to the read of the interrupt
+// pending register, "Busy: 3.000 us | " for DAT0 busy
+void SDIOTextFormatter::AppendTiming(U8 type, U64 duration, U32 sample_rate)
+{
+    Append(type == SDIODecoder::FRAME_IRQ ? "IRQ latency: " : "Busy: ");
+    AppendDuration(duration, sample_rate);
+    Append(" | ");
+}
+
+void SDIOTextFormatter::AppendRepeat(U64 count, U64 intervals, U32 sample_rate)
+{
+    Append("Repeated: ");
+    AppendNumber(count, Decimal, 64);
+    Append("x | Interval: ");
+    AppendDuration(intervals & 0xFFFFFFFF, sample_rate);
+    Append(" - ");
+    AppendDuration(intervals >> 32, sample_rate);
+    Append(" | ");
+}
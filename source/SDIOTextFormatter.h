@@ -0,0 +1,67 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_TEXT_FORMATTER
+#define SDIO_TEXT_FORMATTER
+
+#include <LogicPublicTypes.h>
+
+// Formats frame fields into a fixed size buffer without allocating.  Shared by
+// the bubble text, the tabular text and the export so they all print numbers
+// the same way.  Text that does not fit is truncated.
+class SDIOTextFormatter
+{
+public:
+    SDIOTextFormatter();
+
+    void Clear();
+    const char* GetText() const { return mText; }
+    U32 GetLength() const { return mLength; }
+
+    void Append(const char* str);
+    void Append(const char* str, U32 length);
+    void AppendNumber(U64 number, DisplayBase display_base, U32 num_bits);
+    void AppendDirection(bool host);
+    // Bus of a packet when several buses share the clock, e.g. "Bus: 2 | "
+    void AppendBus(U32 bus);
+    // Samples as microseconds with 3 decimals, e.g. "12.345 us"
+    void AppendDuration(U64 samples, U32 sample_rate);
+
+    // Tabular/export description of a single field frame, e.g. "CMD: 52 | "
+    void AppendField(U8 type, U64 data1, U64 data2, DisplayBase display_base);
+    // Description of an IRQ or busy frame, e.g. "Busy: 3.000 us | "
+    void AppendTiming(U8 type, U64 duration, U32 sample_rate);
+    // Description of a run of polls, e.g. "Repeated: 120x | Interval: 1.000 us - 1.200 us | "
+    void AppendRepeat(U64 count, U64 intervals, U32 sample_rate);
+
+    // Same output as AnalyzerHelpers::GetNumberString(), which it calls for
+    // the ASCII modes
+    static U32 FormatNumber(U64 number, DisplayBase display_base, U32 num_bits, char* result_string, U32 result_string_max_length);
+
+    enum {CAPACITY = 2048};
+
+protected:
+    char mText[CAPACITY];
+    U32 mLength;
+};
+
+#endif //SDIO_TEXT_FORMATTER
@@ -0,0 +1,315 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIOTraceExport.h"
+#include "SDIOAnalyzerResults.h"
+#include "SDIOResponseTiming.h"
+#include "SDIOTextFormatter.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+SDIOTraceExport::SDIOTraceExport(std::ostream &file, U64 trigger_sample, U32 sample_rate, double offset)
+:    mFile(file),
+    mTriggerSample(trigger_sample),
+    mSampleRate(sample_rate == 0 ? 1 : sample_rate),
+    mOffset(offset),
+    mFirstEvent(true),
+    mLastSample(0)
+{
+    for (U32 bus = 0; bus < BUS_SLOTS; bus++)
+    {
+        Bus &state = mBuses[bus];
+        for (U32 fn = 0; fn < 8; fn++)
+            state.blockSize[fn] = 512;
+        state.cmd52Argument = 0;
+        state.cmd53Argument = 0;
+        state.cmd53Pending = false;
+        state.dataOpen = false;
+        state.dataStart = 0;
+        state.dataBytes = 0;
+        state.dataArgument = 0;
+    }
+}
+
+bool SDIOTraceExport::ParseOffset(const char* text, double &offset)
+{
+    offset = 0;
+    while (*text == ' ')
+        text++;
+    if (*text == 0)
+        return true;
+
+    char* next;
+    offset = strtod(text, &next);
+    while (*next == ' ')
+        next++;
+    return next != text && *next == 0;
+}
+
+//Process and thread names label the tracks
+void SDIOTraceExport::Begin(U32 buses)
+{
+    static const char* track_names[] = {"", "CMD", "Data", "Busy", "IRQ"};
+    char line[256];
+
+    Write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    U32 first = buses > 1 ? 1 : 0;
+    for (U32 bus = first; bus < first + buses && bus < BUS_SLOTS; bus++)
+    {
+        if (bus == 0)
+            snprintf(line, sizeof(line), "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"SDIO\"}}");
+        else
+            snprintf(line, sizeof(line), "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"SDIO bus %u\"}}",
+                     mFirstEvent ? "" : ",", bus + 1, bus);
+        Write(line);
+        mFirstEvent = false;
+        for (U32 track = TRACK_COMMANDS; track <= TRACK_IRQ; track++)
+        {
+            snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     bus + 1, track, track_names[track]);
+            Write(line);
+        }
+    }
+}
+
+void SDIOTraceExport::End()
+{
+    for (U32 bus = 0; bus < BUS_SLOTS; bus++)
+        CloseData(bus, mLastSample);
+    Write("\n]}\n");
+}
+
+void SDIOTraceExport::AddPacket(const Frame *frames, U32 count)
+{
+    //Every packet is of one bus
+    U32 bus = SDIOAnalyzerResults::GetFrameBus(frames[0]);
+    if (bus < BUS_SLOTS)
+        AddBusPacket(bus, frames, count);
+}
+
+void SDIOTraceExport::AddBusPacket(U32 bus, const Frame *frames, U32 count)
+{
+    const Frame &first = frames[0];
+    if (first.mType >= SDIODecoder::FRAME_IRQ)
+    {
+        for (U32 i = 0; i < count; i++)
+            AddTimedFrame(bus, frames[i]);
+        return;
+    }
+
+    //The fields of the packet, as the full decode would have added them
+    Frame packet_fields[SDIOAnalyzerResults::MAX_PACKET_FIELDS];
+    const Frame* fields = frames;
+    U32 field_count = count;
+    if (first.mType == SDIODecoder::FRAME_PACKET)
+    {
+        field_count = SDIOAnalyzerResults::ExpandPacketFrame(first, packet_fields);
+        fields = packet_fields;
+    }
+
+    bool host = false;
+    U32 index = 0;
+    U32 argument = 0;
+    for (U32 i = 0; i < field_count; i++)
+    {
+        const Frame &field = fields[i];
+        switch (field.mType)
+        {
+        case SDIODecoder::FRAME_DIR: host = field.mData1 != 0; break;
+        case SDIODecoder::FRAME_CMD: index = U32(field.mData1); break;
+        case SDIODecoder::FRAME_ARG: argument = U32(field.mData1); break;
+        case SDIODecoder::FRAME_CMD52_RWFLAG: argument |= U32(field.mData1) << 31; break;
+        case SDIODecoder::FRAME_CMD52_FN: argument |= U32(field.mData1) << 28; break;
+        case SDIODecoder::FRAME_CMD53_BLOCK: argument |= U32(field.mData1) << 27; break;
+        case SDIODecoder::FRAME_CMD52_ADDR: argument |= U32(field.mData1) << 9; break;
+        case SDIODecoder::FRAME_CMD52_DATA: argument |= U32(field.mData1); break;
+        case SDIODecoder::FRAME_CMD53_COUNT: argument |= U32(field.mData1); break;
+        }
+    }
+
+    U64 start = first.mStartingSampleInclusive;
+    U64 end = frames[count - 1].mEndingSampleInclusive;
+    Bus &state = mBuses[bus];
+    char name[32];
+    if (host)
+    {
+        //The data phase is over once the host sends the next command
+        CloseData(bus, start);
+        snprintf(name, sizeof(name), "CMD%u", index);
+        if (index == 52)
+        {
+            state.cmd52Argument = argument;
+            if ((argument >> 31) && ((argument >> 28) & 0x7) == 0)
+                TrackRegister(state, (argument >> 9) & 0x1FFFF, U8(argument));
+        }
+        state.cmd53Pending = index == 53;
+        if (index == 53)
+            state.cmd53Argument = argument;
+    }
+    else
+    {
+        if (index == 63)
+            snprintf(name, sizeof(name), "Response");
+        else
+            snprintf(name, sizeof(name), "CMD%u response", index);
+
+        //Registers read back tell as much as the writes
+        if (index == 52 && !(state.cmd52Argument >> 31) && ((state.cmd52Argument >> 28) & 0x7) == 0)
+            TrackRegister(state, (state.cmd52Argument >> 9) & 0x1FFFF, U8(argument));
+        if (index == 53 && state.cmd53Pending)
+        {
+            U32 arg = state.cmd53Argument;
+            U32 fn = (arg >> 28) & 0x7;
+            U32 blocks = arg & 0x1FF;
+            CloseData(bus, end);
+            state.dataOpen = true;
+            state.dataStart = end + 1;
+            state.dataArgument = arg;
+            //A block count of 0 runs until it is stopped, its size is not known
+            if ((arg >> 27) & 0x1)
+                state.dataBytes = U64(blocks) * state.blockSize[fn];
+            else
+                state.dataBytes = blocks == 0 ? 512 : blocks;
+        }
+        state.cmd53Pending = false;
+    }
+
+    SDIOTextFormatter text;
+    for (U32 i = 0; i < count; i++)
+        SDIOAnalyzerResults::AppendFrameDescription(frames[i], Hexadecimal, mSampleRate, text);
+
+    char args[SDIOTextFormatter::CAPACITY + 32];
+    snprintf(args, sizeof(args), "{\"fields\":\"%s\"}", text.GetText());
+    WriteSlice(name, bus, TRACK_COMMANDS, start, end, args);
+}
+
+void SDIOTraceExport::AddTimedFrame(U32 bus, const Frame &frame)
+{
+    char args[128];
+    switch (frame.mType)
+    {
+    case SDIODecoder::FRAME_IRQ:
+    case SDIODecoder::FRAME_BUSY:
+    {
+        bool irq = frame.mType == SDIODecoder::FRAME_IRQ;
+        WriteSlice(irq ? "IRQ" : "Busy", bus, irq ? TRACK_IRQ : TRACK_BUSY, frame.mData2, frame.mData2 + frame.mData1, "{}");
+        break;
+    }
+    case SDIODecoder::FRAME_REPEAT:
+        snprintf(args, sizeof(args), "{\"count\":%llu}", (unsigned long long)frame.mData1);
+        WriteSlice("CMD52 polls", bus, TRACK_COMMANDS, frame.mStartingSampleInclusive, frame.mEndingSampleInclusive, args);
+        break;
+    case SDIODecoder::FRAME_DATA_CRC:
+        snprintf(args, sizeof(args), "{\"lines\":%llu}", (unsigned long long)frame.mData1);
+        BeginEvent("CRC16 error", "i", bus, TRACK_DATA, frame.mStartingSampleInclusive);
+        EndEvent(args);
+        break;
+    case SDIODecoder::FRAME_TIMING:
+    {
+        SDIOResponseTiming::Violation violation;
+        SDIOResponseTiming::Unpack(frame.mData1, violation);
+        snprintf(args, sizeof(args), "{\"command\":%u,\"clocks\":%u}", violation.mCommand, violation.mClocks);
+        WriteSlice(SDIOResponseTiming::GetCheckName(violation.mCheck), bus, TRACK_COMMANDS,
+                   frame.mStartingSampleInclusive, frame.mEndingSampleInclusive, args);
+        break;
+    }
+    }
+}
+
+//Block size of function 0 in the CCCR, of functions 1-7 in their FBR
+void SDIOTraceExport::TrackRegister(Bus &state, U32 address, U8 value)
+{
+    if ((address & 0xFF) != 0x10 && (address & 0xFF) != 0x11)
+        return;
+    U32 fn = address >> 8;
+    if (fn >= 8)
+        return;
+    if (address & 0x1)
+        state.blockSize[fn] = (state.blockSize[fn] & 0x00FF) | (value << 8);
+    else
+        state.blockSize[fn] = (state.blockSize[fn] & 0xFF00) | value;
+}
+
+void SDIOTraceExport::CloseData(U32 bus, U64 end)
+{
+    Bus &state = mBuses[bus];
+    if (!state.dataOpen)
+        return;
+    state.dataOpen = false;
+    if (end <= state.dataStart)
+        return;
+
+    U32 arg = state.dataArgument;
+    char args[128];
+    snprintf(args, sizeof(args), "{\"function\":%u,\"write\":%u,\"address\":%u,\"bytes\":%llu}",
+             (arg >> 28) & 0x7, arg >> 31, (arg >> 9) & 0x1FFFF, (unsigned long long)state.dataBytes);
+    WriteSlice((arg >> 31) ? "CMD53 write" : "CMD53 read", bus, TRACK_DATA, state.dataStart, end, args);
+
+    //Bytes over the whole phase, back to 0 after it
+    if (state.dataBytes == 0)
+        return;
+    double seconds = double(end - state.dataStart) / mSampleRate;
+    WriteCounter(bus, state.dataStart, state.dataBytes / seconds / 1e6);
+    WriteCounter(bus, end, 0);
+}
+
+void SDIOTraceExport::BeginEvent(const char* name, const char* phase, U32 bus, U32 track, U64 sample)
+{
+    double us = double(S64(sample - mTriggerSample)) * 1e6 / mSampleRate + mOffset * 1e6;
+    char line[256];
+    snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f",
+             mFirstEvent ? "" : ",", name, phase, bus + 1, track, us);
+    Write(line);
+    mFirstEvent = false;
+    if (sample > mLastSample)
+        mLastSample = sample;
+}
+
+void SDIOTraceExport::EndEvent(const char* args)
+{
+    Write(",\"args\":");
+    Write(args);
+    Write("}");
+}
+
+void SDIOTraceExport::WriteSlice(const char* name, U32 bus, U32 track, U64 start, U64 end, const char* args)
+{
+    BeginEvent(name, "X", bus, track, start);
+    char duration[64];
+    snprintf(duration, sizeof(duration), ",\"dur\":%.3f", double(end - start) * 1e6 / mSampleRate);
+    Write(duration);
+    EndEvent(args);
+    if (end > mLastSample)
+        mLastSample = end;
+}
+
+void SDIOTraceExport::WriteCounter(U32 bus, U64 sample, double value)
+{
+    char args[64];
+    snprintf(args, sizeof(args), "{\"MB/s\":%.3f}", value);
+    BeginEvent("Throughput", "C", bus, 0, sample);
+    EndEvent(args);
+}
+
+void SDIOTraceExport::Write(const char* text)
+{
+    mFile << text;
+}
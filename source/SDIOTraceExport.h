@@ -0,0 +1,92 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_TRACE_EXPORT
+#define SDIO_TRACE_EXPORT
+
+#include <AnalyzerResults.h>
+#include <ostream>
+#include "SDIOMultiBusDecoder.h"
+
+// Writes the packets of the results as trace events in the Chrome JSON trace
+// format, which Perfetto and chrome://tracing open next to ftrace and perf
+// captures of the host.  Each bus is a process with tracks for commands and
+// responses, data phases, busy signals and interrupts, and a throughput
+// counter.  The events are written as the packets are added, only the data
+// phase still open is held.
+//
+// A data phase runs from the end of a CMD53 response to the next command on
+// the bus, the results do not keep the data blocks themselves.
+class SDIOTraceExport
+{
+public:
+    // Timestamps are in microseconds from the trigger plus offset seconds
+    SDIOTraceExport(std::ostream &file, U64 trigger_sample, U32 sample_rate, double offset);
+
+    void Begin(U32 buses);
+    // The frames of one results packet
+    void AddPacket(const Frame *frames, U32 count);
+    void End();
+
+    // Seconds, an empty text is 0
+    static bool ParseOffset(const char* text, double &offset);
+
+    enum tracks {TRACK_COMMANDS = 1, TRACK_DATA, TRACK_BUSY, TRACK_IRQ};
+
+protected:
+    struct Bus
+    {
+        U32 blockSize[8];
+        // Last CMD52 and CMD53 command, for the response after them
+        U32 cmd52Argument;
+        U32 cmd53Argument;
+        bool cmd53Pending;
+        // Data phase after a CMD53 response
+        bool dataOpen;
+        U64 dataStart;
+        U64 dataBytes;
+        U32 dataArgument;
+    };
+
+    void AddBusPacket(U32 bus, const Frame *frames, U32 count);
+    void AddTimedFrame(U32 bus, const Frame &frame);
+    void TrackRegister(Bus &state, U32 address, U8 value);
+    void CloseData(U32 bus, U64 end);
+
+    void BeginEvent(const char* name, const char* phase, U32 bus, U32 track, U64 sample);
+    void EndEvent(const char* args);
+    void WriteSlice(const char* name, U32 bus, U32 track, U64 start, U64 end, const char* args);
+    void WriteCounter(U32 bus, U64 sample, double value);
+    void Write(const char* text);
+
+    std::ostream &mFile;
+    U64 mTriggerSample;
+    U32 mSampleRate;
+    double mOffset;
+    bool mFirstEvent;
+    U64 mLastSample;
+    // Frames of a single bus are bus 0, with several they count from 1
+    enum {BUS_SLOTS = SDIOMultiBusDecoder::MAX_BUSES + 1};
+    Bus mBuses[BUS_SLOTS];
+};
+
+#endif //SDIO_TRACE_EXPORT
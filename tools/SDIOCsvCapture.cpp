@@ -0,0 +1,196 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIOCsvCapture.h"
+#include <stdlib.h>
+
+SDIOCsvChannel::SDIOCsvChannel()
+:    mFile(nullptr),
+    mColumn(0),
+    mOrigin(0.0),
+    mSampleRate(1.0),
+    mSample(0),
+    mState(BIT_LOW),
+    mMore(false),
+    mNextSample(0),
+    mLastSample(0)
+{
+}
+
+SDIOCsvChannel::~SDIOCsvChannel()
+{
+    Close();
+}
+
+bool SDIOCsvChannel::Open(const char* file_name, U32 column, double sample_rate)
+{
+    Close();
+
+    mFile = fopen(file_name, "rb");
+    if (mFile == nullptr)
+        return false;
+    setvbuf(mFile, nullptr, _IOFBF, BUFFER_SIZE);
+    mColumn = column;
+    mSampleRate = sample_rate;
+
+    //The first row with a time sets the origin, the header has none
+    char line[LINE_SIZE];
+    char* end = line;
+    while (end == line && fgets(line, sizeof(line), mFile) != nullptr)
+        mOrigin = strtod(line, &end);
+    rewind(mFile);
+
+    U64 sample;
+    if (!ReadRow(sample, mState))
+    {
+        Close();
+        return false;
+    }
+    mSample = 0;
+    mLastSample = 0;
+    FindNextEdge();
+    return true;
+}
+
+void SDIOCsvChannel::Close()
+{
+    if (mFile != nullptr)
+        fclose(mFile);
+    mFile = nullptr;
+    mMore = false;
+}
+
+//False at the end of the file.  Rows without this column are skipped.
+bool SDIOCsvChannel::ReadRow(U64 &sample, BitState &state)
+{
+    char line[LINE_SIZE];
+    while (fgets(line, sizeof(line), mFile) != nullptr)
+    {
+        char* field;
+        double time = strtod(line, &field);
+        if (field == line)
+            continue;
+
+        U32 column = 0;
+        for (char* c = field; *c != 0 && *c != '\n'; c++)
+        {
+            if (*c != ',')
+                continue;
+            if (column++ != mColumn)
+                continue;
+            while (*++c == ' ')
+                ;
+            double offset = (time - mOrigin) * mSampleRate + 0.5;
+            sample = offset > 0.0 ? U64(offset) : 0;
+            state = *c == '1' ? BIT_HIGH : BIT_LOW;
+            mLastSample = sample;
+            return true;
+        }
+    }
+    return false;
+}
+
+//Reads ahead to the next row where this column changes.  A pulse shorter
+//than a sample cancels out.
+void SDIOCsvChannel::FindNextEdge()
+{
+    U64 sample;
+    BitState state;
+    BitState current = mState;
+    while (ReadRow(sample, state))
+    {
+        if (state == current)
+            continue;
+        if (sample <= mSample)
+        {
+            mState = current = state;
+            continue;
+        }
+        mMore = true;
+        mNextSample = sample;
+        return;
+    }
+    mMore = false;
+    mNextSample = mLastSample;
+}
+
+void SDIOCsvChannel::AdvanceToNextEdge()
+{
+    if (!mMore)
+    {
+        mSample = mLastSample;
+        return;
+    }
+    mSample = mNextSample;
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+    FindNextEdge();
+}
+
+void SDIOCsvChannel::AdvanceToAbsPosition(U64 sample)
+{
+    if (sample <= mSample)
+        return;
+    while (mMore && mNextSample <= sample)
+    {
+        mSample = mNextSample;
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        FindNextEdge();
+    }
+    mSample = sample;
+}
+
+U64 SDIOCsvChannel::GetSampleOfNextEdge()
+{
+    return mNextSample;
+}
+
+bool SDIOCsvChannel::WouldAdvancingToAbsPositionCauseTransition(U64 sample)
+{
+    return mMore && mNextSample <= sample;
+}
+
+bool SDIOCsvChannel::DoMoreTransitionsExistInCurrentData()
+{
+    return mMore;
+}
+
+bool SDIOCsvCapture::Open(const char* file_name, const U32* columns, U32 count, double sample_rate)
+{
+    Close();
+    if (count > MAX_CHANNELS)
+        return false;
+
+    for (U32 i = 0; i < count; i++)
+    {
+        if (columns[i] != NO_CHANNEL && !mChannels[i].Open(file_name, columns[i], sample_rate))
+        {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SDIOCsvCapture::Close()
+{
+    for (U32 i = 0; i < MAX_CHANNELS; i++)
+        mChannels[i].Close();
+}
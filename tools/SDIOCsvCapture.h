@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_CSV_CAPTURE
+#define SDIO_CSV_CAPTURE
+
+#include <LogicPublicTypes.h>
+#include <stdio.h>
+
+// One column of a Logic CSV export, "Time [s],Channel 0,Channel 1,..." with a
+// row for every change of any channel.  Each channel reads the file on its
+// own, front to back, so memory does not grow with the size of the capture.
+//
+// Times are converted to sample numbers at the given sample rate, counted
+// from the first row.  The cursor methods behave like the AnalyzerChannelData
+// ones the plugin uses, except that they never block: past the last change
+// the cursor stops at the last row.
+class SDIOCsvChannel
+{
+public:
+    SDIOCsvChannel();
+    ~SDIOCsvChannel();
+
+    // column 0 is the first channel after the time
+    bool Open(const char* file_name, U32 column, double sample_rate);
+    void Close();
+    bool IsOpen() const { return mFile != nullptr; }
+
+    double GetOrigin() const { return mOrigin; }
+
+    // AnalyzerChannelData compatible cursor
+    U64 GetSampleNumber() const { return mSample; }
+    BitState GetBitState() const { return mState; }
+    void AdvanceToNextEdge();
+    void AdvanceToAbsPosition(U64 sample);
+    U64 GetSampleOfNextEdge();
+    bool WouldAdvancingToAbsPositionCauseTransition(U64 sample);
+    bool DoMoreTransitionsExistInCurrentData();
+
+    enum {LINE_SIZE = 4096, BUFFER_SIZE = 1 << 16};
+
+protected:
+    bool ReadRow(U64 &sample, BitState &state);
+    void FindNextEdge();
+
+    FILE* mFile;
+    U32 mColumn;
+    double mOrigin;
+    double mSampleRate;
+
+    U64 mSample;
+    BitState mState;
+    bool mMore;
+    U64 mNextSample;
+    U64 mLastSample;
+};
+
+// The columns of a CSV export in the roles the decoder needs them in, all
+// read from the same file
+class SDIOCsvCapture
+{
+public:
+    enum {MAX_CHANNELS = 8, NO_CHANNEL = 0xFFFFFFFF};
+
+    // columns[i] is the column of channel i or NO_CHANNEL
+    bool Open(const char* file_name, const U32* columns, U32 count, double sample_rate);
+    void Close();
+
+    // nullptr for a channel without a column
+    SDIOCsvChannel* GetChannel(U32 index) { return mChannels[index].IsOpen() ? &mChannels[index] : nullptr; }
+    double GetOrigin() const { return mChannels[0].GetOrigin(); }
+
+protected:
+    SDIOCsvChannel mChannels[MAX_CHANNELS];
+};
+
+#endif //SDIO_CSV_CAPTURE
@@ -0,0 +1,867 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// sdio-decode, decodes exported captures outside of Logic with the same
+// decoder as the plugin and writes the same packet descriptions as its text
+// export, or one JSON object per packet.  Packets are written as they are
+// decoded, so memory does not grow with the capture.  A folder of captures is
+// decoded with one worker per core.  --diff compares the transactions of two
+// captures instead, see SDIOTraceDiff.
+
+#include "SDIODecoder.h"
+#include "SDIOTextFormatter.h"
+#include "SDIOTransitionCapture.h"
+#include "SDIOCsvCapture.h"
+#include "SDIOPackedCapture.h"
+#include "SDIOTraceDiff.h"
+#include "SDIODecodeCache.h"
+#include "SDIOMappedFile.h"
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+enum roles {ROLE_CLOCK, ROLE_CMD, ROLE_DAT0, ROLE_DAT1, ROLE_DAT2, ROLE_DAT3, ROLE_COUNT};
+enum formats {FORMAT_TEXT, FORMAT_JSON};
+enum {NO_CHANNEL = 0xFFFFFFFF};
+
+struct Config
+{
+    U32 channels[ROLE_COUNT];
+    double sampleRate;
+    U32 rawBytes;
+    U32 format;
+    DisplayBase displayBase;
+    U32 workers;
+    std::string output;
+    SDIODecodeOptions options;
+    bool diff;
+    U32 diffWindow;
+    U32 diffTop;
+    std::string checkpointFile;
+    std::string cacheDirectory;
+};
+
+struct Job
+{
+    std::string input;
+    std::string output;
+};
+
+static const char* sUsage =
+    "usage: sdio-decode [options] <capture>...\n"
+    "       sdio-decode --diff [options] <before> <after>\n"
+    "\n"
+    "A capture is a Logic 2 binary export folder (digital_<n>.bin), a CSV export\n"
+    "(.csv, one column per channel after the time) or, with --raw, a raw binary\n"
+    "export with a word per sample.  A folder holding several captures decodes\n"
+    "all of them, in parallel.\n"
+    "\n"
+    "  --channels c,cmd,d0[,d1,d2,d3]  channel of each line, default 0,1,2,3,4,5\n"
+    "  --rate <Hz>                     sample rate, default 500000000\n"
+    "  --raw <bytes>                   raw export with 1, 2, 4 or 8 bytes per sample\n"
+    "  --format text|json              default text, json writes a line per packet\n"
+    "  --base hex|dec|bin              number format of the text, default hex\n"
+    "  --commands <filter>             e.g. 52,53 or !52\n"
+    "  --function <n>                  only CMD52/CMD53 packets of function n\n"
+    "  --range <start-end>             only packets starting in this sample range\n"
+    "  --collapse                      one line for identical CMD52 polls in a row\n"
+    "  --timing                        a line for each response timeout and gap\n"
+    "                                  outside of the NCR/NID/NCC/NRC/NWR bounds\n"
+    "  --payload <folder>              write the CMD53 data of a single capture\n"
+    "  --checkpoints <file>            keep decoder checkpoints of a single capture\n"
+    "                                  in this file, a later --range starts from\n"
+    "                                  the nearest one instead of sample 0\n"
+    "  --checkpoint-interval <n>       packets between checkpoints, default 4096\n"
+    "  --cache <folder>                keep the decoded packets of each capture in\n"
+    "                                  this folder, a later run over the same data\n"
+    "                                  with the same options loads them instead\n"
+    "  -o <file|folder>                output file, the folder for several captures\n"
+    "  -j <n>                          workers, default one per core\n"
+    "\n"
+    "  --diff                          align the transactions of two captures and\n"
+    "                                  report the time the second one loses\n"
+    "  --top <n>                       rows per section of the report, default 20\n"
+    "  --window <n>                    transactions aligned at a time, default 4096\n";
+
+// Collects the frames of a packet and writes it out when it is committed
+class PacketWriter : public SDIOFrameSink
+{
+public:
+    PacketWriter(FILE* file, const Config &config, double origin)
+    :    mFile(file),
+        mConfig(config),
+        mOrigin(origin),
+        mCount(0)
+    {
+        if (mConfig.format == FORMAT_TEXT)
+            fputs("Time [s],Value\n", mFile);
+    }
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        if (mCount < SDIODecoder::MAX_PACKET_FIELDS)
+            mFrames[mCount++] = frame;
+    }
+
+    virtual void AddMarker(U64 /*sample*/)
+    {
+    }
+
+    virtual void CommitPacket()
+    {
+        if (mCount == 0)
+            return;
+        if (mConfig.format == FORMAT_JSON)
+            WriteJson();
+        else
+            WriteText();
+        mCount = 0;
+    }
+
+    virtual void CommitResults()
+    {
+    }
+
+protected:
+    U64 PacketStart() const
+    {
+        const SDIOFrame &first = mFrames[0];
+        if (first.mType == SDIODecoder::FRAME_IRQ || first.mType == SDIODecoder::FRAME_BUSY)
+            return first.mData2;
+        return first.mStartingSampleInclusive;
+    }
+
+    void AppendTime(SDIOTextFormatter &text, U64 sample)
+    {
+        char time_str[64];
+        snprintf(time_str, sizeof(time_str), "%.9f", mOrigin + sample / mConfig.sampleRate);
+        text.Append(time_str);
+    }
+
+    void AppendDescription(SDIOTextFormatter &text, DisplayBase display_base)
+    {
+        U32 sample_rate = U32(mConfig.sampleRate);
+        for (U32 i = 0; i < mCount; i++)
+        {
+            const SDIOFrame &frame = mFrames[i];
+            if (frame.mType == SDIODecoder::FRAME_IRQ || frame.mType == SDIODecoder::FRAME_BUSY)
+                text.AppendTiming(frame.mType, frame.mData1, sample_rate);
+            else if (frame.mType == SDIODecoder::FRAME_REPEAT)
+                text.AppendRepeat(frame.mData1, frame.mData2, sample_rate);
+            else
+                text.AppendField(frame.mType, frame.mData1, frame.mData2, display_base);
+        }
+    }
+
+    // Same line as the plugin's text export
+    void WriteText()
+    {
+        SDIOTextFormatter text;
+        AppendTime(text, PacketStart());
+        text.Append(", ");
+        AppendDescription(text, mConfig.displayBase);
+        text.Append("\n");
+        fwrite(text.GetText(), 1, text.GetLength(), mFile);
+    }
+
+    void AppendKey(SDIOTextFormatter &text, const char* key, U64 value)
+    {
+        text.Append(",\"");
+        text.Append(key);
+        text.Append("\":");
+        text.AppendNumber(value, Decimal, 64);
+    }
+
+    // {"time":..,"start":..,"end":..,"type":"packet", one key per field, "text":..}
+    void WriteJson()
+    {
+        static const char* keys[] = {"host", "command", "argument", "argument", "crc",
+            "write", "function", "raw", nullptr, "address", "data", "flags",
+            "block_mode", "op_code", "count", nullptr, "duration", "duration", nullptr, "crc_error_lines"};
+
+        SDIOTextFormatter text;
+        text.Append("{\"time\":");
+        AppendTime(text, PacketStart());
+        AppendKey(text, "start", mFrames[0].mStartingSampleInclusive);
+        AppendKey(text, "end", mFrames[mCount - 1].mEndingSampleInclusive);
+        U8 type = mFrames[0].mType;
+        text.Append(type == SDIODecoder::FRAME_IRQ ? ",\"type\":\"irq\"" :
+                    type == SDIODecoder::FRAME_BUSY ? ",\"type\":\"busy\"" :
+                    type == SDIODecoder::FRAME_REPEAT ? ",\"type\":\"repeat\"" :
+                    type == SDIODecoder::FRAME_DATA_CRC ? ",\"type\":\"data_crc\"" :
+                    type == SDIODecoder::FRAME_TIMING ? ",\"type\":\"timing\"" : ",\"type\":\"packet\"");
+
+        for (U32 i = 0; i < mCount; i++)
+        {
+            const SDIOFrame &frame = mFrames[i];
+            if (frame.mType == SDIODecoder::FRAME_LONG_ARG)
+            {
+                //127 bits, given as the upper 64 and lower 63 bits
+                text.Append(",\"argument_high\":\"");
+                text.AppendNumber(frame.mData1, Hexadecimal, 64);
+                text.Append("\",\"argument_low\":\"");
+                text.AppendNumber(frame.mData2, Hexadecimal, 64);
+                text.Append("\"");
+            }
+            else if (frame.mType == SDIODecoder::FRAME_REPEAT)
+            {
+                //Intervals from one command of the run to the next, in samples
+                AppendKey(text, "count", frame.mData1);
+                AppendKey(text, "min_interval", frame.mData2 & 0xFFFFFFFF);
+                AppendKey(text, "max_interval", frame.mData2 >> 32);
+            }
+            else if (frame.mType == SDIODecoder::FRAME_TIMING)
+            {
+                SDIOResponseTiming::Violation violation;
+                SDIOResponseTiming::Unpack(frame.mData1, violation);
+                text.Append(",\"check\":\"");
+                text.Append(SDIOResponseTiming::GetCheckName(violation.mCheck));
+                text.Append("\"");
+                AppendKey(text, "command", violation.mCommand);
+                AppendKey(text, "clocks", violation.mClocks);
+            }
+            else if (frame.mType < sizeof(keys) / sizeof(keys[0]) && keys[frame.mType] != nullptr)
+            {
+                AppendKey(text, keys[frame.mType], frame.mData1);
+            }
+        }
+
+        //The description only holds characters that need no escaping
+        text.Append(",\"text\":\"");
+        AppendDescription(text, Hexadecimal);
+        text.Append("\"}\n");
+        fwrite(text.GetText(), 1, text.GetLength(), mFile);
+    }
+
+    FILE* mFile;
+    const Config &mConfig;
+    double mOrigin;
+    SDIOFrame mFrames[SDIODecoder::MAX_PACKET_FIELDS];
+    U32 mCount;
+};
+
+static bool IsDirectory(const std::string &path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+static bool FileExists(const std::string &path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file != nullptr)
+        fclose(file);
+    return file != nullptr;
+}
+
+static bool EndsWith(const std::string &text, const char* suffix)
+{
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+static std::vector<std::string> ListDirectory(const std::string &directory)
+{
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE)
+        return names;
+    do
+    {
+        if (entry.cFileName[0] != '.')
+            names.push_back(entry.cFileName);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return names;
+    while (struct dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] != '.')
+            names.push_back(entry->d_name);
+    }
+    closedir(dir);
+#endif
+    return names;
+}
+
+// A folder is a single capture when it holds the clock of a binary export
+static bool IsTransitionCapture(const std::string &path, const Config &config)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/digital_%u.bin", config.channels[ROLE_CLOCK]);
+    return IsDirectory(path) && FileExists(path + name);
+}
+
+static bool IsCapture(const std::string &path, const Config &config)
+{
+    if (IsDirectory(path))
+        return IsTransitionCapture(path, config);
+    return config.rawBytes != 0 ? EndsWith(path, ".bin") : EndsWith(path, ".csv");
+}
+
+static std::string BaseName(const std::string &path)
+{
+    std::string name = path;
+    while (!name.empty() && (name[name.size() - 1] == '/' || name[name.size() - 1] == '\\'))
+        name.erase(name.size() - 1);
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos)
+        name = name.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+        name = name.substr(0, dot);
+    return name;
+}
+
+// The lines of a capture in the roles the decoder needs them in
+struct Capture
+{
+    SDIOTransitionCapture transitions;
+    SDIOCsvCapture csv;
+    SDIOPackedCapture packed;
+    SDIOChannelAdapter< SDIOTransitionChannel > transitionLines[ROLE_COUNT];
+    SDIOChannelAdapter< SDIOCsvChannel > csvLines[ROLE_COUNT];
+    SDIOChannelAdapter< SDIOPackedChannel > packedLines[ROLE_COUNT];
+    SDIOChannel* lines[ROLE_COUNT];
+    double origin;
+
+    bool Open(const std::string &input, const Config &config)
+    {
+        bool opened;
+        origin = 0.0;
+        if (IsDirectory(input))
+        {
+            opened = transitions.Open(input.c_str(), config.channels, config.sampleRate);
+            for (U32 role = 0; opened && role < ROLE_COUNT; role++)
+            {
+                transitionLines[role].SetChannel(transitions.GetChannel(role));
+                lines[role] = transitionLines[role].Get();
+            }
+            origin = transitions.GetOrigin();
+        }
+        else if (config.rawBytes != 0)
+        {
+            opened = packed.Load(input.c_str(), config.rawBytes);
+            for (U32 role = 0; opened && role < ROLE_COUNT; role++)
+            {
+                packedLines[role].SetChannel(config.channels[role] == NO_CHANNEL ? nullptr : packed.GetChannel(config.channels[role]));
+                lines[role] = packedLines[role].Get();
+                opened = role > ROLE_DAT0 || lines[role] != nullptr;
+            }
+        }
+        else
+        {
+            opened = csv.Open(input.c_str(), config.channels, ROLE_COUNT, config.sampleRate);
+            for (U32 role = 0; opened && role < ROLE_COUNT; role++)
+            {
+                csvLines[role].SetChannel(csv.GetChannel(role));
+                lines[role] = csvLines[role].Get();
+            }
+            if (opened)
+                origin = csv.GetOrigin();
+        }
+        if (!opened)
+            fprintf(stderr, "sdio-decode: cannot read %s\n", input.c_str());
+        return opened;
+    }
+};
+
+static FILE* OpenOutput(const std::string &output)
+{
+    FILE* file = output.empty() ? stdout : fopen(output.c_str(), "wb");
+    if (file == nullptr)
+        fprintf(stderr, "sdio-decode: cannot write %s\n", output.c_str());
+    else
+        setvbuf(file, nullptr, _IOFBF, 1 << 16);
+    return file;
+}
+
+static bool CloseOutput(FILE* file, const std::string &output)
+{
+    bool written = fflush(file) == 0;
+    if (file != stdout)
+        written = fclose(file) == 0 && written;
+    if (!written)
+        fprintf(stderr, "sdio-decode: cannot write %s\n", output.c_str());
+    return written;
+}
+
+// Checkpoint file: header, then the checkpoints as they are in memory.  Only
+// read back by the same build with the same channels and sample rate.
+struct CheckpointHeader
+{
+    char magic[8];
+    U32 size;
+    U32 channels[ROLE_COUNT];
+    double sampleRate;
+    U64 count;
+};
+
+static void FillCheckpointHeader(CheckpointHeader &header, const Config &config, U64 count)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SDIOCKPT", 8);
+    header.size = sizeof(SDIODecoderCheckpoint);
+    memcpy(header.channels, config.channels, sizeof(header.channels));
+    header.sampleRate = config.sampleRate;
+    header.count = count;
+}
+
+static void LoadCheckpoints(const Config &config, std::vector<SDIODecoderCheckpoint> &checkpoints)
+{
+    FILE* file = fopen(config.checkpointFile.c_str(), "rb");
+    if (file == nullptr)
+        return;
+    CheckpointHeader header, expected;
+    if (fread(&header, sizeof(header), 1, file) == 1)
+    {
+        FillCheckpointHeader(expected, config, header.count);
+        if (memcmp(&header, &expected, sizeof(header)) == 0)
+        {
+            checkpoints.resize(size_t(header.count));
+            if (!checkpoints.empty() && fread(&checkpoints[0], sizeof(SDIODecoderCheckpoint), checkpoints.size(), file) != checkpoints.size())
+                checkpoints.clear();
+        }
+    }
+    fclose(file);
+}
+
+static void SaveCheckpoints(const Config &config, const std::vector<SDIODecoderCheckpoint> &checkpoints)
+{
+    FILE* file = fopen(config.checkpointFile.c_str(), "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "sdio-decode: cannot write %s\n", config.checkpointFile.c_str());
+        return;
+    }
+    CheckpointHeader header;
+    FillCheckpointHeader(header, config, checkpoints.size());
+    fwrite(&header, sizeof(header), 1, file);
+    if (!checkpoints.empty())
+        fwrite(&checkpoints[0], sizeof(SDIODecoderCheckpoint), checkpoints.size(), file);
+    fclose(file);
+}
+
+// Passes the decoded frames on and keeps them in a cache file
+class CacheRecorder : public SDIOFrameSink
+{
+public:
+    CacheRecorder(SDIOFrameSink &sink)
+    :    mSink(sink)
+    {
+    }
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        mSink.AddFrame(frame);
+        mCache.AddFrame(frame);
+    }
+
+    virtual void AddMarker(U64 sample)
+    {
+        mSink.AddMarker(sample);
+        mCache.AddMarker(sample);
+    }
+
+    virtual void CommitPacket()
+    {
+        mSink.CommitPacket();
+        mCache.CommitPacket();
+    }
+
+    virtual void CommitResults()
+    {
+        mSink.CommitResults();
+    }
+
+    virtual void AddCheckpoint(const SDIODecoderCheckpoint &checkpoint)
+    {
+        mCache.AddCheckpoint(checkpoint);
+    }
+
+    SDIODecodeCacheWriter mCache;
+
+protected:
+    SDIOFrameSink &mSink;
+};
+
+// The bytes of the capture files and every option the packets depend on
+static U64 CacheKey(const std::string &input, const Config &config)
+{
+    const SDIODecodeOptions &options = config.options;
+    char settings[256];
+    snprintf(settings, sizeof(settings), "%u,%u,%u,%u,%u,%u %.17g %u %d %d %d %llx %u %llu-%llu",
+             config.channels[ROLE_CLOCK], config.channels[ROLE_CMD], config.channels[ROLE_DAT0],
+             config.channels[ROLE_DAT1], config.channels[ROLE_DAT2], config.channels[ROLE_DAT3],
+             config.sampleRate, config.rawBytes, int(options.mOverview), int(options.mCollapsePolls),
+             int(options.mCheckTiming),
+             (unsigned long long)options.mCommandMask, options.mFunctionFilter,
+             (unsigned long long)options.mStartSample, (unsigned long long)options.mEndSample);
+    U64 key = SDIODecodeCache::Hash(settings, strlen(settings), 0);
+
+    std::vector<std::string> files;
+    if (IsDirectory(input))
+    {
+        for (U32 role = 0; role < ROLE_COUNT; role++)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "/digital_%u.bin", config.channels[role]);
+            if (config.channels[role] != NO_CHANNEL)
+                files.push_back(input + name);
+        }
+    }
+    else
+    {
+        files.push_back(input);
+    }
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        SDIOMappedFile map;
+        map.Open(files[i].c_str());
+        key = SDIODecodeCache::Hash(map.GetData(), size_t(map.GetSize()), key);
+    }
+    return key;
+}
+
+// Writes the packets of a complete cache file for key, the file is mapped
+// rather than read
+static bool ReplayCache(const std::string &file_name, U64 key, SDIOFrameSink &sink)
+{
+    SDIOMappedFile map;
+    SDIODecodeCache::Header header;
+    if (!map.Open(file_name.c_str()) || map.GetSize() < sizeof(header))
+        return false;
+    memcpy(&header, map.GetData(), sizeof(header));
+    if (!SDIODecodeCache::CheckHeader(header, key) || header.mComplete == 0 ||
+        header.mLength > map.GetSize() - sizeof(header))
+        return false;
+
+    SDIODecodeCache::Replay(map.GetData() + sizeof(header), size_t(header.mLength), sink);
+    sink.CommitResults();
+    return true;
+}
+
+static bool Decode(const Job &job, const Config &config)
+{
+    Capture capture;
+    if (!capture.Open(job.input, config))
+        return false;
+    SDIOChannel** lines = capture.lines;
+
+    FILE* file = OpenOutput(job.output);
+    if (file == nullptr)
+        return false;
+
+    {
+        PacketWriter writer(file, config, capture.origin);
+
+        //A cache hit leaves nothing to decode.  The payload files are only
+        //written while decoding, so they are not cached.
+        std::string cache_file;
+        U64 key = 0;
+        if (!config.cacheDirectory.empty() && config.options.mPayloadDirectory.empty())
+        {
+            key = CacheKey(job.input, config);
+            cache_file = SDIODecodeCache::FileName(config.cacheDirectory, key);
+            if (ReplayCache(cache_file, key, writer))
+                return CloseOutput(file, job.output);
+        }
+
+        //Written under a name of its own and renamed once complete, the same
+        //capture may be decoded by another worker at the same time
+        CacheRecorder recorder(writer);
+        SDIOFrameSink* sink = &writer;
+        char suffix[64];
+        snprintf(suffix, sizeof(suffix), ".%llu.tmp", (unsigned long long)std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::string temp_file = cache_file + suffix;
+        if (!cache_file.empty() && recorder.mCache.Open(temp_file.c_str(), key))
+            sink = &recorder;
+
+        SDIODecoder decoder;
+        decoder.Start(lines[ROLE_CLOCK], lines[ROLE_CMD], lines[ROLE_DAT0], lines[ROLE_DAT1],
+                      lines[ROLE_DAT2], lines[ROLE_DAT3], sink, config.options);
+
+        //Nothing before the range is written, skip decoding it where possible
+        bool checkpointed = !config.checkpointFile.empty();
+        if (checkpointed && config.options.mStartSample != 0)
+        {
+            std::vector<SDIODecoderCheckpoint> checkpoints;
+            LoadCheckpoints(config, checkpoints);
+            size_t count = decoder.FindCheckpoint(checkpoints, config.options.mStartSample);
+            if (count != 0 && !decoder.Resume(checkpoints, count))
+            {
+                //The lines are past the start already, read the input again
+                fprintf(stderr, "sdio-decode: %s does not match %s, decoding from the start\n",
+                        config.checkpointFile.c_str(), job.input.c_str());
+                if (!capture.Open(job.input, config))
+                {
+                    CloseOutput(file, job.output);
+                    return false;
+                }
+                decoder.Start(lines[ROLE_CLOCK], lines[ROLE_CMD], lines[ROLE_DAT0], lines[ROLE_DAT1],
+                              lines[ROLE_DAT2], lines[ROLE_DAT3], sink, config.options);
+            }
+        }
+
+        SDIOChannel* clock = lines[ROLE_CLOCK];
+        while (clock->DoMoreTransitionsExistInCurrentData() && clock->GetSampleNumber() <= config.options.mEndSample)
+            decoder.Step();
+        decoder.Finish();
+
+        if (sink == &recorder)
+        {
+            remove(cache_file.c_str());
+            if (!recorder.mCache.Finish() || rename(temp_file.c_str(), cache_file.c_str()) != 0)
+            {
+                remove(temp_file.c_str());
+                fprintf(stderr, "sdio-decode: cannot write %s\n", cache_file.c_str());
+            }
+        }
+
+        if (checkpointed)
+            SaveCheckpoints(config, decoder.GetCheckpoints());
+    }
+
+    return CloseOutput(file, job.output);
+}
+
+// Aligns the transactions of two captures and reports where the second one
+// loses time
+static bool Diff(const std::string &before_input, const std::string &after_input, const Config &config)
+{
+    Capture captures[2];
+    if (!captures[0].Open(before_input, config) || !captures[1].Open(after_input, config))
+        return false;
+
+    SDIOTransactionSource sources[2];
+    for (U32 side = 0; side < 2; side++)
+    {
+        SDIOChannel** lines = captures[side].lines;
+        sources[side].Start(lines[ROLE_CLOCK], lines[ROLE_CMD], lines[ROLE_DAT0], lines[ROLE_DAT1],
+                            lines[ROLE_DAT2], lines[ROLE_DAT3], config.options);
+    }
+
+    SDIOTraceDiff diff(config.diffWindow, config.diffTop);
+    diff.Run(sources[0], sources[1]);
+
+    FILE* file = OpenOutput(config.output);
+    if (file == nullptr)
+        return false;
+    diff.Write(file, config.sampleRate, captures[0].origin, captures[1].origin);
+    return CloseOutput(file, config.output);
+}
+
+static bool ParseChannels(const char* text, U32* channels)
+{
+    for (U32 role = 0; role < ROLE_COUNT; role++)
+        channels[role] = NO_CHANNEL;
+
+    for (U32 role = 0; role < ROLE_COUNT; role++)
+    {
+        char* end;
+        if (*text == '-')
+            end = (char*)text + 1;
+        else
+            channels[role] = U32(strtoul(text, &end, 10));
+        if (end == text)
+            return false;
+        if (*end == 0)
+            return role >= ROLE_DAT0;
+        if (*end != ',')
+            return false;
+        text = end + 1;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    Config config;
+    for (U32 role = 0; role < ROLE_COUNT; role++)
+        config.channels[role] = role;
+    config.sampleRate = 500000000.0;
+    config.rawBytes = 0;
+    config.format = FORMAT_TEXT;
+    config.displayBase = Hexadecimal;
+    config.workers = std::thread::hardware_concurrency();
+    config.diff = false;
+    config.diffWindow = 4096;
+    config.diffTop = 20;
+
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool valid = true;
+        if (arg[0] != '-' || arg == "-")
+        {
+            inputs.push_back(arg);
+            continue;
+        }
+        if (arg == "--collapse")
+        {
+            config.options.mCollapsePolls = true;
+            continue;
+        }
+        if (arg == "--timing")
+        {
+            config.options.mCheckTiming = true;
+            continue;
+        }
+        if (arg == "--diff")
+        {
+            config.diff = true;
+            continue;
+        }
+        if (value == nullptr)
+            valid = false;
+        else if (arg == "--channels")
+            valid = ParseChannels(value, config.channels);
+        else if (arg == "--rate")
+            valid = (config.sampleRate = strtod(value, nullptr)) >= 1.0 && config.sampleRate < 4294967296.0;
+        else if (arg == "--raw")
+            valid = (config.rawBytes = U32(atoi(value))) != 0;
+        else if (arg == "--format")
+            valid = (config.format = strcmp(value, "json") == 0 ? FORMAT_JSON : FORMAT_TEXT) == FORMAT_JSON || strcmp(value, "text") == 0;
+        else if (arg == "--base")
+            valid = (config.displayBase = strcmp(value, "dec") == 0 ? Decimal : strcmp(value, "bin") == 0 ? Binary : Hexadecimal) != Hexadecimal || strcmp(value, "hex") == 0;
+        else if (arg == "--commands")
+            valid = SDIODecodeOptions::ParseCommandFilter(value, config.options.mCommandMask);
+        else if (arg == "--function")
+            valid = (config.options.mFunctionFilter = U32(atoi(value))) < SDIODecodeOptions::FUNCTION_ALL;
+        else if (arg == "--range")
+            valid = SDIODecodeOptions::ParseSampleRange(value, config.options.mStartSample, config.options.mEndSample);
+        else if (arg == "--payload")
+            config.options.mPayloadDirectory = value;
+        else if (arg == "--checkpoints")
+            config.checkpointFile = value;
+        else if (arg == "--checkpoint-interval")
+            valid = (config.options.mCheckpointInterval = U32(atoi(value))) != 0;
+        else if (arg == "--cache")
+            config.cacheDirectory = value;
+        else if (arg == "-o")
+            config.output = value;
+        else if (arg == "--top")
+            config.diffTop = U32(atoi(value));
+        else if (arg == "--window")
+            valid = (config.diffWindow = U32(atoi(value))) >= 16;
+        else if (arg == "-j")
+            valid = (config.workers = U32(atoi(value))) != 0;
+        else
+            valid = false;
+        if (!valid)
+        {
+            fprintf(stderr, "sdio-decode: invalid option %s\n\n%s", arg.c_str(), sUsage);
+            return 2;
+        }
+        i++;
+    }
+    if (!config.checkpointFile.empty() && config.options.mCheckpointInterval == 0)
+        config.options.mCheckpointInterval = 4096;
+    if (inputs.empty() || (config.diff && inputs.size() != 2))
+    {
+        fputs(sUsage, stderr);
+        return 2;
+    }
+    if (config.diff)
+        return Diff(inputs[0], inputs[1], config) ? 0 : 1;
+
+    //Folders that are not a capture themselves hold the captures to decode
+    std::vector<Job> jobs;
+    bool batch = inputs.size() > 1;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (!IsDirectory(inputs[i]) || IsTransitionCapture(inputs[i], config))
+        {
+            Job job = {inputs[i], std::string()};
+            jobs.push_back(job);
+            continue;
+        }
+        batch = true;
+        std::vector<std::string> names = ListDirectory(inputs[i]);
+        for (size_t n = 0; n < names.size(); n++)
+        {
+            Job job = {inputs[i] + "/" + names[n], std::string()};
+            if (IsCapture(job.input, config))
+                jobs.push_back(job);
+        }
+    }
+
+    if (batch)
+    {
+        if (!config.options.mPayloadDirectory.empty() || !config.checkpointFile.empty())
+        {
+            fputs("sdio-decode: --payload and --checkpoints need a single capture\n", stderr);
+            return 2;
+        }
+        std::string directory = config.output.empty() ? std::string(".") : config.output;
+        const char* extension = config.format == FORMAT_JSON ? ".jsonl" : ".txt";
+        for (size_t i = 0; i < jobs.size(); i++)
+            jobs[i].output = directory + "/" + BaseName(jobs[i].input) + extension;
+    }
+    else if (!jobs.empty())
+    {
+        jobs[0].output = config.output;
+    }
+
+    //Each worker takes the next capture until all are done
+    std::atomic<size_t> next(0);
+    std::atomic<U32> failed(0);
+    U32 workers = U32(jobs.size()) < config.workers ? U32(jobs.size()) : config.workers;
+    std::vector<std::thread> threads;
+    for (U32 w = 0; w < workers; w++)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            for (size_t job = next++; job < jobs.size(); job = next++)
+            {
+                if (!Decode(jobs[job], config))
+                    failed++;
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    return failed == 0 && !jobs.empty() ? 0 : 1;
+}
@@ -0,0 +1,344 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIODecodeApi.h"
+#include "SDIODecoder.h"
+#include <algorithm>
+#include <deque>
+#include <new>
+
+static_assert(sizeof(SDIORecord) == 64, "SDIORecord is 64 bytes");
+
+// A line given as its transition samples.  The cursor behaves like the
+// AnalyzerChannelData one, except that it never blocks: past the last
+// transition it stops at the end of the capture.
+class SDIOMemoryChannel
+{
+public:
+    SDIOMemoryChannel()
+    :    mTransitions(nullptr),
+        mCount(0),
+        mNumSamples(0),
+        mSample(0),
+        mState(BIT_LOW),
+        mNext(0)
+    {
+    }
+
+    void Assign(const SDIOLine &line, U64 num_samples)
+    {
+        mTransitions = line.transitions;
+        mNumSamples = num_samples;
+        mCount = std::lower_bound(mTransitions, mTransitions + line.count, num_samples) - mTransitions;
+        mSample = 0;
+        mState = line.initial_state ? BIT_HIGH : BIT_LOW;
+        mNext = 0;
+    }
+
+    U64 GetSampleNumber() const { return mSample; }
+    BitState GetBitState() const { return mState; }
+
+    void AdvanceToNextEdge()
+    {
+        if (mNext >= mCount)
+        {
+            mSample = mNumSamples;
+            return;
+        }
+        mSample = mTransitions[mNext++];
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+    }
+
+    // Every transition passed toggles the state, only their number matters
+    void AdvanceToAbsPosition(U64 sample)
+    {
+        if (sample <= mSample)
+            return;
+        mSample = sample < mNumSamples ? sample : mNumSamples;
+        U64 next = std::upper_bound(mTransitions + mNext, mTransitions + mCount, mSample) - mTransitions;
+        if ((next - mNext) & 1)
+            mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        mNext = next;
+    }
+
+    U64 GetSampleOfNextEdge() { return mNext < mCount ? mTransitions[mNext] : mNumSamples; }
+    bool WouldAdvancingToAbsPositionCauseTransition(U64 sample) { return mNext < mCount && mTransitions[mNext] <= sample; }
+    bool DoMoreTransitionsExistInCurrentData() { return mNext < mCount; }
+
+protected:
+    const uint64_t* mTransitions;
+    U64 mCount;
+    U64 mNumSamples;
+    U64 mSample;
+    BitState mState;
+    U64 mNext;
+};
+
+// Turns the frames of each committed packet into a record.  The decoder runs
+// in overview mode, a packet is a single frame.
+class SDIORecordQueue : public SDIOFrameSink
+{
+public:
+    SDIORecordQueue() : mCount(0) {}
+
+    virtual void AddFrame(const SDIOFrame &frame)
+    {
+        if (mCount < SDIODecoder::MAX_PACKET_FIELDS)
+            mFrames[mCount++] = frame;
+    }
+
+    virtual void AddMarker(U64 /*sample*/)
+    {
+    }
+
+    virtual void CommitPacket()
+    {
+        if (mCount != 0)
+            mRecords.push_back(MakeRecord(mFrames[0]));
+        mCount = 0;
+    }
+
+    virtual void CommitResults()
+    {
+    }
+
+    std::deque<SDIORecord> mRecords;
+
+protected:
+    static SDIORecord MakeRecord(const SDIOFrame &frame)
+    {
+        SDIORecord record = SDIORecord();
+        record.start = frame.mStartingSampleInclusive;
+        record.end = frame.mEndingSampleInclusive;
+        record.value = frame.mData1;
+        record.value2 = frame.mData2;
+
+        switch (frame.mType)
+        {
+        case SDIODecoder::FRAME_IRQ:
+        case SDIODecoder::FRAME_BUSY:
+            //From the start of the interrupt or busy signal, not of the frame
+            record.type = frame.mType == SDIODecoder::FRAME_IRQ ? SDIO_RECORD_IRQ : SDIO_RECORD_BUSY;
+            record.start = frame.mData2;
+            record.value2 = 0;
+            break;
+        case SDIODecoder::FRAME_REPEAT:
+            record.type = SDIO_RECORD_REPEAT;
+            record.command = 52;
+            break;
+        case SDIODecoder::FRAME_DATA_CRC:
+            record.type = SDIO_RECORD_DATA_CRC;
+            record.value2 = 0;
+            break;
+        case SDIODecoder::FRAME_TIMING:
+        {
+            SDIOResponseTiming::Violation violation;
+            SDIOResponseTiming::Unpack(frame.mData1, violation);
+            record.type = SDIO_RECORD_TIMING;
+            record.command = U8(violation.mCommand);
+            record.value = violation.mClocks;
+            record.value2 = violation.mCheck;
+            break;
+        }
+        default:
+            record.type = SDIO_RECORD_PACKET;
+            AddPacketFields(frame, record);
+            break;
+        }
+        return record;
+    }
+
+    // Start bit, direction, index, argument, CRC7 and end bit
+    static void AddPacketFields(const SDIOFrame &frame, SDIORecord &record)
+    {
+        if (frame.mFlags & SDIODecoder::PACKET_FLAG_LONG)
+        {
+            record.long_packet = 1;
+            record.command = 63;
+            return;
+        }
+        U64 raw = frame.mData1;
+        U32 argument = U32(raw >> 8);
+        record.value2 = 0;
+        record.argument = argument;
+        record.host = U8((raw >> 46) & 0x1);
+        record.command = U8((raw >> 40) & 0x3F);
+        record.crc = U8((raw >> 1) & 0x7F);
+        if (record.command != 52 && record.command != 53)
+            return;
+
+        if (record.host)
+        {
+            record.write = U8(argument >> 31);
+            record.function = U8((argument >> 28) & 0x7);
+            record.address = (argument >> 9) & 0x1FFFF;
+            if (record.command == 52)
+            {
+                record.data = U8(argument);
+            }
+            else
+            {
+                record.block_mode = U8((argument >> 27) & 0x1);
+                record.op_code = U8((argument >> 26) & 0x1);
+                record.count = argument & 0x1FF;
+            }
+        }
+        else
+        {
+            record.data = U8(argument);
+            record.flags = U8(argument >> 8);
+        }
+    }
+
+    SDIOFrame mFrames[SDIODecoder::MAX_PACKET_FIELDS];
+    U32 mCount;
+};
+
+struct SDIODecodeHandle
+{
+    SDIOMemoryChannel mLines[SDIO_LINE_COUNT];
+    SDIOChannelAdapter< SDIOMemoryChannel > mAdapters[SDIO_LINE_COUNT];
+    SDIORecordQueue mQueue;
+    SDIODecoder mDecoder;
+    bool mFinished;
+};
+
+void SDIODecodeDefaultConfig(SDIODecodeConfig* config)
+{
+    *config = SDIODecodeConfig();
+    config->command_mask = ~uint64_t(0);
+    config->end_sample = ~uint64_t(0);
+    config->function_filter = SDIODecodeOptions::FUNCTION_ALL;
+}
+
+SDIODecodeHandle* SDIODecodeOpen(const SDIODecodeConfig* config)
+{
+    const SDIOLine* lines = config->lines;
+    bool connected[SDIO_LINE_COUNT];
+    for (U32 role = 0; role < SDIO_LINE_COUNT; role++)
+        connected[role] = lines[role].transitions != nullptr;
+
+    if (!connected[SDIO_LINE_CLOCK] || !connected[SDIO_LINE_CMD] || !connected[SDIO_LINE_DAT0])
+        return nullptr;
+    //Same combinations as SDIOAnalyzerSettings allows
+    bool wide = connected[SDIO_LINE_DAT1];
+    bool eight = connected[SDIO_LINE_DAT4];
+    for (U32 role = SDIO_LINE_DAT1; role <= SDIO_LINE_DAT3; role++)
+        if (connected[role] != wide)
+            return nullptr;
+    for (U32 role = SDIO_LINE_DAT4; role <= SDIO_LINE_DAT7; role++)
+        if (connected[role] != eight)
+            return nullptr;
+    if (eight && !wide)
+        return nullptr;
+    if (config->function_filter > SDIODecodeOptions::FUNCTION_ALL)
+        return nullptr;
+
+    SDIODecodeHandle* decoder = new (std::nothrow) SDIODecodeHandle();
+    if (decoder == nullptr)
+        return nullptr;
+
+    try
+    {
+        SDIOChannel* channels[SDIO_LINE_COUNT];
+        for (U32 role = 0; role < SDIO_LINE_COUNT; role++)
+        {
+            channels[role] = nullptr;
+            if (!connected[role])
+                continue;
+            decoder->mLines[role].Assign(lines[role], config->sample_count);
+            decoder->mAdapters[role].SetChannel(&decoder->mLines[role]);
+            channels[role] = decoder->mAdapters[role].Get();
+        }
+
+        SDIODecodeOptions options;
+        options.mOverview = true;
+        options.mCollapsePolls = (config->flags & SDIO_DECODE_COLLAPSE_POLLS) != 0;
+        options.mCheckTiming = (config->flags & SDIO_DECODE_CHECK_TIMING) != 0;
+        options.mCommandMask = config->command_mask;
+        options.mFunctionFilter = config->function_filter;
+        options.mStartSample = config->start_sample;
+        options.mEndSample = config->end_sample;
+
+        decoder->mFinished = false;
+        decoder->mDecoder.SetUpperDataLines(channels[SDIO_LINE_DAT4], channels[SDIO_LINE_DAT5],
+                                            channels[SDIO_LINE_DAT6], channels[SDIO_LINE_DAT7]);
+        decoder->mDecoder.Start(channels[SDIO_LINE_CLOCK], channels[SDIO_LINE_CMD], channels[SDIO_LINE_DAT0],
+                                channels[SDIO_LINE_DAT1], channels[SDIO_LINE_DAT2], channels[SDIO_LINE_DAT3],
+                                &decoder->mQueue, options);
+    }
+    catch (...)
+    {
+        delete decoder;
+        return nullptr;
+    }
+    return decoder;
+}
+
+uint64_t SDIODecodeRead(SDIODecodeHandle* decoder, SDIORecord* records, uint64_t capacity)
+{
+    std::deque<SDIORecord> &queue = decoder->mQueue.mRecords;
+    try
+    {
+        SDIOChannel* clock = decoder->mAdapters[SDIO_LINE_CLOCK].Get();
+        while (queue.size() < capacity && !decoder->mFinished)
+        {
+            if (clock->DoMoreTransitionsExistInCurrentData())
+            {
+                decoder->mDecoder.Step();
+            }
+            else
+            {
+                decoder->mDecoder.Finish();
+                decoder->mFinished = true;
+            }
+        }
+    }
+    catch (...)
+    {
+        decoder->mFinished = true;
+    }
+
+    uint64_t count = std::min<uint64_t>(queue.size(), capacity);
+    std::copy(queue.begin(), queue.begin() + count, records);
+    queue.erase(queue.begin(), queue.begin() + count);
+    return count;
+}
+
+void SDIODecodeClose(SDIODecodeHandle* decoder)
+{
+    delete decoder;
+}
+
+uint32_t SDIODecodeVersion(void)
+{
+    return SDIO_DECODE_API_VERSION;
+}
+
+uint32_t SDIODecodeRecordSize(void)
+{
+    return sizeof(SDIORecord);
+}
+
+uint32_t SDIODecodeConfigSize(void)
+{
+    return sizeof(SDIODecodeConfig);
+}
@@ -0,0 +1,172 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_DECODE_API
+#define SDIO_DECODE_API
+
+// C interface of the decoder for use in-process, e.g. from Python through
+// ctypes or cffi.  The lines are given as arrays of transition samples, the
+// packets come back as fixed size records with their fields already split
+// out, so nothing has to be formatted or parsed.
+//
+//     SDIODecodeConfig config;
+//     SDIODecodeDefaultConfig(&config);
+//     config.lines[SDIO_LINE_CLOCK].transitions = clock_edges;
+//     ...
+//     SDIODecodeHandle* decoder = SDIODecodeOpen(&config);
+//     while ((count = SDIODecodeRead(decoder, records, 1024)) != 0)
+//         ...
+//     SDIODecodeClose(decoder);
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(SDIO_API_EXPORTS)
+#define SDIO_API __declspec(dllexport)
+#else
+#define SDIO_API __declspec(dllimport)
+#endif
+#else
+#define SDIO_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Changes whenever a struct below does
+#define SDIO_DECODE_API_VERSION 1
+
+enum SDIOLineRole
+{
+    SDIO_LINE_CLOCK, SDIO_LINE_CMD,
+    SDIO_LINE_DAT0, SDIO_LINE_DAT1, SDIO_LINE_DAT2, SDIO_LINE_DAT3,
+    SDIO_LINE_DAT4, SDIO_LINE_DAT5, SDIO_LINE_DAT6, SDIO_LINE_DAT7,
+    SDIO_LINE_COUNT
+};
+
+// A line is its state at sample 0 and the samples it changes at, in
+// increasing order.  The array is read in place, it has to stay valid until
+// the decoder is closed.  A null array leaves the line out: DAT1-DAT3 may be
+// left out together for a 1 bit bus, DAT4-DAT7 unless the bus is 8 bits wide.
+typedef struct SDIOLine
+{
+    const uint64_t* transitions;
+    uint64_t count;
+    uint32_t initial_state;
+    uint32_t reserved;
+} SDIOLine;
+
+enum SDIODecodeFlags
+{
+    // One SDIO_RECORD_REPEAT for identical CMD52 command/response pairs in a row
+    SDIO_DECODE_COLLAPSE_POLLS = 0x1,
+    // SDIO_RECORD_TIMING for response timeouts and gaps out of the spec's bounds
+    SDIO_DECODE_CHECK_TIMING = 0x2
+};
+
+typedef struct SDIODecodeConfig
+{
+    SDIOLine lines[SDIO_LINE_COUNT];
+    // Samples in the capture, transitions at or after it are ignored
+    uint64_t sample_count;
+    // Bit n set to decode CMDn
+    uint64_t command_mask;
+    // Only packets starting in this range are returned
+    uint64_t start_sample;
+    uint64_t end_sample;
+    // CMD52/CMD53 packets of function 0-7 only, or 8 for all functions
+    uint32_t function_filter;
+    uint32_t flags;
+} SDIODecodeConfig;
+
+enum SDIORecordType
+{
+    // A command or response, value holds its 48 bits.  For a long response
+    // value and value2 hold the upper 64 and lower 63 bits of its argument.
+    SDIO_RECORD_PACKET,
+    // Interrupt on DAT1 until the host read the pending register and busy
+    // signal on DAT0, value is the duration in samples
+    SDIO_RECORD_IRQ,
+    SDIO_RECORD_BUSY,
+    // Identical CMD52 pairs, value is their number and value2 the shortest
+    // (low 32 bits) and longest (high 32 bits) samples from one to the next
+    SDIO_RECORD_REPEAT,
+    // Data block with a CRC16 error, value has bit n set for DATn
+    SDIO_RECORD_DATA_CRC,
+    // Timing violation of command, value is the clocks measured and value2 the
+    // SDIOResponseTiming check: 0 NCR, 1 NID, 2 NCC, 3 NRC, 4 NWR, 5 timeout
+    SDIO_RECORD_TIMING
+};
+
+// 64 bytes, the fields after value2 are only set for SDIO_RECORD_PACKET
+// unless noted
+typedef struct SDIORecord
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t value;
+    uint64_t value2;
+    uint32_t type;
+    uint32_t argument;
+    // CMD52/CMD53 register address and CMD53 byte or block count
+    uint32_t address;
+    uint32_t count;
+    uint8_t host;
+    // Index, 63 for a long response.  Also set for repeats and timing.
+    uint8_t command;
+    uint8_t crc;
+    uint8_t long_packet;
+    // CMD52/CMD53 fields of a command
+    uint8_t function;
+    uint8_t write;
+    uint8_t block_mode;
+    uint8_t op_code;
+    // CMD52 data of a command or response, and the response flags
+    uint8_t data;
+    uint8_t flags;
+    uint8_t reserved[6];
+} SDIORecord;
+
+typedef struct SDIODecodeHandle SDIODecodeHandle;
+
+// Every line left out, all commands and functions, the whole capture
+SDIO_API void SDIODecodeDefaultConfig(SDIODecodeConfig* config);
+
+// Null if the lines do not make up a bus
+SDIO_API SDIODecodeHandle* SDIODecodeOpen(const SDIODecodeConfig* config);
+
+// Decodes on until capacity records are filled or the capture ends.  The
+// number of records written, 0 once everything has been returned.
+SDIO_API uint64_t SDIODecodeRead(SDIODecodeHandle* decoder, SDIORecord* records, uint64_t capacity);
+
+SDIO_API void SDIODecodeClose(SDIODecodeHandle* decoder);
+
+// For bindings to check their struct layout against
+SDIO_API uint32_t SDIODecodeVersion(void);
+SDIO_API uint32_t SDIODecodeRecordSize(void);
+SDIO_API uint32_t SDIODecodeConfigSize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SDIO_DECODE_API
@@ -0,0 +1,112 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOMappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SDIOMappedFile::SDIOMappedFile()
+:    mData(nullptr),
+    mSize(0)
+#ifdef _WIN32
+    , mFile(INVALID_HANDLE_VALUE),
+    mMapping(nullptr)
+#endif
+{
+}
+
+SDIOMappedFile::~SDIOMappedFile()
+{
+    Close();
+}
+
+bool SDIOMappedFile::Open(const char* file_name)
+{
+    Close();
+
+#ifdef _WIN32
+    mFile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mFile, &size);
+    mSize = U64(size.QuadPart);
+    if (mSize == 0)
+        return true;
+    mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping != nullptr)
+        mData = (const U8*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0)
+        mSize = U64(info.st_size);
+    if (mSize != 0)
+    {
+        void* map = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            mData = (const U8*)map;
+            madvise(map, mSize, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+    if (mSize == 0)
+        return true;
+#endif
+
+    if (mData == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SDIOMappedFile::Close()
+{
+#ifdef _WIN32
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+#else
+    if (mData != nullptr)
+        munmap((void*)mData, mSize);
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
@@ -0,0 +1,51 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_MAPPED_FILE
+#define SDIO_MAPPED_FILE
+
+#include <LogicPublicTypes.h>
+
+// A whole file mapped read only, for reading it front to back once without
+// copying it.  An empty file opens with no data.
+class SDIOMappedFile
+{
+public:
+    SDIOMappedFile();
+    ~SDIOMappedFile();
+
+    bool Open(const char* file_name);
+    void Close();
+
+    const U8* GetData() const { return mData; }
+    U64 GetSize() const { return mSize; }
+
+protected:
+    const U8* mData;
+    U64 mSize;
+#ifdef _WIN32
+    void* mFile;
+    void* mMapping;
+#endif
+};
+
+#endif //SDIO_MAPPED_FILE
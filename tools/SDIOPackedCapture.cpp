@@ -0,0 +1,215 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOPackedCapture.h"
+#include <stdio.h>
+#include <string.h>
+
+SDIOPackedChannel::SDIOPackedChannel()
+:    mNumSamples(0),
+    mSample(0),
+    mState(BIT_LOW),
+    mNextEdge(0)
+{
+}
+
+void SDIOPackedChannel::Assign(std::vector<U64> &words, U64 num_samples)
+{
+    mWords.swap(words);
+    mNumSamples = num_samples;
+
+    // The bits past the last sample repeat it so they never look like an edge
+    if (num_samples & 63)
+    {
+        U64 &last = mWords[num_samples >> 6];
+        U64 valid = (U64(1) << (num_samples & 63)) - 1;
+        last = (last & valid) | (((last >> ((num_samples - 1) & 63)) & 1) ? ~valid : 0);
+    }
+
+    mSample = 0;
+    mState = num_samples ? GetBit(0) : BIT_LOW;
+    mNextEdge = FindNextEdge(0);
+}
+
+U64 SDIOPackedChannel::FindNextEdge(U64 sample) const
+{
+    if (sample + 1 >= mNumSamples)
+        return mNumSamples;
+
+    U64 index = (sample + 1) >> 6;
+    U64 last = (mNumSamples - 1) >> 6;
+
+    //Ignore the edges up to and including sample in the first word
+    U64 edges = EdgeWord(index) & (~U64(0) << ((sample + 1) & 63));
+    while (edges == 0)
+    {
+        if (++index > last)
+            return mNumSamples;
+        edges = EdgeWord(index);
+    }
+
+    U64 edge = (index << 6) + SDIOCountTrailingZeros(edges);
+    return edge < mNumSamples ? edge : mNumSamples;
+}
+
+U64 SDIOPackedChannel::FindPreviousEdge(U64 sample) const
+{
+    if (mNumSamples == 0)
+        return 0;
+    if (sample >= mNumSamples)
+        sample = mNumSamples - 1;
+
+    U64 index = sample >> 6;
+    U64 shift = 63 - (sample & 63);
+    U64 edges = EdgeWord(index) << shift >> shift;
+    while (edges == 0)
+    {
+        if (index == 0)
+            return 0;
+        edges = EdgeWord(--index);
+    }
+
+    return (index << 6) + 63 - SDIOCountLeadingZeros(edges);
+}
+
+void SDIOPackedChannel::Gather(const U64* samples, U32 count, U8* bits) const
+{
+    const U64* words = mWords.data();
+    for (U32 i = 0; i < count; i++)
+    {
+        U64 sample = samples[i];
+        bits[i] = U8((words[sample >> 6] >> (sample & 63)) & 1);
+    }
+}
+
+void SDIOPackedChannel::AdvanceToNextEdge()
+{
+    if (mNextEdge >= mNumSamples)
+    {
+        mSample = mNumSamples;
+        return;
+    }
+    mSample = mNextEdge;
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+    mNextEdge = FindNextEdge(mSample);
+}
+
+void SDIOPackedChannel::AdvanceToAbsPosition(U64 sample)
+{
+    if (sample <= mSample || mNumSamples == 0)
+        return;
+    if (sample >= mNumSamples)
+        sample = mNumSamples;
+
+    mSample = sample;
+    if (sample >= mNextEdge)
+    {
+        if (sample < mNumSamples)
+        {
+            mState = GetBit(sample);
+            mNextEdge = FindNextEdge(sample);
+        }
+        else
+        {
+            mState = GetBit(mNumSamples - 1);
+            mNextEdge = mNumSamples;
+        }
+    }
+}
+
+U64 SDIOPackedChannel::GetSampleOfNextEdge()
+{
+    return mNextEdge;
+}
+
+bool SDIOPackedChannel::WouldAdvancingToAbsPositionCauseTransition(U64 sample)
+{
+    return mNextEdge <= sample && mNextEdge < mNumSamples;
+}
+
+bool SDIOPackedChannel::DoMoreTransitionsExistInCurrentData()
+{
+    return mNextEdge < mNumSamples;
+}
+
+SDIOPackedCapture::SDIOPackedCapture()
+:    mNumSamples(0)
+{
+}
+
+bool SDIOPackedCapture::Load(const char* file_name, U32 bytes_per_sample)
+{
+    if (bytes_per_sample != 1 && bytes_per_sample != 2 && bytes_per_sample != 4 && bytes_per_sample != 8)
+        return false;
+
+    FILE* file = fopen(file_name, "rb");
+    if (file == nullptr)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(file);
+        return false;
+    }
+
+    U32 num_channels = bytes_per_sample * 8;
+    mNumSamples = U64(size) / bytes_per_sample;
+    U64 num_words = (mNumSamples + 63) / 64;
+    std::vector< std::vector<U64> > words(num_channels, std::vector<U64>(num_words, 0));
+
+    //Transpose 64 samples at a time, one output word per channel
+    std::vector<U8> buffer(64 * bytes_per_sample * 1024);
+    U64 sample = 0;
+    size_t length;
+    while ((length = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+    {
+        U64 count = length / bytes_per_sample;
+        for (U64 i = 0; i < count; i += 64)
+        {
+            U64 n = count - i < 64 ? count - i : 64;
+            U64 word = (sample + i) >> 6;
+            U32 shift = U32((sample + i) & 63);
+            for (U64 j = 0; j < n; j++)
+            {
+                U64 value = 0;
+                memcpy(&value, &buffer[(i + j) * bytes_per_sample], bytes_per_sample);
+                while (value != 0)
+                {
+                    U32 channel = SDIOCountTrailingZeros(value);
+                    words[channel][word + ((shift + j) >> 6)] |= U64(1) << ((shift + j) & 63);
+                    value &= value - 1;
+                }
+            }
+        }
+        sample += count;
+    }
+    fclose(file);
+
+    mChannels.resize(num_channels);
+    for (U32 channel = 0; channel < num_channels; channel++)
+        mChannels[channel].Assign(words[channel], mNumSamples);
+
+    return true;
+}
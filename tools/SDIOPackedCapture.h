@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_PACKED_CAPTURE
+#define SDIO_PACKED_CAPTURE
+
+#include <LogicPublicTypes.h>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest/highest set bit of a non-zero word
+inline U32 SDIOCountTrailingZeros(U64 word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+inline U32 SDIOCountLeadingZeros(U64 word)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, word);
+    return 63 - index;
+#else
+    return __builtin_clzll(word);
+#endif
+}
+
+// One channel of an offline capture, one bit per sample packed into 64 bit
+// words with sample n in bit n % 64 of word n / 64.  Edges are found a word
+// at a time by comparing each word with itself shifted by one sample.
+//
+// The cursor methods behave like the AnalyzerChannelData ones the plugin
+// uses, except that they never block: past the last edge the cursor stops at
+// the end of the capture and DoMoreTransitionsExistInCurrentData() is false.
+class SDIOPackedChannel
+{
+public:
+    SDIOPackedChannel();
+
+    // Takes over the words
+    void Assign(std::vector<U64> &words, U64 num_samples);
+    U64 GetSampleCount() const { return mNumSamples; }
+
+    BitState GetBit(U64 sample) const { return BitState((mWords[sample >> 6] >> (sample & 63)) & 1); }
+
+    // First edge after sample, or the sample count if there is none
+    U64 FindNextEdge(U64 sample) const;
+    // Last edge at or before sample, or 0 if there is none
+    U64 FindPreviousEdge(U64 sample) const;
+
+    // The state of the channel at each of the samples, which must be sorted
+    void Gather(const U64* samples, U32 count, U8* bits) const;
+
+    // AnalyzerChannelData compatible cursor
+    U64 GetSampleNumber() const { return mSample; }
+    BitState GetBitState() const { return mState; }
+    void AdvanceToNextEdge();
+    void AdvanceToAbsPosition(U64 sample);
+    U64 GetSampleOfNextEdge();
+    bool WouldAdvancingToAbsPositionCauseTransition(U64 sample);
+    bool DoMoreTransitionsExistInCurrentData();
+
+protected:
+    // Bit n of the result is set if sample 64 * index + n differs from the one before it
+    U64 EdgeWord(U64 index) const
+    {
+        U64 word = mWords[index];
+        U64 previous = index == 0 ? word & 1 : mWords[index - 1] >> 63;
+        return word ^ (word << 1 | previous);
+    }
+
+    std::vector<U64> mWords;
+    U64 mNumSamples;
+    U64 mSample;
+    BitState mState;
+    U64 mNextEdge;
+};
+
+// Loads a "raw binary, every sample" export where each sample is a little
+// endian word of 1, 2, 4 or 8 bytes with bit n holding channel n, and splits
+// it into packed channels.
+class SDIOPackedCapture
+{
+public:
+    SDIOPackedCapture();
+
+    bool Load(const char* file_name, U32 bytes_per_sample);
+
+    U32 GetChannelCount() const { return U32(mChannels.size()); }
+    U64 GetSampleCount() const { return mNumSamples; }
+    SDIOPackedChannel* GetChannel(U32 channel) { return channel < mChannels.size() ? &mChannels[channel] : nullptr; }
+
+protected:
+    std::vector<SDIOPackedChannel> mChannels;
+    U64 mNumSamples;
+};
+
+#endif //SDIO_PACKED_CAPTURE
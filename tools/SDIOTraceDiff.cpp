@@ -0,0 +1,418 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include "SDIOTraceDiff.h"
+#include <algorithm>
+
+// command 6 bits | function 3 | write 1 | block mode 1 | count 9 | address 17
+U64 SDIOTransaction::Key() const
+{
+    return U64(mCommand) | U64(mFunction) << 6 | U64(mWrite) << 9 | U64(mBlockMode) << 10 |
+           U64(mCount) << 11 | U64(mAddress) << 20;
+}
+
+// e.g. "CMD53 W fn1 0x08000 4 blocks", "CMD52 R fn0 0x00005" or "CMD3"
+void SDIOTransaction::Describe(U64 key, char* text, U32 size)
+{
+    U32 command = U32(key & 0x3F);
+    U32 function = U32(key >> 6) & 0x7;
+    char direction = (key >> 9) & 0x1 ? 'W' : 'R';
+    bool block_mode = (key >> 10) & 0x1;
+    U32 count = U32(key >> 11) & 0x1FF;
+    U32 address = U32(key >> 20) & 0x1FFFF;
+    if (command == 52)
+        snprintf(text, size, "CMD52 %c fn%u 0x%05X", direction, function, address);
+    else if (command == 53)
+        snprintf(text, size, "CMD53 %c fn%u 0x%05X %u %s", direction, function, address, count, block_mode ? "blocks" : "bytes");
+    else
+        snprintf(text, size, "CMD%u", command);
+}
+
+SDIOTransactionBuilder::SDIOTransactionBuilder(std::deque<SDIOTransaction> &transactions)
+:    mTransactions(transactions),
+    mOpen(false),
+    mHasPacket(false)
+{
+}
+
+void SDIOTransactionBuilder::AddFrame(const SDIOFrame &frame)
+{
+    if (frame.mType == SDIODecoder::FRAME_PACKET){
+        mPacket = frame;
+        mHasPacket = true;
+    }
+}
+
+//A command starts the next transaction, a response belongs to the command
+//before it
+void SDIOTransactionBuilder::CommitPacket()
+{
+    if (!mHasPacket){
+        return;
+    }
+    mHasPacket = false;
+
+    bool host = !(mPacket.mFlags & SDIODecoder::PACKET_FLAG_LONG) && ((mPacket.mData1 >> 46) & 0x1);
+    if (!host){
+        if (mOpen && !mCurrent.mResponded){
+            mCurrent.mResponded = true;
+            mCurrent.mResponseStart = mPacket.mStartingSampleInclusive;
+            mCurrent.mEnd = std::max(mCurrent.mEnd, mPacket.mEndingSampleInclusive);
+        }
+        return;
+    }
+
+    Finish();
+    U32 index = U32(mPacket.mData1 >> 40) & 0x3F;
+    U32 argument = U32(mPacket.mData1 >> 8);
+    SDIOTransaction &transaction = mCurrent;
+    transaction.mCommand = U8(index);
+    transaction.mFunction = 0;
+    transaction.mWrite = false;
+    transaction.mBlockMode = false;
+    transaction.mAddress = 0;
+    transaction.mCount = 0;
+    if (index == 52 || index == 53){
+        transaction.mWrite = (argument >> 31) != 0;
+        transaction.mFunction = U8((argument >> 28) & 0x7);
+        transaction.mAddress = (argument >> 9) & 0x1FFFF;
+        transaction.mCount = index == 52 ? 1 : argument & 0x1FF;
+        transaction.mBlockMode = index == 53 && ((argument >> 27) & 0x1);
+    }
+    transaction.mStart = mPacket.mStartingSampleInclusive;
+    transaction.mCommandEnd = mPacket.mEndingSampleInclusive;
+    transaction.mResponseStart = 0;
+    transaction.mDataStart = 0;
+    transaction.mDataEnd = 0;
+    transaction.mEnd = mPacket.mEndingSampleInclusive;
+    transaction.mResponded = false;
+    transaction.mHasData = false;
+    mOpen = true;
+}
+
+void SDIOTransactionBuilder::AddDataBlock(U64 start, U64 end)
+{
+    if (!mOpen){
+        return;
+    }
+    if (!mCurrent.mHasData){
+        mCurrent.mHasData = true;
+        mCurrent.mDataStart = start;
+    }
+    mCurrent.mDataEnd = end;
+    mCurrent.mEnd = std::max(mCurrent.mEnd, end);
+}
+
+void SDIOTransactionBuilder::Finish()
+{
+    if (mOpen){
+        mTransactions.push_back(mCurrent);
+        mOpen = false;
+    }
+}
+
+SDIOTransactionSource::SDIOTransactionSource()
+:    mBuilder(mTransactions),
+    mClock(nullptr),
+    mEndSample(0),
+    mEnded(true)
+{
+}
+
+//Transactions are only seen as packets, the overview mode saves expanding
+//them into fields
+void SDIOTransactionSource::Start(SDIOChannel* clock, SDIOChannel* cmd, SDIOChannel* dat0, SDIOChannel* dat1,
+                                  SDIOChannel* dat2, SDIOChannel* dat3, const SDIODecodeOptions &options)
+{
+    SDIODecodeOptions overview = options;
+    overview.mOverview = true;
+    overview.mCollapsePolls = false;
+    overview.mPayloadDirectory.clear();
+    mClock = clock;
+    mEndSample = options.mEndSample;
+    mEnded = false;
+    mDecoder.Start(clock, cmd, dat0, dat1, dat2, dat3, &mBuilder, overview);
+}
+
+void SDIOTransactionSource::Fill(size_t count)
+{
+    while (!mEnded && mTransactions.size() < count){
+        if (mClock->DoMoreTransitionsExistInCurrentData() && mClock->GetSampleNumber() <= mEndSample){
+            mDecoder.Step();
+        }else{
+            mDecoder.Finish();
+            mBuilder.Finish();
+            mEnded = true;
+        }
+    }
+}
+
+SDIOTraceDiff::SDIOTraceDiff(U32 window, U32 top)
+:    mWindow(window < 2 ? 2 : window),
+    mMaxEdits(mWindow / 4 < 16 ? 16 : mWindow / 4),
+    mTop(top),
+    mAligned(0)
+{
+    mTotal.mTurnaround = 0;
+    mTotal.mData = 0;
+    mTotal.mGap = 0;
+    for (U32 side = 0; side < 2; side++){
+        mPreviousEnd[side] = 0;
+        mSeen[side] = false;
+        mFirst[side] = 0;
+        mLast[side] = 0;
+        mCount[side] = 0;
+        mUnmatchedCount[side] = 0;
+    }
+}
+
+//Each round aligns a window of both captures and keeps the edits up to half
+//the window, the rest is aligned again with what follows it.  Windows that
+//differ too much to align are taken as removed and inserted as a whole.
+void SDIOTraceDiff::Run(SDIOTransactionSource &before, SDIOTransactionSource &after)
+{
+    std::deque<SDIOTransaction> &a = before.Transactions();
+    std::deque<SDIOTransaction> &b = after.Transactions();
+    for ( ; ; ){
+        before.Fill(mWindow);
+        after.Fill(mWindow);
+        size_t n = std::min(a.size(), size_t(mWindow));
+        size_t m = std::min(b.size(), size_t(mWindow));
+        if (n == 0 && m == 0){
+            break;
+        }
+        bool last = before.AtEnd() && after.AtEnd() && a.size() <= mWindow && b.size() <= mWindow;
+        size_t keep = last ? mWindow : mWindow / 2;
+
+        if (!Align(a, n, b, m)){
+            mOps.clear();
+            mOps.insert(mOps.end(), std::min(n, keep), U8(OP_REMOVE));
+            mOps.insert(mOps.end(), std::min(m, keep), U8(OP_INSERT));
+        }
+
+        size_t x = 0;
+        size_t y = 0;
+        for (size_t i = 0; i < mOps.size() && x < keep && y < keep; i++){
+            if (mOps[i] == OP_MATCH){
+                Match(a[x++], b[y++]);
+            }else if (mOps[i] == OP_REMOVE){
+                Unmatched(a[x++], 0);
+            }else{
+                Unmatched(b[y++], 1);
+            }
+        }
+        a.erase(a.begin(), a.begin() + x);
+        b.erase(b.begin(), b.begin() + y);
+    }
+}
+
+//Myers' O(ND) diff of the first n and m transactions, up to mMaxEdits
+//removals and insertions
+bool SDIOTraceDiff::Align(const std::deque<SDIOTransaction> &a, size_t n, const std::deque<SDIOTransaction> &b, size_t m)
+{
+    mKeys[0].resize(n);
+    mKeys[1].resize(m);
+    for (size_t i = 0; i < n; i++){
+        mKeys[0][i] = a[i].Key();
+    }
+    for (size_t i = 0; i < m; i++){
+        mKeys[1][i] = b[i].Key();
+    }
+    mTrace.clear();
+    mOps.clear();
+    S32 limit = S32(std::min(n + m, size_t(mMaxEdits)));
+    S32 offset = limit + 1;
+    S32 width = 2 * limit + 3;
+    std::vector<S32> v(width, 0);
+    const U64* ka = mKeys[0].data();
+    const U64* kb = mKeys[1].data();
+    for (S32 d = 0; d <= limit; d++){
+        mTrace.insert(mTrace.end(), v.begin(), v.end());
+        for (S32 k = -d; k <= d; k += 2){
+            S32 x;
+            if (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])){
+                x = v[offset + k + 1];
+            }else{
+                x = v[offset + k - 1] + 1;
+            }
+            S32 y = x - k;
+            while (x < S32(n) && y < S32(m) && ka[x] == kb[y]){
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= S32(n) && y >= S32(m)){
+                Backtrack(d, S32(n), S32(m), width, offset);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//Walks the trace back from (n, m) to the start, the edits come out last first
+void SDIOTraceDiff::Backtrack(S32 edits, S32 n, S32 m, S32 width, S32 offset)
+{
+    S32 x = n;
+    S32 y = m;
+    for (S32 d = edits; d >= 0; d--){
+        const S32* v = &mTrace[size_t(d) * width];
+        S32 k = x - y;
+        S32 previous = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? k + 1 : k - 1;
+        S32 previous_x = v[offset + previous];
+        S32 previous_y = previous_x - previous;
+        while (x > previous_x && y > previous_y){
+            mOps.push_back(OP_MATCH);
+            x--;
+            y--;
+        }
+        if (d > 0){
+            mOps.push_back(x == previous_x ? OP_INSERT : OP_REMOVE);
+        }
+        x = previous_x;
+        y = previous_y;
+    }
+    std::reverse(mOps.begin(), mOps.end());
+}
+
+//Idle time between the end of the previous transaction and this one
+U64 SDIOTraceDiff::Gap(const SDIOTransaction &transaction, U32 side)
+{
+    U64 gap = mSeen[side] && transaction.mStart > mPreviousEnd[side] ? transaction.mStart - mPreviousEnd[side] : 0;
+    if (!mSeen[side]){
+        mSeen[side] = true;
+        mFirst[side] = transaction.mStart;
+    }
+    mPreviousEnd[side] = transaction.mEnd;
+    mLast[side] = std::max(mLast[side], transaction.mEnd);
+    mCount[side]++;
+    return gap;
+}
+
+void SDIOTraceDiff::Match(const SDIOTransaction &before, const SDIOTransaction &after)
+{
+    Delta delta;
+    delta.mGap = S64(Gap(after, 1)) - S64(Gap(before, 0));
+    delta.mTurnaround = S64(after.Turnaround()) - S64(before.Turnaround());
+    delta.mData = S64(after.DataDuration()) - S64(before.DataDuration());
+    mAligned++;
+    mTotal.mTurnaround += delta.mTurnaround;
+    mTotal.mData += delta.mData;
+    mTotal.mGap += delta.mGap;
+
+    U64 key = before.Key();
+    std::map<U64, KeyTotal>::iterator total = mByKey.find(key);
+    if (total == mByKey.end()){
+        KeyTotal zero = {{0, 0, 0}, 0};
+        total = mByKey.insert(std::make_pair(key, zero)).first;
+    }
+    total->second.mDelta.mTurnaround += delta.mTurnaround;
+    total->second.mDelta.mData += delta.mData;
+    total->second.mDelta.mGap += delta.mGap;
+    total->second.mCount++;
+
+    //The top pairs are kept in a heap with the smallest loss in front
+    if (mTop == 0 || delta.Total() <= 0){
+        return;
+    }
+    Regression regression = {delta, key, before.mStart, after.mStart};
+    if (mRegressions.size() == mTop){
+        if (regression.mDelta.Total() <= mRegressions.front().mDelta.Total()){
+            return;
+        }
+        std::pop_heap(mRegressions.begin(), mRegressions.end());
+        mRegressions.pop_back();
+    }
+    mRegressions.push_back(regression);
+    std::push_heap(mRegressions.begin(), mRegressions.end());
+}
+
+void SDIOTraceDiff::Unmatched(const SDIOTransaction &transaction, U32 side)
+{
+    Gap(transaction, side);
+    mUnmatchedCount[side]++;
+    if (mUnmatched[side].size() < mTop){
+        mUnmatched[side].push_back(transaction);
+    }
+}
+
+static void WriteMicroseconds(FILE* file, S64 samples, double sample_rate)
+{
+    fprintf(file, ",%+.3f", samples * 1e6 / sample_rate);
+}
+
+static void WriteDelta(FILE* file, const SDIOTraceDiff::Delta &delta, double sample_rate)
+{
+    WriteMicroseconds(file, delta.mTurnaround, sample_rate);
+    WriteMicroseconds(file, delta.mData, sample_rate);
+    WriteMicroseconds(file, delta.mGap, sample_rate);
+    WriteMicroseconds(file, delta.Total(), sample_rate);
+    fputc('\n', file);
+}
+
+//Sections of CSV, all times lost are after minus before in microseconds
+void SDIOTraceDiff::Write(FILE* file, double sample_rate, double before_origin, double after_origin) const
+{
+    char text[64];
+    fprintf(file, "Transactions,%llu before,%llu after,%llu aligned,%llu removed,%llu inserted\n",
+            (unsigned long long)mCount[0], (unsigned long long)mCount[1], (unsigned long long)mAligned,
+            (unsigned long long)mUnmatchedCount[0], (unsigned long long)mUnmatchedCount[1]);
+    fprintf(file, "Span [s],%.9f before,%.9f after\n",
+            (mLast[0] - mFirst[0]) / sample_rate, (mLast[1] - mFirst[1]) / sample_rate);
+
+    fputs("\nTime lost,Turnaround [us],Data [us],Gap [us],Total [us]\nAll aligned", file);
+    WriteDelta(file, mTotal, sample_rate);
+
+    std::vector< std::pair<S64, U64> > keys;
+    for (std::map<U64, KeyTotal>::const_iterator i = mByKey.begin(); i != mByKey.end(); ++i){
+        keys.push_back(std::make_pair(-i->second.mDelta.Total(), i->first));
+    }
+    std::sort(keys.begin(), keys.end());
+    fputs("\nTransaction,Count,Turnaround [us],Data [us],Gap [us],Total [us]\n", file);
+    for (size_t i = 0; i < keys.size() && i < mTop; i++){
+        const KeyTotal &total = mByKey.find(keys[i].second)->second;
+        SDIOTransaction::Describe(keys[i].second, text, sizeof(text));
+        fprintf(file, "%s,%llu", text, (unsigned long long)total.mCount);
+        WriteDelta(file, total.mDelta, sample_rate);
+    }
+
+    std::vector<Regression> regressions = mRegressions;
+    std::sort(regressions.begin(), regressions.end());
+    fputs("\nBefore [s],After [s],Transaction,Turnaround [us],Data [us],Gap [us],Total [us]\n", file);
+    for (size_t i = 0; i < regressions.size(); i++){
+        const Regression &regression = regressions[i];
+        SDIOTransaction::Describe(regression.mKey, text, sizeof(text));
+        fprintf(file, "%.9f,%.9f,%s", before_origin + regression.mBefore / sample_rate,
+                after_origin + regression.mAfter / sample_rate, text);
+        WriteDelta(file, regression.mDelta, sample_rate);
+    }
+
+    static const char* headers[] = {"\nRemoved [s],Transaction\n", "\nInserted [s],Transaction\n"};
+    double origins[] = {before_origin, after_origin};
+    for (U32 side = 0; side < 2; side++){
+        fputs(headers[side], file);
+        for (size_t i = 0; i < mUnmatched[side].size(); i++){
+            const SDIOTransaction &transaction = mUnmatched[side][i];
+            SDIOTransaction::Describe(transaction.Key(), text, sizeof(text));
+            fprintf(file, "%.9f,%s\n", origins[side] + transaction.mStart / sample_rate, text);
+        }
+    }
+}
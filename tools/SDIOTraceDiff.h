@@ -0,0 +1,171 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#ifndef SDIO_TRACE_DIFF
+#define SDIO_TRACE_DIFF
+
+#include "SDIODecoder.h"
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <vector>
+
+// A command with its response and the data phase that follows it.  Two
+// transactions are the same when command index, function, direction, address
+// and size match, their timing is what the diff compares.
+struct SDIOTransaction
+{
+    U8 mCommand;
+    U8 mFunction;
+    bool mWrite;
+    bool mBlockMode;
+    U32 mAddress;
+    U32 mCount;
+
+    U64 mStart;
+    U64 mCommandEnd;
+    U64 mResponseStart;
+    U64 mDataStart;
+    U64 mDataEnd;
+    U64 mEnd;
+    bool mResponded;
+    bool mHasData;
+
+    U64 Key() const;
+    U64 Turnaround() const { return mResponded ? mResponseStart - mCommandEnd : 0; }
+    U64 DataDuration() const { return mHasData ? mDataEnd - mDataStart : 0; }
+
+    static void Describe(U64 key, char* text, U32 size);
+};
+
+// Groups the packets of an overview decode into transactions
+class SDIOTransactionBuilder : public SDIOFrameSink
+{
+public:
+    SDIOTransactionBuilder(std::deque<SDIOTransaction> &transactions);
+
+    virtual void AddFrame(const SDIOFrame &frame);
+    virtual void AddMarker(U64 /*sample*/) {}
+    virtual void CommitPacket();
+    virtual void CommitResults() {}
+    virtual void AddDataBlock(U64 start, U64 end);
+
+    // Queues the last transaction
+    void Finish();
+
+protected:
+    std::deque<SDIOTransaction> &mTransactions;
+    SDIOTransaction mCurrent;
+    bool mOpen;
+    SDIOFrame mPacket;
+    bool mHasPacket;
+};
+
+// One capture of the diff, decoded only as far as the alignment needs it
+class SDIOTransactionSource
+{
+public:
+    SDIOTransactionSource();
+
+    void Start(SDIOChannel* clock, SDIOChannel* cmd, SDIOChannel* dat0, SDIOChannel* dat1,
+               SDIOChannel* dat2, SDIOChannel* dat3, const SDIODecodeOptions &options);
+    // Decodes until count transactions are queued or the capture ends
+    void Fill(size_t count);
+    bool AtEnd() const { return mEnded; }
+
+    std::deque<SDIOTransaction>& Transactions() { return mTransactions; }
+
+protected:
+    std::deque<SDIOTransaction> mTransactions;
+    SDIOTransactionBuilder mBuilder;
+    SDIODecoder mDecoder;
+    SDIOChannel* mClock;
+    U64 mEndSample;
+    bool mEnded;
+};
+
+// Aligns the transactions of two captures and adds up where the second one
+// loses time.  The alignment is a Myers diff over a window of each capture;
+// the first half of the window is kept and the window moves on, so memory
+// stays bounded however long the captures are.
+class SDIOTraceDiff
+{
+public:
+    SDIOTraceDiff(U32 window, U32 top);
+
+    void Run(SDIOTransactionSource &before, SDIOTransactionSource &after);
+    void Write(FILE* file, double sample_rate, double before_origin, double after_origin) const;
+
+    // Changes of an aligned pair, after minus before, in samples
+    struct Delta
+    {
+        S64 mTurnaround;
+        S64 mData;
+        S64 mGap;
+        S64 Total() const { return mTurnaround + mData + mGap; }
+    };
+
+    struct Regression
+    {
+        Delta mDelta;
+        U64 mKey;
+        U64 mBefore;
+        U64 mAfter;
+        bool operator<(const Regression &other) const { return mDelta.Total() > other.mDelta.Total(); }
+    };
+
+    struct KeyTotal
+    {
+        Delta mDelta;
+        U64 mCount;
+    };
+
+protected:
+    enum ops {OP_MATCH, OP_REMOVE, OP_INSERT};
+    bool Align(const std::deque<SDIOTransaction> &a, size_t n, const std::deque<SDIOTransaction> &b, size_t m);
+    void Backtrack(S32 edits, S32 n, S32 m, S32 width, S32 offset);
+    void Match(const SDIOTransaction &before, const SDIOTransaction &after);
+    void Unmatched(const SDIOTransaction &transaction, U32 side);
+    U64 Gap(const SDIOTransaction &transaction, U32 side);
+
+    U32 mWindow;
+    U32 mMaxEdits;
+    U32 mTop;
+
+    std::vector<U64> mKeys[2];
+    std::vector<S32> mTrace;
+    std::vector<U8> mOps;
+
+    U64 mPreviousEnd[2];
+    bool mSeen[2];
+    U64 mFirst[2];
+    U64 mLast[2];
+    U64 mCount[2];
+    U64 mUnmatchedCount[2];
+    std::vector<SDIOTransaction> mUnmatched[2];
+
+    U64 mAligned;
+    Delta mTotal;
+    std::map<U64, KeyTotal> mByKey;
+    std::vector<Regression> mRegressions;
+};
+
+#endif //SDIO_TRACE_DIFF
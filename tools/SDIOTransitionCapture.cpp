@@ -0,0 +1,317 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "SDIOTransitionCapture.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Digital export header: "<SALEAE>", version 0, type 0, then the initial
+//state, begin and end time, transition count and the transition times
+enum {HEADER_SIZE = 44, IDENTIFIER_SIZE = 8};
+
+template <typename T> static T Read(const U8* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+SDIOTransitionChannel::SDIOTransitionChannel()
+:    mMap(nullptr),
+    mMapSize(0),
+    mTimes(nullptr),
+    mNumTransitions(0),
+    mInitialState(BIT_LOW),
+    mBeginTime(0.0),
+    mEndTime(0.0),
+    mOrigin(0.0),
+    mSampleRate(1.0),
+    mNumSamples(0),
+    mSample(0),
+    mState(BIT_LOW),
+    mNext(0),
+    mNextSample(0),
+    mReleased(0)
+#ifdef _WIN32
+    , mFile(INVALID_HANDLE_VALUE),
+    mMapping(nullptr)
+#endif
+{
+}
+
+SDIOTransitionChannel::~SDIOTransitionChannel()
+{
+    Close();
+}
+
+bool SDIOTransitionChannel::Open(const char* file_name)
+{
+    Close();
+
+#ifdef _WIN32
+    mFile = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mFile, &size);
+    mMapSize = U64(size.QuadPart);
+    mMapping = mMapSize ? CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (mMapping != nullptr)
+        mMap = (const U8*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        mMapSize = U64(info.st_size);
+        void* map = mmap(nullptr, mMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            mMap = (const U8*)map;
+            madvise(map, mMapSize, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+#endif
+
+    if (mMap == nullptr || mMapSize < HEADER_SIZE || memcmp(mMap, "<SALEAE>", IDENTIFIER_SIZE) != 0 ||
+        Read<S32>(mMap + 8) != 0 || Read<S32>(mMap + 12) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    mInitialState = Read<U32>(mMap + 16) ? BIT_HIGH : BIT_LOW;
+    mBeginTime = Read<double>(mMap + 20);
+    mEndTime = Read<double>(mMap + 28);
+    mNumTransitions = Read<U64>(mMap + 36);
+    if (mNumTransitions > (mMapSize - HEADER_SIZE) / sizeof(double))
+    {
+        Close();
+        return false;
+    }
+    mTimes = mMap + HEADER_SIZE;
+
+    SetTimeBase(mBeginTime, 1.0);
+    return true;
+}
+
+void SDIOTransitionChannel::Close()
+{
+#ifdef _WIN32
+    if (mMap != nullptr)
+        UnmapViewOfFile(mMap);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = INVALID_HANDLE_VALUE;
+#else
+    if (mMap != nullptr)
+        munmap((void*)mMap, mMapSize);
+#endif
+    mMap = nullptr;
+    mMapSize = 0;
+    mTimes = nullptr;
+    mNumTransitions = 0;
+}
+
+void SDIOTransitionChannel::SetTimeBase(double origin, double sample_rate)
+{
+    mOrigin = origin;
+    mSampleRate = sample_rate;
+
+    double end = (mEndTime - mOrigin) * mSampleRate + 0.5;
+    mNumSamples = end > 0.0 ? U64(end) : 0;
+
+    mSample = 0;
+    mState = mInitialState;
+    mNext = 0;
+    mReleased = 0;
+    //Transitions rounded to the first sample already show in its state
+    while (mNext < mNumTransitions && SampleOf(mNext) == 0)
+    {
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        mNext++;
+    }
+    mNextSample = mNext < mNumTransitions ? SampleOf(mNext) : mNumSamples;
+}
+
+U64 SDIOTransitionChannel::SampleOf(U64 transition) const
+{
+    double sample = (Read<double>(mTimes + transition * sizeof(double)) - mOrigin) * mSampleRate + 0.5;
+    return sample > 0.0 ? U64(sample) : 0;
+}
+
+void SDIOTransitionChannel::AdvanceToNextEdge()
+{
+    if (mNext >= mNumTransitions)
+    {
+        mSample = mNumSamples;
+        return;
+    }
+
+    mSample = mNextSample;
+    mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+    mNext++;
+    //A pulse shorter than a sample cancels out
+    while (mNext < mNumTransitions && SampleOf(mNext) == mSample)
+    {
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        mNext++;
+    }
+    mNextSample = mNext < mNumTransitions ? SampleOf(mNext) : mNumSamples;
+    Release();
+}
+
+void SDIOTransitionChannel::AdvanceToAbsPosition(U64 sample)
+{
+    if (sample <= mSample)
+        return;
+    mSample = sample;
+    if (mNextSample > sample || mNext >= mNumTransitions)
+        return;
+
+    //Gallop ahead, then binary search for the first transition after sample.
+    //The state only depends on how many transitions were passed.
+    U64 low = mNext;
+    U64 step = 1;
+    U64 high = mNext + 1;
+    while (high < mNumTransitions && SampleOf(high) <= sample)
+    {
+        low = high;
+        step *= 2;
+        high = mNext + step;
+    }
+    if (high > mNumTransitions)
+        high = mNumTransitions;
+    while (high - low > 1)
+    {
+        U64 middle = low + (high - low) / 2;
+        if (SampleOf(middle) <= sample)
+            low = middle;
+        else
+            high = middle;
+    }
+
+    if ((high - mNext) & 1)
+        mState = mState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+    mNext = high;
+    mNextSample = mNext < mNumTransitions ? SampleOf(mNext) : mNumSamples;
+    Release();
+}
+
+U64 SDIOTransitionChannel::GetSampleOfNextEdge()
+{
+    return mNextSample;
+}
+
+bool SDIOTransitionChannel::WouldAdvancingToAbsPositionCauseTransition(U64 sample)
+{
+    return mNext < mNumTransitions && mNextSample <= sample;
+}
+
+bool SDIOTransitionChannel::DoMoreTransitionsExistInCurrentData()
+{
+    return mNext < mNumTransitions;
+}
+
+//Give the pages that were read back once a few MB are behind the cursor
+void SDIOTransitionChannel::Release()
+{
+#ifndef _WIN32
+    U64 offset = HEADER_SIZE + mNext * sizeof(double);
+    if (offset - mReleased < DROP_SIZE)
+        return;
+
+    U64 page = U64(sysconf(_SC_PAGESIZE));
+    U64 end = offset & ~(page - 1);
+    madvise((void*)(mMap + mReleased), end - mReleased, MADV_DONTNEED);
+    mReleased = end;
+#endif
+}
+
+SDIOTransitionCapture::SDIOTransitionCapture()
+:    mNumSamples(0),
+    mOrigin(0.0)
+{
+}
+
+bool SDIOTransitionCapture::Open(const char* directory, const U32* channels, double sample_rate)
+{
+    Close();
+
+    bool first = true;
+    for (U32 role = 0; role < ROLE_COUNT; role++)
+    {
+        if (channels[role] == NO_CHANNEL)
+        {
+            //Clock, command and DAT0 are always needed
+            if (role <= ROLE_DAT0)
+                return false;
+            continue;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "/digital_%u.bin", channels[role]);
+        if (!mChannels[role].Open((std::string(directory) + name).c_str()))
+        {
+            Close();
+            return false;
+        }
+        if (first || mChannels[role].GetBeginTime() < mOrigin)
+            mOrigin = mChannels[role].GetBeginTime();
+        first = false;
+    }
+
+    for (U32 role = 0; role < ROLE_COUNT; role++)
+    {
+        if (!mChannels[role].IsOpen())
+            continue;
+        mChannels[role].SetTimeBase(mOrigin, sample_rate);
+        if (mChannels[role].GetSampleCount() > mNumSamples)
+            mNumSamples = mChannels[role].GetSampleCount();
+    }
+    return true;
+}
+
+void SDIOTransitionCapture::Close()
+{
+    for (U32 role = 0; role < ROLE_COUNT; role++)
+        mChannels[role].Close();
+    mNumSamples = 0;
+    mOrigin = 0.0;
+}
@@ -0,0 +1,118 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Erick Fuentes http://erickfuent.es
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef SDIO_TRANSITION_CAPTURE
+#define SDIO_TRANSITION_CAPTURE
+
+#include <LogicPublicTypes.h>
+
+// One channel of a Logic 2 binary digital export: a header with the initial
+// state followed by the time of every transition in seconds.  The file is
+// memory mapped and read front to back; pages behind the cursor are given
+// back to the OS, so only a small window of a large file is resident.
+//
+// Times are converted to sample numbers at the given sample rate, counted
+// from a common origin so all channels of a capture line up.  The cursor
+// methods behave like the AnalyzerChannelData ones the plugin uses, except
+// that they never block past the last transition.
+class SDIOTransitionChannel
+{
+public:
+    SDIOTransitionChannel();
+    ~SDIOTransitionChannel();
+
+    bool Open(const char* file_name);
+    void Close();
+    bool IsOpen() const { return mTimes != nullptr; }
+
+    double GetBeginTime() const { return mBeginTime; }
+    double GetEndTime() const { return mEndTime; }
+    U64 GetTransitionCount() const { return mNumTransitions; }
+
+    // Must be called before the cursor is used
+    void SetTimeBase(double origin, double sample_rate);
+    U64 GetSampleCount() const { return mNumSamples; }
+
+    // AnalyzerChannelData compatible cursor
+    U64 GetSampleNumber() const { return mSample; }
+    BitState GetBitState() const { return mState; }
+    void AdvanceToNextEdge();
+    void AdvanceToAbsPosition(U64 sample);
+    U64 GetSampleOfNextEdge();
+    bool WouldAdvancingToAbsPositionCauseTransition(U64 sample);
+    bool DoMoreTransitionsExistInCurrentData();
+
+    enum {DROP_SIZE = 16 << 20};
+
+protected:
+    U64 SampleOf(U64 transition) const;
+    void Release();
+
+    const U8* mMap;
+    U64 mMapSize;
+    const U8* mTimes;
+    U64 mNumTransitions;
+    BitState mInitialState;
+    double mBeginTime;
+    double mEndTime;
+
+    double mOrigin;
+    double mSampleRate;
+    U64 mNumSamples;
+
+    U64 mSample;
+    BitState mState;
+    U64 mNext;
+    U64 mNextSample;
+    U64 mReleased;
+#ifdef _WIN32
+    void* mFile;
+    void* mMapping;
+#endif
+};
+
+// The channels of a Logic 2 export folder, digital_<n>.bin, in the roles of
+// SDIOAnalyzerSettings.  DAT1-DAT3 are optional.
+class SDIOTransitionCapture
+{
+public:
+    enum roles {ROLE_CLOCK, ROLE_CMD, ROLE_DAT0, ROLE_DAT1, ROLE_DAT2, ROLE_DAT3, ROLE_COUNT};
+    enum {NO_CHANNEL = 0xFFFFFFFF};
+
+    SDIOTransitionCapture();
+
+    // channels[role] is the channel index of each role or NO_CHANNEL
+    bool Open(const char* directory, const U32* channels, double sample_rate);
+    void Close();
+
+    // nullptr for a role without a channel
+    SDIOTransitionChannel* GetChannel(U32 role) { return mChannels[role].IsOpen() ? &mChannels[role] : nullptr; }
+    U64 GetSampleCount() const { return mNumSamples; }
+    double GetOrigin() const { return mOrigin; }
+
+protected:
+    SDIOTransitionChannel mChannels[ROLE_COUNT];
+    U64 mNumSamples;
+    double mOrigin;
+};
+
+#endif //SDIO_TRANSITION_CAPTURE